@@ -0,0 +1,122 @@
+#include <new>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <malloc.h>
+
+#include "AllocStats.hh"
+
+/*
+ * The one global operator new/delete replacement: it feeds AllocStats,
+ * the account of the allocating thread and the AllocObserver, if any.
+ * Linked into the executable with the WL_GENA_ALLOC_STATS option, and
+ * into the benches that count allocations
+ *
+ * Sizes of freed blocks come from malloc_usable_size, so live bytes are
+ * counted in usable sizes throughout
+ */
+
+namespace {
+
+void *counted_alloc(size_t size, std::align_val_t align)
+{
+    void *p = nullptr;
+    size_t alignment = static_cast<size_t>(align);
+    if (alignment <= alignof(std::max_align_t)) {
+        p = std::malloc(size == 0 ? 1 : size);
+    } else {
+        size_t aligned_size = (size + alignment - 1) / alignment * alignment;
+        if (aligned_size == 0) {
+            aligned_size = alignment;
+        }
+        p = std::aligned_alloc(alignment, aligned_size);
+    }
+
+    if (p == nullptr) {
+        throw std::bad_alloc{};
+    }
+    wl_gena::alloc_hooks::allocated(malloc_usable_size(p), size);
+    return p;
+}
+
+void counted_free(void *p)
+{
+    if (p == nullptr) {
+        return;
+    }
+    wl_gena::alloc_hooks::freed(malloc_usable_size(p));
+    std::free(p);
+}
+
+struct EnableHooks
+{
+    EnableHooks()
+    {
+        wl_gena::alloc_hooks::enable();
+    }
+} enable_hooks;
+
+constexpr std::align_val_t default_align{alignof(std::max_align_t)};
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    return counted_alloc(size, default_align);
+}
+
+void *operator new[](size_t size)
+{
+    return counted_alloc(size, default_align);
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    return counted_alloc(size, align);
+}
+
+void *operator new[](size_t size, std::align_val_t align)
+{
+    return counted_alloc(size, align);
+}
+
+void operator delete(void *p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+    counted_free(p);
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <atomic>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "AllocStats.hh"
+
+namespace wl_gena {
+
+namespace {
+
+std::atomic<bool> hooks_enabled{false};
+std::atomic<const AllocObserver *> observer{nullptr};
+
+/*
+ * Plain pointers only, operator new may run before and after thread
+ * locals with constructors or destructors are usable
+ */
+thread_local AllocAccount current_account;
+
+} // namespace
+
+AllocCounters &AllocCounters::operator+=(const AllocCounters &other)
+{
+    allocations += other.allocations;
+    bytes += other.bytes;
+    peak_live_bytes = std::max(peak_live_bytes, other.peak_live_bytes);
+    return *this;
+}
+
+bool alloc_accounting_enabled()
+{
+    return hooks_enabled.load(std::memory_order_relaxed);
+}
+
+AllocAccount exchange_alloc_account(AllocAccount account)
+{
+    AllocAccount previous = current_account;
+    current_account = account;
+    return previous;
+}
+
+void set_alloc_observer(const AllocObserver *new_observer)
+{
+    observer.store(new_observer, std::memory_order_release);
+}
+
+namespace alloc_hooks {
+
+void enable()
+{
+    hooks_enabled.store(true, std::memory_order_relaxed);
+}
+
+void allocated(size_t usable_size, size_t requested_size)
+{
+    if (const AllocObserver *o = observer.load(std::memory_order_acquire)) {
+        o->allocated(usable_size, requested_size);
+    }
+
+    AllocAccount account = current_account;
+    if (account.live_bytes) {
+        *account.live_bytes += int64_t(usable_size);
+    }
+    if (!account.counters) {
+        return;
+    }
+
+    AllocCounters &counters = *account.counters;
+    counters.allocations++;
+    counters.bytes += requested_size;
+    if (account.live_bytes && *account.live_bytes > 0) {
+        counters.peak_live_bytes =
+            std::max(counters.peak_live_bytes, size_t(*account.live_bytes));
+    }
+}
+
+void freed(size_t usable_size)
+{
+    if (const AllocObserver *o = observer.load(std::memory_order_acquire)) {
+        o->freed(usable_size);
+    }
+
+    AllocAccount account = current_account;
+    if (account.live_bytes) {
+        *account.live_bytes -= int64_t(usable_size);
+    }
+}
+
+} // namespace alloc_hooks
+
+} // namespace wl_gena
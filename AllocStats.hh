@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wl_gena {
+
+/*
+ * Heap allocations counted while one phase was active
+ *
+ * Live bytes are the allocated minus the freed usable bytes of the
+ * calling thread since its job started, peak_live_bytes the most of them
+ * seen during the phase
+ */
+struct AllocCounters
+{
+    size_t allocations = 0;
+    size_t bytes = 0;
+    size_t peak_live_bytes = 0;
+
+    /*
+     * Sums counts, peaks of separate jobs do not add up so the highest
+     * one is kept
+     */
+    AllocCounters &operator+=(const AllocCounters &other);
+};
+
+/*
+ * Where allocations of the calling thread are counted, null members
+ * count nothing
+ */
+struct AllocAccount
+{
+    AllocCounters *counters = nullptr;
+    int64_t *live_bytes = nullptr;
+};
+
+/*
+ * Allocations are only counted by an executable linked with the operator
+ * new replacement of AllocHooks.cc (the WL_GENA_ALLOC_STATS option)
+ */
+bool alloc_accounting_enabled();
+
+/*
+ * Makes [account] the one of the calling thread, returns the previous one
+ */
+AllocAccount exchange_alloc_account(AllocAccount account);
+
+/*
+ * Sees every counted allocation of every thread, next to the account of
+ * the thread. Called from inside operator new and delete, so it must not
+ * allocate
+ */
+struct AllocObserver
+{
+    void (*allocated)(size_t usable_size, size_t requested_size);
+    void (*freed)(size_t usable_size);
+};
+
+/*
+ * [observer] must outlive the process, null removes it
+ */
+void set_alloc_observer(const AllocObserver *observer);
+
+/*
+ * For AllocHooks.cc, and for allocators of libraries that do not go
+ * through operator new
+ */
+namespace alloc_hooks {
+
+void enable();
+void allocated(size_t usable_size, size_t requested_size);
+void freed(size_t usable_size);
+
+} // namespace alloc_hooks
+
+} // namespace wl_gena
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <array>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+
+namespace wl_gena {
+
+/*
+ * Receives output in order, a few chunks at a time; the chunks are valid
+ * only during the call
+ */
+using OutputSink =
+    std::function<void(std::span<const std::string_view> chunks)>;
+
+/*
+ * Append-only writer of generated code into one growing buffer
+ *
+ * Lines are indented by the current depth as they are written, a line
+ * without text stays empty. Separators are deferred instead of patched in
+ * afterwards: a blank line between blocks is written once something
+ * follows it, and a list separator is added to an item once the next
+ * item arrives (see List)
+ *
+ * With a sink, the buffer is cut into blocks at line ends outside of
+ * lists, and blocks are handed to the sink a few at a time and then
+ * reused, so memory stays flat however long the output gets
+ */
+struct CodeWriter
+{
+    explicit CodeWriter(
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : _out{resource}, _blocks{resource}
+    {
+    }
+
+    CodeWriter(const OutputSink &sink, std::pmr::memory_resource *resource)
+        : _out{resource}, _sink{&sink}, _blocks{resource}
+    {
+    }
+
+    void line(std::string_view text)
+    {
+        begin_line();
+        _out += text;
+        end_line();
+    }
+
+    template <typename... Args>
+        requires(sizeof...(Args) != 0)
+    void line(std::format_string<Args...> fmt, Args &&...args)
+    {
+        begin_line();
+        std::format_to(
+            std::back_inserter(_out), fmt, std::forward<Args>(args)...);
+        end_line();
+    }
+
+    void blank()
+    {
+        line(std::string_view{});
+    }
+
+    /*
+     * Blank line before the next line written, if there is one
+     */
+    void separate()
+    {
+        _separate = true;
+    }
+
+    struct Indent
+    {
+        explicit Indent(CodeWriter &writer) : _writer{writer}
+        {
+            _writer._depth++;
+        }
+
+        ~Indent()
+        {
+            _writer._depth--;
+        }
+
+        Indent(const Indent &) = delete;
+        Indent &operator=(const Indent &) = delete;
+
+      private:
+        CodeWriter &_writer;
+    };
+
+    /*
+     * Lines written while the result is alive go one level deeper
+     */
+    [[nodiscard]] Indent indent()
+    {
+        return Indent{*this};
+    }
+
+    /*
+     * Items of a list, one per line, each but the last followed by the
+     * separator. Other lines (comments) may come between items
+     */
+    struct List
+    {
+        explicit List(CodeWriter &writer, std::string_view separator = ",")
+            : _writer{writer}, _separator{separator}
+        {
+            _writer._open_lists++;
+        }
+
+        ~List()
+        {
+            _writer._open_lists--;
+        }
+
+        List(const List &) = delete;
+        List &operator=(const List &) = delete;
+
+        void item(std::string_view text)
+        {
+            separate_previous();
+            _writer.line(text);
+            _item_end = _writer._out.size() - 1;
+        }
+
+        template <typename... Args>
+            requires(sizeof...(Args) != 0)
+        void item(std::format_string<Args...> fmt, Args &&...args)
+        {
+            separate_previous();
+            _writer.line(fmt, std::forward<Args>(args)...);
+            _item_end = _writer._out.size() - 1;
+        }
+
+      private:
+        static constexpr size_t no_item = std::string::npos;
+
+        /*
+         * Only lines written after the previous item move
+         */
+        void separate_previous()
+        {
+            if (_item_end != no_item) {
+                _writer._out.insert(_item_end, _separator);
+            }
+        }
+
+        CodeWriter &_writer;
+        std::string_view _separator;
+        size_t _item_end = no_item;
+    };
+
+    /*
+     * Whole output of a writer without a sink
+     */
+    std::pmr::string take()
+    {
+        return std::move(_out);
+    }
+
+    /*
+     * Hands what is left over to the sink
+     */
+    void finish()
+    {
+        if (!_out.empty()) {
+            seal_block();
+        }
+        if (_sealed != 0) {
+            write_blocks();
+        }
+    }
+
+  private:
+    static constexpr size_t indent_width = 4;
+    static constexpr size_t block_size = 16 * 1024;
+    static constexpr size_t blocks_per_write = 4;
+
+    void begin_line()
+    {
+        if (_separate) {
+            _separate = false;
+            _out += '\n';
+        }
+        _line_start = _out.size();
+        _out.append(_depth * indent_width, ' ');
+    }
+
+    void end_line()
+    {
+        if (_out.size() == _line_start + _depth * indent_width) {
+            _out.resize(_line_start);
+        }
+        _out += '\n';
+
+        if (_sink && _open_lists == 0 && _out.size() >= block_size) {
+            seal_block();
+        }
+    }
+
+    /*
+     * Lists keep offsets into the current block, so it is only sealed
+     * with no list open
+     */
+    void seal_block()
+    {
+        if (_sealed == _blocks.size()) {
+            _blocks.emplace_back();
+        }
+        _blocks[_sealed].swap(_out);
+        _out.clear();
+        _sealed++;
+
+        if (_sealed == blocks_per_write) {
+            write_blocks();
+        }
+    }
+
+    void write_blocks()
+    {
+        std::array<std::string_view, blocks_per_write> chunks;
+        for (size_t block_i = 0; block_i != _sealed; ++block_i) {
+            chunks[block_i] = _blocks[block_i];
+        }
+        (*_sink)(std::span{chunks}.first(_sealed));
+
+        for (size_t block_i = 0; block_i != _sealed; ++block_i) {
+            _blocks[block_i].clear();
+        }
+        _sealed = 0;
+    }
+
+    std::pmr::string _out;
+    size_t _depth = 0;
+    size_t _line_start = 0;
+    bool _separate = false;
+    size_t _open_lists = 0;
+
+    const OutputSink *_sink = nullptr;
+    std::pmr::vector<std::pmr::string> _blocks;
+    size_t _sealed = 0;
+};
+
+} // namespace wl_gena
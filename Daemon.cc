@@ -0,0 +1,386 @@
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Daemon.hh"
+
+namespace wl_gena {
+
+namespace {
+
+/*
+ * Wire format, all integers in host byte order:
+ *
+ * request:  u32 count, then count strings: client cwd, argv...
+ * response: u8 status (0 = success), stdout, stderr, error message
+ * string:   u32 size, then size bytes
+ */
+constexpr uint8_t status_success = 0;
+constexpr uint8_t status_failure = 1;
+
+/*
+ * Protects against garbage on the socket making us allocate gigabytes
+ */
+constexpr uint32_t max_message_part_size = 256 * 1024 * 1024;
+
+/*
+ * How long the server waits on one send or recv of a client
+ */
+constexpr std::chrono::seconds client_io_timeout{30};
+
+/*
+ * How long accept waits to be retried after running out of descriptors
+ * or memory, so connections already being served can release some
+ */
+constexpr std::chrono::milliseconds accept_backoff{100};
+
+[[noreturn]] void throw_errno(std::string_view what)
+{
+    std::error_code ec{errno, std::system_category()};
+    throw std::runtime_error{std::format("{} failed: {}", what, ec.message())};
+}
+
+struct FileDescriptor
+{
+    explicit FileDescriptor(int fd) : _fd{fd}
+    {
+    }
+
+    ~FileDescriptor()
+    {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    int get() const
+    {
+        return _fd;
+    }
+
+    FileDescriptor(FileDescriptor &&) = delete;
+    FileDescriptor &operator=(FileDescriptor &&) = delete;
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+  private:
+    int _fd;
+};
+
+void write_all(int fd, std::string_view data)
+{
+    while (!data.empty()) {
+        ssize_t written = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                throw std::runtime_error{"Timed out sending to the peer"};
+            }
+            throw_errno("send");
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+void read_all(int fd, std::span<char> data)
+{
+    while (!data.empty()) {
+        ssize_t got = ::recv(fd, data.data(), data.size(), 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                throw std::runtime_error{"Timed out waiting for the peer"};
+            }
+            throw_errno("recv");
+        }
+        if (got == 0) {
+            throw std::runtime_error{"Unexpected end of server connection"};
+        }
+        data = data.subspan(static_cast<size_t>(got));
+    }
+}
+
+struct MessageWriter
+{
+    void put_u32(uint32_t val)
+    {
+        char bytes[sizeof(val)];
+        std::memcpy(bytes, &val, sizeof(val));
+        out.append(bytes, sizeof(val));
+    }
+
+    void put_string(std::string_view str)
+    {
+        put_u32(str.size());
+        out.append(str);
+    }
+
+    std::string out;
+};
+
+uint32_t read_u32(int fd)
+{
+    uint32_t val;
+    char bytes[sizeof(val)];
+    read_all(fd, bytes);
+    std::memcpy(&val, bytes, sizeof(val));
+    return val;
+}
+
+std::string read_string(int fd)
+{
+    uint32_t size = read_u32(fd);
+    if (size > max_message_part_size) {
+        throw std::runtime_error{
+            std::format("Server message part is too big ({} bytes)", size)};
+    }
+    std::string str(size, '\0');
+    read_all(fd, str);
+    return str;
+}
+
+sockaddr_un make_address(const std::string &socket_path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error{
+            std::format("Socket path [{}] is too long", socket_path)};
+    }
+    std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+    return address;
+}
+
+void serve_connection(int fd, const ServerRequestHandler &handler)
+{
+    char first_byte = 0;
+    if (::recv(fd, &first_byte, 1, MSG_PEEK) == 0) {
+        // Closed without a request, a starting server checking for us
+        return;
+    }
+
+    uint32_t argc = read_u32(fd);
+    if (argc == 0) {
+        throw std::runtime_error{"Request without working directory"};
+    }
+
+    std::string cwd = read_string(fd);
+    std::vector<std::string> argv;
+    for (uint32_t arg_i = 1; arg_i != argc; ++arg_i) {
+        argv.push_back(read_string(fd));
+    }
+
+    std::ostringstream out;
+    std::ostringstream err;
+    uint8_t status = status_success;
+    std::string error_message;
+
+    try {
+        handler(cwd, argv, out, err);
+    } catch (std::exception &e) {
+        status = status_failure;
+        error_message = e.what();
+    }
+
+    MessageWriter response;
+    response.out += static_cast<char>(status);
+    response.put_string(out.view());
+    response.put_string(err.view());
+    response.put_string(error_message);
+    write_all(fd, response.out);
+}
+
+void set_io_timeout(int fd)
+{
+    timeval timeout{};
+    timeout.tv_sec = client_io_timeout.count();
+    for (int option : {SO_RCVTIMEO, SO_SNDTIMEO}) {
+        if (::setsockopt(
+                fd, SOL_SOCKET, option, &timeout, sizeof(timeout)) != 0) {
+            throw_errno("setsockopt");
+        }
+    }
+}
+
+void serve_connection_thread(
+    int fd, std::shared_ptr<const ServerRequestHandler> handler)
+{
+    FileDescriptor connection{fd};
+    try {
+        set_io_timeout(connection.get());
+        serve_connection(connection.get(), *handler);
+    } catch (std::exception &e) {
+        // A broken client must not take the server down
+        std::cerr << std::format("Dropped request: {}\n", e.what());
+    }
+}
+
+/*
+ * Whether a server accepts connections on [address]. A socket file
+ * nobody listens on refuses them
+ */
+bool is_listening(const sockaddr_un &address)
+{
+    FileDescriptor fd{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (fd.get() < 0) {
+        throw_errno("socket");
+    }
+    if (::connect(
+            fd.get(),
+            reinterpret_cast<const sockaddr *>(&address),
+            sizeof(address)) == 0) {
+        return true;
+    }
+    if (errno == EAGAIN) {
+        // Backlog of a live server is full
+        return true;
+    }
+    if (errno == ECONNREFUSED) {
+        return false;
+    }
+    throw_errno("connect");
+}
+
+bool is_transient_accept_error(int error)
+{
+    switch (error) {
+    case EINTR:
+    case ECONNABORTED:
+    case EMFILE:
+    case ENFILE:
+    case ENOBUFS:
+    case ENOMEM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+void serve(
+    const std::string &socket_path,
+    std::shared_ptr<const ServerRequestHandler> handler)
+{
+    sockaddr_un address = make_address(socket_path);
+
+    FileDescriptor listen_fd{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (listen_fd.get() < 0) {
+        throw_errno("socket");
+    }
+
+    struct stat st{};
+    if (::lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        if (is_listening(address)) {
+            throw std::runtime_error{std::format(
+                "A server is already listening on [{}]", socket_path)};
+        }
+        // Stale socket of a previous server
+        ::unlink(socket_path.c_str());
+    }
+
+    if (::bind(
+            listen_fd.get(),
+            reinterpret_cast<const sockaddr *>(&address),
+            sizeof(address)) != 0) {
+        throw_errno(std::format("bind [{}]", socket_path));
+    }
+
+    if (::listen(listen_fd.get(), SOMAXCONN) != 0) {
+        throw_errno("listen");
+    }
+
+    while (true) {
+        int accepted = ::accept4(listen_fd.get(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (accepted < 0) {
+            int error = errno;
+            if (!is_transient_accept_error(error)) {
+                throw_errno("accept");
+            }
+            if (error != EINTR && error != ECONNABORTED) {
+                std::cerr << std::format(
+                    "Warning: accept failed: {}, retrying\n",
+                    std::error_code{error, std::system_category()}.message());
+                std::this_thread::sleep_for(accept_backoff);
+            }
+            continue;
+        }
+
+        try {
+            std::thread{serve_connection_thread, accepted, handler}.detach();
+        } catch (std::exception &e) {
+            ::close(accepted);
+            std::cerr << std::format("Dropped request: {}\n", e.what());
+        }
+    }
+}
+
+bool forward_to_server(
+    const std::string &socket_path, const std::vector<std::string> &argv)
+{
+    sockaddr_un address = make_address(socket_path);
+
+    FileDescriptor fd{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (fd.get() < 0) {
+        throw_errno("socket");
+    }
+
+    if (::connect(
+            fd.get(),
+            reinterpret_cast<const sockaddr *>(&address),
+            sizeof(address)) != 0) {
+        return false;
+    }
+
+    MessageWriter request;
+    request.put_u32(argv.size() + 1);
+    request.put_string(std::filesystem::current_path().string());
+    for (const std::string &arg : argv) {
+        request.put_string(arg);
+    }
+    write_all(fd.get(), request.out);
+
+    char status = 0;
+    read_all(fd.get(), std::span{&status, 1});
+    std::string out = read_string(fd.get());
+    std::string err = read_string(fd.get());
+    std::string error_message = read_string(fd.get());
+
+    std::cout << out;
+    std::cerr << err;
+
+    if (static_cast<uint8_t>(status) != status_success) {
+        throw std::runtime_error{std::move(error_message)};
+    }
+    return true;
+}
+
+} // namespace wl_gena
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace wl_gena {
+
+/*
+ * Handles one forwarded invocation. argv is in the same form as for
+ * wl_gena::main, relative paths in it are relative to [client_cwd], not
+ * to the working directory of the server. Failures are reported by
+ * throwing
+ *
+ * Called concurrently for different connections
+ */
+using ServerRequestHandler = std::function<void(
+    const std::string &client_cwd,
+    const std::vector<std::string> &argv,
+    std::ostream &out,
+    std::ostream &err)>;
+
+/*
+ * Listens on a Unix socket until the process is terminated, serving
+ * every connection on a detached thread of its own. Each of them shares
+ * ownership of [handler], so whatever it captures stays alive for
+ * connections still being served when serve throws
+ *
+ * Throws if another server is listening on [socket_path]; a stale socket
+ * file nobody listens on is replaced. Running out of descriptors or
+ * memory while accepting is reported and retried after a pause
+ *
+ * A client that stalls while sending its request or receiving the
+ * response is dropped after a timeout
+ */
+[[noreturn]] void serve(
+    const std::string &socket_path,
+    std::shared_ptr<const ServerRequestHandler> handler);
+
+/*
+ * Sends argv and the current working directory to the server, copies
+ * its output to std::cout/std::cerr and throws if the request failed
+ *
+ * Returns false without sending anything if no server accepts the
+ * connection, e.g. a stale socket path
+ */
+bool forward_to_server(
+    const std::string &socket_path, const std::vector<std::string> &argv);
+
+} // namespace wl_gena
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <cerrno>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "File.hh"
+
+namespace wl_gena {
+
+namespace {
+
+[[noreturn]] void throw_errno(std::string_view what, const std::string &name)
+{
+    std::error_code ec{errno, std::system_category()};
+    std::string message =
+        std::format("{} [{}] failed: {}", what, name, ec.message());
+    throw std::runtime_error{std::move(message)};
+}
+
+std::string read_stream(int fd, size_t size_hint, const std::string &name)
+{
+    constexpr size_t min_read_size = 64 * 1024;
+
+    std::string out;
+    size_t used = 0;
+    while (true) {
+        if (out.size() - used < min_read_size) {
+            size_t grow_size = std::max(size_hint, min_read_size);
+            out.resize(std::max(out.size() * 2, used + grow_size));
+        }
+
+        ssize_t got = ::read(fd, out.data() + used, out.size() - used);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("read", name);
+        }
+        if (got == 0) {
+            break;
+        }
+        used += static_cast<size_t>(got);
+    }
+
+    out.resize(used);
+    return out;
+}
+
+/*
+ * What [name] ends up naming once every symlink on the way is followed,
+ * also if the last target does not exist yet
+ */
+std::string resolve_symlinks(const std::string &name)
+{
+    constexpr size_t max_links = 40;
+
+    std::filesystem::path path = name;
+    for (size_t link_i = 0; link_i != max_links; ++link_i) {
+        std::error_code ec;
+        if (!std::filesystem::is_symlink(path, ec)) {
+            return path.string();
+        }
+        std::filesystem::path target = std::filesystem::read_symlink(path);
+        path = target.is_absolute() ? target : path.parent_path() / target;
+    }
+    throw std::runtime_error{
+        std::format("Too many levels of symlinks at [{}]", name)};
+}
+
+} // namespace
+
+OpenedFile::OpenedFile(const std::string &name)
+{
+    if (name == "-") {
+        _fd = STDIN_FILENO;
+        _owned = false;
+    } else {
+        _fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fd < 0) {
+            throw_errno("open", name);
+        }
+    }
+
+    if (::fstat(_fd, &_stat) != 0) {
+        int fstat_errno = errno;
+        if (_owned) {
+            ::close(_fd);
+        }
+        errno = fstat_errno;
+        throw_errno("fstat", name);
+    }
+}
+
+OpenedFile::~OpenedFile()
+{
+    if (_owned) {
+        ::close(_fd);
+    }
+}
+
+bool write_file_if_changed(const std::string &name, std::string_view content)
+{
+    FileUpdate update{name};
+    update.write({&content, 1});
+    return update.commit();
+}
+
+void write_chunks(
+    int fd, std::span<const std::string_view> chunks, const std::string &name)
+{
+    constexpr size_t max_iov_count = 64;
+    std::array<iovec, max_iov_count> iov;
+
+    size_t chunk_i = 0;
+    size_t chunk_offset = 0;
+    while (chunk_i != chunks.size()) {
+        size_t iov_count = 0;
+        for (size_t iov_chunk_i = chunk_i;
+             iov_chunk_i != chunks.size() && iov_count != max_iov_count;
+             ++iov_chunk_i) {
+            std::string_view piece = chunks[iov_chunk_i];
+            if (iov_chunk_i == chunk_i) {
+                piece.remove_prefix(chunk_offset);
+            }
+            iov[iov_count++] =
+                iovec{const_cast<char *>(piece.data()), piece.size()};
+        }
+
+        ssize_t written = ::writev(fd, iov.data(), int(iov_count));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("writev", name);
+        }
+
+        size_t left = static_cast<size_t>(written);
+        while (chunk_i != chunks.size() &&
+               left >= chunks[chunk_i].size() - chunk_offset) {
+            left -= chunks[chunk_i].size() - chunk_offset;
+            chunk_i++;
+            chunk_offset = 0;
+        }
+        chunk_offset += left;
+    }
+}
+
+MappedFile::MappedFile(const std::string &name)
+{
+    OpenedFile file{name};
+    if (!S_ISREG(file.stat().st_mode)) {
+        throw std::runtime_error{
+            std::format("Cannot map [{}]: not a regular file", name)};
+    }
+
+    _size = static_cast<size_t>(file.stat().st_size);
+    map(file.fd(), name);
+}
+
+MappedFile::MappedFile(int fd, size_t size, const std::string &name)
+    : _size{size}
+{
+    map(fd, name);
+}
+
+void MappedFile::map(int fd, const std::string &name)
+{
+    if (_size == 0) {
+        return;
+    }
+
+    void *data =
+        ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (data == MAP_FAILED) {
+        throw_errno("mmap", name);
+    }
+    _data = data;
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data) {
+        ::munmap(_data, _size);
+    }
+}
+
+InputFile::InputFile(const std::string &name)
+{
+    OpenedFile file{name};
+
+    size_t size = static_cast<size_t>(file.stat().st_size);
+    if (S_ISREG(file.stat().st_mode) && size != 0) {
+        _mapped.emplace(file.fd(), size, name);
+        return;
+    }
+
+    _buffer = read_stream(file.fd(), size, name);
+}
+
+FileUpdate::FileUpdate(std::string name) : _name{resolve_symlinks(name)}
+{
+    struct stat existing_stat{};
+    if (::stat(_name.c_str(), &existing_stat) == 0 &&
+        S_ISREG(existing_stat.st_mode)) {
+        _existing.emplace(_name);
+        _existing_mode = existing_stat.st_mode & 07777;
+    }
+}
+
+FileUpdate::~FileUpdate()
+{
+    remove_temporary();
+}
+
+std::string_view FileUpdate::existing() const
+{
+    if (!_existing) {
+        return {};
+    }
+    return _existing->view();
+}
+
+void FileUpdate::write(std::span<const std::string_view> chunks)
+{
+    if (_tmp_fd < 0) {
+        while (!chunks.empty() &&
+               existing().substr(_matched, chunks.front().size()) ==
+                   chunks.front()) {
+            _matched += chunks.front().size();
+            chunks = chunks.subspan(1);
+        }
+        if (chunks.empty()) {
+            return;
+        }
+        start_temporary();
+    }
+
+    write_chunks(_tmp_fd, chunks, _tmp_name);
+}
+
+bool FileUpdate::commit()
+{
+    if (_tmp_fd < 0) {
+        bool unchanged = _existing && _matched == existing().size();
+        if (unchanged) {
+            return false;
+        }
+        start_temporary();
+    }
+
+    try {
+        if (::close(std::exchange(_tmp_fd, -1)) != 0) {
+            throw_errno("close", _tmp_name);
+        }
+        std::filesystem::rename(_tmp_name, _name);
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(_tmp_name, ec);
+        throw;
+    }
+    return true;
+}
+
+/*
+ * Starts the temporary file with the part of the current file that
+ * matched so far
+ */
+void FileUpdate::start_temporary()
+{
+    _tmp_name = std::format(
+        "{}.{}.{}.tmp",
+        _name,
+        ::getpid(),
+        std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+    _tmp_fd = ::open(
+        _tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (_tmp_fd < 0) {
+        throw_errno("open", _tmp_name);
+    }
+
+    if (_existing_mode && ::fchmod(_tmp_fd, _existing_mode.value()) != 0) {
+        int fchmod_errno = errno;
+        remove_temporary();
+        errno = fchmod_errno;
+        throw_errno("fchmod", _tmp_name);
+    }
+
+    std::string_view matched = existing().substr(0, _matched);
+    write_chunks(_tmp_fd, {&matched, 1}, _tmp_name);
+}
+
+void FileUpdate::remove_temporary()
+{
+    if (_tmp_fd < 0) {
+        return;
+    }
+    ::close(std::exchange(_tmp_fd, -1));
+    std::error_code ec;
+    std::filesystem::remove(_tmp_name, ec);
+}
+
+} // namespace wl_gena
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <sys/stat.h>
+
+namespace wl_gena {
+
+/*
+ * Read-only descriptor of an input file, "-" is stdin
+ */
+struct OpenedFile
+{
+    explicit OpenedFile(const std::string &name);
+    ~OpenedFile();
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+    const struct stat &stat() const
+    {
+        return _stat;
+    }
+
+    OpenedFile(OpenedFile &&) = delete;
+    OpenedFile &operator=(OpenedFile &&) = delete;
+    OpenedFile(const OpenedFile &) = delete;
+    OpenedFile &operator=(const OpenedFile &) = delete;
+
+  private:
+    int _fd = -1;
+    bool _owned = true;
+    struct stat _stat{};
+};
+
+/*
+ * Atomically replaces the file with content (temporary file + rename)
+ * unless it already holds exactly that content, in which case the file
+ * and its mtime are left untouched
+ *
+ * A symlink is followed and its target replaced, and a replaced file
+ * keeps its permission bits
+ *
+ * Returns true if the file was written
+ */
+bool write_file_if_changed(const std::string &name, std::string_view content);
+
+/*
+ * Writes all of [chunks] with writev, resuming after partial writes;
+ * [name] is for error messages
+ */
+void write_chunks(
+    int fd, std::span<const std::string_view> chunks, const std::string &name);
+
+/*
+ * Read-only private mapping of a whole regular file
+ */
+struct MappedFile
+{
+    explicit MappedFile(const std::string &name);
+    MappedFile(int fd, size_t size, const std::string &name);
+    ~MappedFile();
+
+    std::string_view view() const
+    {
+        return {static_cast<const char *>(_data), _size};
+    }
+
+    MappedFile(MappedFile &&) = delete;
+    MappedFile &operator=(MappedFile &&) = delete;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+  private:
+    void map(int fd, const std::string &name);
+
+    void *_data = nullptr;
+    size_t _size = 0;
+};
+
+/*
+ * Whole content of an input file without intermediate copies
+ *
+ * Regular files are mapped, pipes, sockets, character devices and "-"
+ * (stdin) are read into one buffer
+ */
+struct InputFile
+{
+    explicit InputFile(const std::string &name);
+
+    std::string_view view() const
+    {
+        if (_mapped) {
+            return _mapped->view();
+        }
+        return _buffer;
+    }
+
+    InputFile(InputFile &&) = delete;
+    InputFile &operator=(InputFile &&) = delete;
+    InputFile(const InputFile &) = delete;
+    InputFile &operator=(const InputFile &) = delete;
+
+  private:
+    std::optional<MappedFile> _mapped;
+    std::string _buffer;
+};
+
+/*
+ * write_file_if_changed() for content that arrives in pieces
+ *
+ * Pieces are compared with the current file as they come, and a
+ * temporary file is only started at the first difference. An unchanged
+ * output is never written, a changed one is never held in memory whole.
+ * Without commit() the file is left as it was
+ */
+struct FileUpdate
+{
+    explicit FileUpdate(std::string name);
+    ~FileUpdate();
+
+    void write(std::span<const std::string_view> chunks);
+
+    /*
+     * Returns true if the file was written
+     */
+    bool commit();
+
+    FileUpdate(FileUpdate &&) = delete;
+    FileUpdate &operator=(FileUpdate &&) = delete;
+    FileUpdate(const FileUpdate &) = delete;
+    FileUpdate &operator=(const FileUpdate &) = delete;
+
+  private:
+    std::string_view existing() const;
+    void start_temporary();
+    void remove_temporary();
+
+    /*
+     * With symlinks resolved
+     */
+    std::string _name;
+    std::optional<MappedFile> _existing;
+    std::optional<mode_t> _existing_mode;
+    size_t _matched = 0;
+
+    std::string _tmp_name;
+    int _tmp_fd = -1;
+};
+
+} // namespace wl_gena
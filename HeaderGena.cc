@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <format>
+#include <memory>
 #include <optional>
 #include <ranges>
 #include <source_location>
@@ -10,7 +11,6 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
-#include <variant>
 #include <vector>
 
 #include <cctype>
@@ -18,9 +18,11 @@
 #include <cstdint>
 #include <cstdlib>
 
+#include "CodeWriter.hh"
+#include "File.hh"
 #include "HeaderGena.hh"
-#include "StringList.hh"
 #include "Types.hh"
+#include "XmlTokenizer.hh"
 
 namespace {
 std::string_view func(std::source_location s = std::source_location::current())
@@ -28,747 +30,1403 @@ std::string_view func(std::source_location s = std::source_location::current())
     return s.function_name();
 }
 
-StringList indent(StringList &in)
+/*
+ * std::format into a string allocated from [resource]
+ */
+template <typename... Args>
+std::pmr::string format_in(
+    std::pmr::memory_resource *resource,
+    std::format_string<Args...> fmt,
+    Args &&...args)
 {
-    StringList o;
-    for (const std::string &str : in.get()) {
-        o += std::format("    {}", str);
+    std::pmr::string o{resource};
+    std::format_to(std::back_inserter(o), fmt, std::forward<Args>(args)...);
+    return o;
+}
+
+/*
+ * Text that cannot end the comment it is put in
+ */
+std::pmr::string
+    comment_text(std::string_view text, std::pmr::memory_resource *resource)
+{
+    std::pmr::string o{resource};
+    for (char c : text) {
+        if (c == '/' && o.ends_with('*')) {
+            o += '\\';
+        }
+        o += c;
     }
     return o;
 }
 
+constexpr std::string_view doc_blank = " \t\r";
+
+bool has_doc_text(std::string_view text)
+{
+    return text.find_first_not_of(" \t\r\n") != std::string_view::npos;
+}
+
+/*
+ * Calls [line_fn] for every line of description text, without the
+ * indentation all its lines share and without blank lines around it
+ */
+template <typename LineFn>
+void for_each_doc_line(std::string_view text, LineFn line_fn)
+{
+    auto trimmed = [](auto line) {
+        std::string_view str{line.begin(), line.end()};
+        size_t last = str.find_last_not_of(doc_blank);
+        if (last == std::string_view::npos) {
+            return std::string_view{};
+        }
+        return str.substr(0, last + 1);
+    };
+
+    size_t common_indent = std::string_view::npos;
+    for (std::string_view str : std::views::split(text, '\n') |
+                                    std::views::transform(trimmed)) {
+        if (!str.empty()) {
+            common_indent =
+                std::min(common_indent, str.find_first_not_of(doc_blank));
+        }
+    }
+
+    bool has_text = false;
+    size_t blank_run = 0;
+    for (std::string_view str : std::views::split(text, '\n') |
+                                    std::views::transform(trimmed)) {
+        if (str.empty()) {
+            blank_run += has_text ? 1 : 0;
+            continue;
+        }
+        for (; blank_run != 0; --blank_run) {
+            line_fn(std::string_view{});
+        }
+        has_text = true;
+        line_fn(str.substr(common_indent));
+    }
+}
+
+/*
+ * Comment line of description text
+ */
+void doc_text_line(
+    wl_gena::CodeWriter &w,
+    std::string_view line,
+    std::pmr::memory_resource *resource)
+{
+    if (line.empty()) {
+        w.line(" *");
+        return;
+    }
+    w.line(" * {}", comment_text(line, resource));
+}
+
+/*
+ * @param / @return line of a doc comment, for things documented by their
+ * summary
+ */
+struct DocTag
+{
+    std::string_view command;
+    std::string_view name;
+    wl_gena::types::Doc doc;
+};
+
+/*
+ * Doxygen comment for documentation the protocol was parsed with, no
+ * lines at all if there is none
+ */
+void doc_comment(
+    wl_gena::CodeWriter &w,
+    wl_gena::types::Doc doc,
+    std::span<const DocTag> tags,
+    std::pmr::memory_resource *resource)
+{
+    std::optional<std::string_view> summary = doc.summary();
+
+    std::string description;
+    if (auto description_xml = doc.description_xml()) {
+        description = wl_gena::decode_character_data(description_xml.value());
+    }
+
+    bool has_tags = std::ranges::any_of(tags, [](const DocTag &tag) {
+        return tag.doc.summary().has_value();
+    });
+
+    if (!summary && !has_doc_text(description) && !has_tags) {
+        return;
+    }
+
+    w.line("/**");
+    bool in_paragraph = false;
+    auto paragraph = [&w, &in_paragraph]() {
+        if (in_paragraph) {
+            w.line(" *");
+        }
+        in_paragraph = true;
+    };
+
+    if (summary) {
+        paragraph();
+        w.line(" * @brief {}", comment_text(summary.value(), resource));
+    }
+
+    if (has_doc_text(description)) {
+        paragraph();
+        for_each_doc_line(description, [&](std::string_view line) {
+            doc_text_line(w, line, resource);
+        });
+    }
+
+    if (has_tags) {
+        paragraph();
+    }
+    for (const DocTag &tag : tags) {
+        auto tag_summary = tag.doc.summary();
+        if (!tag_summary) {
+            continue;
+        }
+        w.line(
+            " * @{}{}{} {}",
+            tag.command,
+            tag.name.empty() ? "" : " ",
+            tag.name,
+            comment_text(tag_summary.value(), resource));
+    }
+    w.line(" */");
+}
+
+void doc_comment(
+    wl_gena::CodeWriter &w,
+    wl_gena::types::Doc doc,
+    std::pmr::memory_resource *resource)
+{
+    doc_comment(w, doc, {}, resource);
+}
+
 } // namespace
 
 namespace wl_gena {
 
 struct InterfaceTraits
 {
-    std::string typename_string;
-    std::string wayland_client_library_typename;
-    std::string wayland_client_core_wl_proxy_typename;
-    std::string wayland_client_core_wl_interface_typename;
-    std::string wayland_client_core_wl_message_typename;
+    InterfaceTraits(
+        std::string_view interface_name, std::pmr::memory_resource *resource)
+        : typename_string{format_in(resource, "{}_traits", interface_name)},
+          wayland_client_library_typename{format_in(
+              resource, "{}::client_library_t", typename_string)},
+          wayland_client_core_wl_proxy_typename{
+              format_in(resource, "{}::wl_proxy_t", typename_string)},
+          wayland_client_core_wl_interface_typename{
+              format_in(resource, "{}::wl_interface_t", typename_string)},
+          wayland_client_core_wl_message_typename{
+              format_in(resource, "{}::wl_message_t", typename_string)},
+          wayland_client_core_wl_argument_typename{
+              format_in(resource, "{}::wl_argument_t", typename_string)}
+    {
+    }
+
+    std::pmr::string typename_string;
+    std::pmr::string wayland_client_library_typename;
+    std::pmr::string wayland_client_core_wl_proxy_typename;
+    std::pmr::string wayland_client_core_wl_interface_typename;
+    std::pmr::string wayland_client_core_wl_message_typename;
+    std::pmr::string wayland_client_core_wl_argument_typename;
 };
 
+/*
+ * Names are views into the protocol arenas, which outlive generation. The
+ * qualified namespace of every protocol is formatted once, lookups only
+ * hash the interface name
+ */
 struct NamespaceInfo
 {
-    NamespaceInfo(
-        const types::Protocol &main_protocol,
-        const std::span<const types::Protocol> context_protocols,
-        std::optional<std::string> top_namespace)
-        : _interface_protocol_map{[&main_protocol, &context_protocols]() {
-              std::unordered_map<std::string, std::string> o;
-
-              auto throw_if_iface_exist =
-                  [&o](
-                      const std::string &iface_name,
-                      const std::string &new_proto_name) {
-                      if (o.contains(iface_name)) {
-                          std::string protocol_with_same_interface =
-                              o.at(iface_name);
-                          std::string message = std::format(
-                              "Found multiple definition of inteface [{}] "
-                              "defined in [{}] and [{}]. "
-                              "Protocol resolution would not be possible",
-                              iface_name,
-                              new_proto_name,
-                              protocol_with_same_interface);
-                          throw std::runtime_error{std::move(message)};
-                      }
-                  };
-
-              for (const types::Interface &iface : main_protocol.interfaces) {
-                  throw_if_iface_exist(iface.name, main_protocol.name);
-                  o[iface.name] = main_protocol.name;
-              }
-
-              for (const types::Protocol &proto : context_protocols) {
-                  const std::string proto_name = proto.name;
-                  for (const types::Interface &iface : proto.interfaces) {
-                      throw_if_iface_exist(iface.name, proto_name);
-                      o[iface.name] = proto_name;
-                  }
-              }
-              return o;
-          }()},
-          _top_namespace{std::move(top_namespace)}
-    {
-    }
-
-    std::string get_namespace(const std::string &interface_name) const
-    {
-        std::optional<std::string> proto_name_op =
-            protocol_by_interface(interface_name);
-        if (!proto_name_op.has_value()) {
-            std::string msg = std::format(
-                "Cannot resolve protocol for [{}] interface", interface_name);
-            throw std::runtime_error{std::move(msg)};
-        }
-        const std::string proto_name = proto_name_op.value();
-
-        std::string upstream_namespace;
-        if (_top_namespace) {
-            upstream_namespace = std::format("::{}", _top_namespace.value());
-        }
-
-        return std::format("{}::{}", upstream_namespace, proto_name);
+    /*
+     * Interface and the qualified namespace of the protocol defining it
+     */
+    struct Binding
+    {
+        types::Interface interface;
+        std::string_view qualified_namespace;
     };
 
-    const std::optional<std::string> &top_namespace() const
+    NamespaceInfo(
+        const types::Protocol &main_protocol,
+        const std::span<const std::shared_ptr<const types::Protocol>>
+            context_protocols,
+        std::optional<std::string_view> top_namespace,
+        std::pmr::memory_resource *resource)
+        : _protocols{resource}, _interface_protocol_map{resource},
+          _top_namespace{top_namespace}
     {
-        return _top_namespace;
+        auto &o = _interface_protocol_map;
+
+        auto throw_if_iface_exist = [this, &o](
+                                        std::string_view iface_name,
+                                        std::string_view new_proto_name) {
+            auto it = o.find(iface_name);
+            if (it != std::end(o)) {
+                std::string_view protocol_with_same_interface =
+                    _protocols[it->second.protocol_index].name;
+                std::string message = std::format(
+                    "Found multiple definition of inteface [{}] "
+                    "defined in [{}] and [{}]. "
+                    "Protocol resolution would not be possible",
+                    iface_name,
+                    new_proto_name,
+                    protocol_with_same_interface);
+                throw std::runtime_error{std::move(message)};
+            }
+        };
+
+        auto add_protocol = [this, &o, &throw_if_iface_exist, resource](
+                                const types::Protocol &proto) {
+            size_t proto_index = _protocols.size();
+            std::pmr::string qualified_namespace{resource};
+            if (_top_namespace) {
+                qualified_namespace =
+                    format_in(resource, "::{}", _top_namespace.value());
+            }
+            std::format_to(
+                std::back_inserter(qualified_namespace), "::{}", proto.name());
+            _protocols.push_back(ProtocolNamespace{
+                proto.name(), std::move(qualified_namespace)});
+
+            o.reserve(o.size() + proto.interfaces().size());
+            for (types::Interface iface : proto.interfaces()) {
+                throw_if_iface_exist(iface.name(), proto.name());
+                o.emplace(iface.name(), InterfaceEntry{iface, proto_index});
+            }
+        };
+
+        add_protocol(main_protocol);
+        for (const auto &proto : context_protocols) {
+            add_protocol(*proto);
+        }
     }
 
-  private:
-    std::optional<std::string>
-        protocol_by_interface(const std::string &interface) const
+    std::optional<Binding> find(std::string_view interface_name) const
     {
-        std::optional<std::string> o;
-        auto it = _interface_protocol_map.find(interface);
+        auto it = _interface_protocol_map.find(interface_name);
         if (it == std::end(_interface_protocol_map)) {
-            return {};
+            return std::nullopt;
         }
-        return it->second;
-    }
-
-    std::unordered_map<std::string, std::string> _interface_protocol_map;
-    std::optional<std::string> _top_namespace;
-};
+        const InterfaceEntry &entry = it->second;
+        return Binding{
+            entry.interface,
+            _protocols[entry.protocol_index].qualified_namespace};
+    };
 
-struct HeaderGenerator
-{
-    HeaderGenerator(
-        const types::Protocol &protocol, const NamespaceInfo &ns_info)
-        : _protocol{protocol}, _ns_info{ns_info}
+    const std::optional<std::string_view> &top_namespace() const
     {
+        return _top_namespace;
     }
 
-    StringList generate() const;
-    StringList emit_object_forward() const;
+  private:
+    struct ProtocolNamespace
+    {
+        std::string_view name;
+        std::pmr::string qualified_namespace;
+    };
 
-    std::vector<std::string> &includes()
+    struct InterfaceEntry
     {
-        return _includes;
-    }
+        types::Interface interface;
+        size_t protocol_index;
+    };
 
-  private:
-    const types::Protocol &_protocol;
-    const NamespaceInfo &_ns_info;
-    std::vector<std::string> _includes;
+    std::pmr::vector<ProtocolNamespace> _protocols;
+    std::pmr::unordered_map<std::string_view, InterfaceEntry>
+        _interface_protocol_map;
+    std::optional<std::string_view> _top_namespace;
 };
 
-struct InterfaceGenerator
+/*
+ * Resolved IR of the protocol a header is generated for
+ *
+ * Every interface, enum and arg reference is bound to the protocol that
+ * defines it, and the C++ types emitters print for it are formatted here
+ * once. Tables run parallel to the records of the protocol, the type
+ * strings live as long as the resolution does
+ *
+ * All references that cannot be resolved are reported in one error
+ */
+struct ResolvedProtocol
 {
-    InterfaceGenerator(
-        const wl_gena::types::Interface &interface,
-        const NamespaceInfo &ns_info)
-        : _interface{interface}, _ns_info{ns_info}
-    {
-        _traits.typename_string = std::format("{}_traits", _interface.name);
-        _traits.wayland_client_library_typename =
-            std::format("{}::client_library_t", _traits.typename_string);
-        _traits.wayland_client_core_wl_interface_typename =
-            std::format("{}::wl_interface_t", _traits.typename_string);
-        _traits.wayland_client_core_wl_proxy_typename =
-            std::format("{}::wl_proxy_t", _traits.typename_string);
-        _traits.wayland_client_core_wl_message_typename =
-            std::format("{}::wl_message_t", _traits.typename_string);
-    }
-
-    StringList generate() const;
-    StringList emit_enums() const;
-    static StringList emit_enum(const wl_gena::types::Enum &eenum);
-    StringList emit_interface_event_listener_type() const;
-    StringList emit_interface_listener_type_event(size_t event_index) const;
-    StringList emit_interface_add_listener_member_fn() const;
-    StringList emit_interface_requests() const;
-    StringList emit_interface_destroy_proxy() const;
+    struct Interface
+    {
+        Interface(
+            std::string_view interface_name,
+            std::pmr::memory_resource *resource)
+            : traits{interface_name, resource}
+        {
+        }
 
-    InterfaceGenerator(const InterfaceGenerator &) = delete;
-    InterfaceGenerator(InterfaceGenerator &&) = delete;
-    InterfaceGenerator &operator=(const InterfaceGenerator &) = delete;
-    InterfaceGenerator &operator=(InterfaceGenerator &&) = delete;
+        InterfaceTraits traits;
+        /*
+         * <ns>::<interface><<interface>_traits>::handle_t
+         */
+        std::string_view handle_type;
+    };
 
-  private:
-    const wl_gena::types::Interface &_interface;
-    const NamespaceInfo &_ns_info;
-    InterfaceTraits _traits;
-};
+    struct Arg
+    {
+        /*
+         * Parameter type, empty for new_id args without interface
+         */
+        std::string_view type;
+        /*
+         * Entry of the rtti types array
+         */
+        std::string_view rtti_type = "nullptr";
+    };
 
-struct RequestGenerator
-{
-    struct NewIDArg
+    /*
+     * For a request whose first new_id arg has an interface
+     */
+    struct Request
     {
-        std::string name;
-        wl_gena::types::ArgTypes::NewID arg;
+        /*
+         * Handle of the new object, in the traits of the request interface
+         */
+        std::string_view return_handle_type;
+        /*
+         * rtti interface of the new object, passed to marshalling
+         */
+        std::string_view return_rtti_interface;
     };
 
-    RequestGenerator(
-        const wl_gena::types::Request &request,
-        const InterfaceTraits &traits,
+    ResolvedProtocol(
+        const types::Protocol &protocol,
         const NamespaceInfo &ns_info,
-        std::string interface_name,
-        std::string request_index_name)
-        : _request{request}, _traits{traits}, _ns_info{ns_info},
-          _interface_name{std::move(interface_name)},
-          _request_index_name{std::move(request_index_name)},
-          _first_arg_name{std::format("{}_ptr", _interface_name)},
-          _new_id_inteface_name{"interface"}
+        std::pmr::memory_resource *resource)
+        : _protocol{protocol}, _top_namespace{ns_info.top_namespace()},
+          _interfaces{resource},
+          _args(protocol.arg_records.size(), resource),
+          _requests(protocol.request_records.size(), resource),
+          _type_strings{resource}, _scratch{resource}
     {
-        namespace V = std::views;
+        std::string unresolved;
+
+        _interfaces.reserve(protocol.interface_records.size());
+        for (types::Interface iface : protocol.interfaces()) {
+            Interface &resolved =
+                _interfaces.emplace_back(iface.name(), resource);
+            resolved.handle_type = keep(
+                "{}::{}<{}>::handle_t",
+                ns_info.find(iface.name()).value().qualified_namespace,
+                iface.name(),
+                resolved.traits.typename_string);
+
+            Scope scope{ns_info, iface, resolved.traits, unresolved};
+            for (types::Message request : iface.requests()) {
+                resolve_message(scope, request);
+                resolve_request(scope, request);
+            }
+            for (types::Message event : iface.events()) {
+                resolve_message(scope, event);
+            }
+        }
 
-        using Arg = wl_gena::types::Arg;
-        using NewID = wl_gena::types::ArgTypes::NewID;
+        if (!unresolved.empty()) {
+            std::string message = std::format(
+                "Cannot resolve references of protocol [{}]:{}",
+                protocol.name(),
+                unresolved);
+            throw std::runtime_error{std::move(message)};
+        }
+    }
 
-        auto is_new_id = [](const Arg &arg) {
-            return std::holds_alternative<NewID>(arg.type);
-        };
+    ResolvedProtocol(const ResolvedProtocol &) = delete;
+    ResolvedProtocol &operator=(const ResolvedProtocol &) = delete;
 
-        auto to_new_id_arg = [](const Arg &arg) {
-            return NewIDArg{arg.name, std::get<NewID>(arg.type)};
-        };
+    const Interface &interface_of(types::Interface iface) const
+    {
+        return _interfaces[iface.record - _protocol.interface_records.data()];
+    }
 
-        _new_ids = std::ranges::to<std::vector>(
-            _request.args | V::filter(is_new_id) | V::transform(to_new_id_arg));
-        if (!_new_ids.empty()) {
-            _return_type = _new_ids[0];
-        }
+    const Arg &arg_of(types::Arg arg) const
+    {
+        return _args[arg.record - _protocol.arg_records.data()];
     }
 
-    StringList emit_interface_request() const;
-    StringList emit_interface_request_signature_args() const;
-    StringList emit_interface_request_body() const;
+    const Request &request_of(types::Message request) const
+    {
+        return _requests[request.record - _protocol.request_records.data()];
+    }
 
-  private:
-    const wl_gena::types::Request &_request;
-    const InterfaceTraits &_traits;
-    const NamespaceInfo &_ns_info;
-    std::string _interface_name;
-    std::string _request_index_name;
+    const std::optional<std::string_view> &top_namespace() const
+    {
+        return _top_namespace;
+    }
 
-    std::vector<NewIDArg> _new_ids;
+  private:
+    /*
+     * Interface whose messages are resolved
+     */
+    struct Scope
+    {
+        const NamespaceInfo &ns_info;
+        types::Interface interface;
+        const InterfaceTraits &traits;
+        std::string &unresolved;
+
+        std::optional<NamespaceInfo::Binding> bind(
+            std::string_view interface_name,
+            types::Message msg,
+            types::Arg arg) const
+        {
+            auto binding = ns_info.find(interface_name);
+            if (!binding) {
+                report("interface", interface_name, msg, arg);
+            }
+            return binding;
+        }
 
-    std::optional<NewIDArg> _return_type;
-    std::string _first_arg_name;
-    std::string _new_id_inteface_name;
-};
+        void report(
+            std::string_view what,
+            std::string_view name,
+            types::Message msg,
+            types::Arg arg) const
+        {
+            std::format_to(
+                std::back_inserter(unresolved),
+                "\n    {} [{}] of [{}.{}.{}]",
+                what,
+                name,
+                interface.name(),
+                msg.name(),
+                arg.name());
+        }
+    };
 
-struct TypeToStringVisitor
-{
-    explicit TypeToStringVisitor(
-        const InterfaceTraits &traits, const NamespaceInfo &ns_info)
-        : _traits{traits}, _ns_info{ns_info}
+    static bool has_enum(types::Interface iface, std::string_view enum_name)
     {
+        return std::ranges::any_of(iface.enums(), [&](types::Enum e) {
+            return e.name() == enum_name;
+        });
     }
+
     /*
-         * from wayland-scanner
-        static void emit_type(struct arg *a)
-        {
-            switch (a->type) {
-            default:
-            case INT:
-            case FD:
-                printf("int32_t ");
+     * From wayland-scanner, for reference
+     *
+     * static void emit_type(struct arg *a)
+     * {
+     *     switch (a->type) {
+     *     default:
+     *     case INT:
+     *     case FD:
+     *         printf("int32_t ");
+     *         break;
+     *     case NEW_ID:
+     *     case UNSIGNED:
+     *         printf("uint32_t ");
+     *         break;
+     *     case FIXED:
+     *         printf("wl_fixed_t ");
+     *         break;
+     *     case STRING:
+     *         printf("const char *");
+     *         break;
+     *     case OBJECT:
+     *         printf("struct %s *", a->interface_name);
+     *         break;
+     *     case ARRAY:
+     *         printf("struct wl_array *");
+     *         break;
+     *     }
+     * }
+     */
+    void resolve_message(const Scope &scope, types::Message msg)
+    {
+        using Kind = types::ArgKind;
+
+        for (types::Arg arg : msg.args()) {
+            Arg &resolved = _args[arg.record - _protocol.arg_records.data()];
+
+            switch (arg.kind()) {
+            case Kind::Int:
+                resolved.type = "int32_t";
+                break;
+            case Kind::FD:
+                resolved.type = "/* fd */ int32_t";
+                break;
+            case Kind::UInt:
+                resolved.type = "uint32_t";
                 break;
-            case NEW_ID:
-            case UNSIGNED:
-                printf("uint32_t ");
+            case Kind::UIntEnum:
+                resolved.type = resolve_enum(scope, msg, arg);
                 break;
-            case FIXED:
-                printf("wl_fixed_t ");
+            case Kind::Fixed:
+                resolved.type = "/* wl_fixed_t */ int32_t";
                 break;
-            case STRING:
-                printf("const char *");
+            case Kind::String:
+                resolved.type = "const char *";
                 break;
-            case OBJECT:
-                printf("struct %s *", a->interface_name);
+            case Kind::NullString:
+                resolved.type = "/* nullptr */ const char *";
                 break;
-            case ARRAY:
-                printf("struct wl_array *");
+            case Kind::Array:
+                resolved.type = "struct wl_array *";
+                break;
+            case Kind::Object:
+            case Kind::NullObject:
+            case Kind::NewID:
+                resolve_object(scope, msg, arg, resolved);
                 break;
             }
         }
-        */
-
-    using ArgTypes = wl_gena::types::ArgTypes;
-
-#define OVERLOAD(TYPE, type_literal)                                           \
-    std::string operator()(ArgTypes::TYPE)                                     \
-    {                                                                          \
-        return type_literal;                                                   \
     }
 
-    OVERLOAD(Int, "int32_t");
-    OVERLOAD(FD, "/* fd */ int32_t");
-
-    std::string operator()(ArgTypes::NewID id)
+    void resolve_object(
+        const Scope &scope, types::Message msg, types::Arg arg, Arg &resolved)
     {
-        return std::format(
-            "/* new_id {} */ uint32_t", id.interface_name.value());
-    };
+        using Kind = types::ArgKind;
 
-    OVERLOAD(UInt, "uint32_t");
+        std::string_view comment =
+            arg.kind() == Kind::Object ? "object" : "nullptr<object>";
 
-    std::string operator()(ArgTypes::UIntEnum e)
-    {
-        std::string enum_typename = e.name;
-        if (e.interface_name.has_value()) {
+        auto interface_name = arg.interface_name();
+        if (!interface_name) {
+            if (arg.kind() != Kind::NewID) {
+                resolved.type = keep("/* {} */ void*", comment);
+            }
+            return;
+        }
 
-            const std::string &interface_name = e.interface_name.value();
-            std::string interface_type = std::format(
-                "{}::{}<{}>",
-                _ns_info.get_namespace(interface_name),
-                interface_name,
-                _traits.typename_string);
+        auto binding = scope.bind(interface_name.value(), msg, arg);
+        if (!binding) {
+            return;
+        }
 
-            enum_typename =
-                std::format("typename {}::{}", interface_type, enum_typename);
+        resolved.rtti_type = rtti_interface(*binding, "traits");
+        if (arg.kind() == Kind::NewID) {
+            resolved.type =
+                keep("/* new_id {} */ uint32_t", interface_name.value());
+            return;
         }
-        return std::format("{}_e", enum_typename);
-    };
+        resolved.type = keep(
+            "/* {} */ typename {}::{}<{}>::handle_t*",
+            comment,
+            binding->qualified_namespace,
+            interface_name.value(),
+            scope.traits.typename_string);
+    }
 
-    OVERLOAD(Fixed, "/* wl_fixed_t */ int32_t");
+    std::string_view resolve_enum(
+        const Scope &scope, types::Message msg, types::Arg arg)
+    {
+        std::string_view enum_name = arg.enum_name();
 
-    OVERLOAD(String, "const char *");
-    OVERLOAD(NullString, "/* nullptr */ const char *");
+        auto interface_name = arg.interface_name();
+        if (!interface_name) {
+            if (!has_enum(scope.interface, enum_name)) {
+                scope.report("enum", enum_name, msg, arg);
+            }
+            return keep("{}_e", enum_name);
+        }
 
-    std::string object_interface_name(
-        wl_gena::types::InterfaceNameable &iface, const std::string &comment)
-    {
-        if (!iface.interface_name.has_value()) {
-            return std::format("/* {} */ void*", comment);
+        auto binding = scope.bind(interface_name.value(), msg, arg);
+        if (!binding) {
+            return {};
+        }
+        if (!has_enum(binding->interface, enum_name)) {
+            std::string qualified_enum =
+                std::format("{}.{}", interface_name.value(), enum_name);
+            scope.report("enum", qualified_enum, msg, arg);
         }
-        const std::string &interface_name = iface.interface_name.value();
+        return keep(
+            "typename {}::{}<{}>::{}_e",
+            binding->qualified_namespace,
+            interface_name.value(),
+            scope.traits.typename_string,
+            enum_name);
+    }
 
-        std::string interface_type = std::format(
-            "{}::{}<{}>",
-            _ns_info.get_namespace(interface_name),
-            interface_name,
-            _traits.typename_string);
+    void resolve_request(const Scope &scope, types::Message request)
+    {
+        for (types::Arg arg : request.args()) {
+            if (arg.kind() != types::ArgKind::NewID) {
+                continue;
+            }
+            auto interface_name = arg.interface_name();
+            if (!interface_name) {
+                return;
+            }
+            /*
+             * Unresolved interfaces are reported with the arg
+             */
+            auto binding = scope.ns_info.find(interface_name.value());
+            if (!binding) {
+                return;
+            }
 
-        return std::format(
-            "/* {} */ typename {}::handle_t*", comment, interface_type);
+            Request &resolved = _requests
+                [request.record - _protocol.request_records.data()];
+            resolved.return_handle_type = keep(
+                "{}::{}<{}>::handle_t",
+                binding->qualified_namespace,
+                interface_name.value(),
+                scope.traits.typename_string);
+            resolved.return_rtti_interface =
+                rtti_interface(*binding, scope.traits.typename_string);
+            return;
+        }
     }
 
-    std::string operator()(ArgTypes::Object obj)
+    std::string_view rtti_interface(
+        const NamespaceInfo::Binding &binding, std::string_view traits)
     {
-        return object_interface_name(obj, "object");
-    };
+        return keep(
+            "&{}::rtti<{}>::{}_interface",
+            binding.qualified_namespace,
+            traits,
+            binding.interface.name());
+    }
 
-    std::string operator()(ArgTypes::NullObject obj)
+    /*
+     * Formats into a string that lives as long as the resolution
+     */
+    template <typename... Args>
+    std::string_view keep(std::format_string<Args...> fmt, Args &&...args)
     {
-        return object_interface_name(obj, "nullptr<object>");
-    };
-
-    OVERLOAD(Array, "struct wl_array *")
+        _scratch.clear();
+        std::format_to(
+            std::back_inserter(_scratch), fmt, std::forward<Args>(args)...);
+        char *chars =
+            static_cast<char *>(_type_strings.allocate(_scratch.size(), 1));
+        std::ranges::copy(_scratch, chars);
+        return std::string_view{chars, _scratch.size()};
+    }
 
-#undef OVERLOAD
+    const types::Protocol &_protocol;
+    std::optional<std::string_view> _top_namespace;
+    std::pmr::vector<Interface> _interfaces;
+    std::pmr::vector<Arg> _args;
+    std::pmr::vector<Request> _requests;
 
-  private:
-    const InterfaceTraits &_traits;
-    const NamespaceInfo &_ns_info;
+    std::pmr::monotonic_buffer_resource _type_strings;
+    std::pmr::string _scratch;
 };
 
-StringList InterfaceGenerator::emit_interface_listener_type_event(
-    size_t event_index) const
+/*
+ * Optional parts of the generated code, see GenerateHeaderInput
+ */
+struct EmitOptions
 {
-    StringList o;
-    o += std::format("// {}", func());
-
-    StringList args;
+    bool dispatchers = false;
+    bool array_marshalling = false;
+    bool wire_encoders = false;
+    bool wire_decoders = false;
+    bool static_library = false;
 
-    const types::Event &ev = _interface.events.at(event_index);
-
-    args += "void *data";
+    /*
+     * How member functions call into the client library [L]
+     */
+    std::string_view library_call() const
+    {
+        return static_library ? "L::" : "L.";
+    }
+};
 
-    std::string interface_type = std::format(
-        "{}::{}<{}>",
-        _ns_info.get_namespace(_interface.name),
-        _interface.name,
-        _traits.typename_string);
-    std::string handle_type_str = std::format("{}::handle_t", interface_type);
-    args += std::format("{} *handle", handle_type_str);
+/*
+ * Keeps the phase hook told which phase is active
+ */
+struct PhaseSwitch
+{
+    explicit PhaseSwitch(const HeaderPhaseHook &hook) : _hook{hook}
+    {
+    }
 
-    for (auto &arg : ev.args) {
-        std::string type_string =
-            std::visit(TypeToStringVisitor{_traits, _ns_info}, arg.type);
-        args += std::format("{} {}", type_string, arg.name);
+    ~PhaseSwitch()
+    {
+        leave();
     }
 
-    auto rargs = std::views::reverse(args.get());
+    PhaseSwitch(const PhaseSwitch &) = delete;
+    PhaseSwitch &operator=(const PhaseSwitch &) = delete;
 
-    bool first = true;
-    for (auto &arg : rargs) {
-        std::string val = arg;
-        if (!first) {
-            val += ',';
+    void enter(HeaderPhase phase)
+    {
+        leave();
+        if (_hook) {
+            _hook(phase, true);
         }
-        first = false;
-        arg = std::move(val);
+        _current = phase;
     }
 
-    o += std::format("using {}_FN = void(", ev.name);
-    o += indent(args);
-    o += ");";
-    o += std::format("{}_FN *{} = nullptr;", ev.name, ev.name);
+    void leave()
+    {
+        if (_current && _hook) {
+            _hook(_current.value(), false);
+        }
+        _current.reset();
+    }
 
-    return o;
-}
+  private:
+    const HeaderPhaseHook &_hook;
+    std::optional<HeaderPhase> _current;
+};
 
-StringList InterfaceGenerator::emit_interface_event_listener_type() const
+struct HeaderGenerator
 {
-    if (_interface.events.empty()) {
-        throw std::logic_error("Cannot generate listener for empty events");
+    HeaderGenerator(
+        const types::Protocol &protocol,
+        const ResolvedProtocol &resolved,
+        PhaseSwitch &phases,
+        std::pmr::memory_resource *resource)
+        : _protocol{protocol}, _resolved{resolved}, _phases{phases},
+          _resource{resource}
+    {
     }
 
-    StringList o;
-    o += std::format("// {}", func());
-    o += "struct listener_t";
-    o += "{";
-    bool first = true;
-    for (size_t event_i = 0; event_i != _interface.events.size(); ++event_i) {
-        if (!first) {
-            o += "";
-        }
-        first = false;
-        auto typedef_str = emit_interface_listener_type_event(event_i);
-        o += indent(typedef_str);
+    void generate(CodeWriter &w) const;
+    void emit_object_forward(CodeWriter &w) const;
+    void emit_copyright(CodeWriter &w) const;
+
+    std::span<const std::string> &includes()
+    {
+        return _includes;
     }
-    o += "};";
 
-    return o;
-}
+    EmitOptions &options()
+    {
+        return _options;
+    }
+
+  private:
+    const types::Protocol &_protocol;
+    const ResolvedProtocol &_resolved;
+    PhaseSwitch &_phases;
+    std::span<const std::string> _includes;
+    EmitOptions _options;
+    std::pmr::memory_resource *_resource;
+};
 
-StringList InterfaceGenerator::emit_interface_add_listener_member_fn() const
+struct InterfaceGenerator
 {
-    StringList o;
-    o += std::format("// {}", func());
+    InterfaceGenerator(
+        wl_gena::types::Interface interface,
+        const ResolvedProtocol &resolved,
+        const EmitOptions &options,
+        std::pmr::memory_resource *resource)
+        : _interface{interface}, _resolved{resolved},
+          _resolved_interface{resolved.interface_of(interface)},
+          _traits{_resolved_interface.traits}, _options{options},
+          _resource{resource}
+    {
+    }
 
-    const std::string &n = _interface.name;
-    const std::string &proxy = _traits.wayland_client_core_wl_proxy_typename;
+    void generate(CodeWriter &w) const;
+    void emit_enums(CodeWriter &w) const;
+    void emit_enum(CodeWriter &w, wl_gena::types::Enum eenum) const;
+    void emit_interface_event_listener_type(CodeWriter &w) const;
+    void emit_interface_listener_type_event(
+        CodeWriter &w, size_t event_index) const;
+    void emit_interface_add_listener_member_fn(CodeWriter &w) const;
+    void emit_interface_dispatch_fn(CodeWriter &w) const;
+    void emit_interface_dispatch_event(
+        CodeWriter &w, size_t event_index) const;
+    void emit_interface_add_dispatcher_member_fn(CodeWriter &w) const;
+    void emit_interface_requests(CodeWriter &w) const;
+    void emit_interface_destroy_proxy(CodeWriter &w) const;
 
-    std::string interface_type = std::format(
-        "{}::{}<{}>", _ns_info.get_namespace(n), n, _traits.typename_string);
+    InterfaceGenerator(const InterfaceGenerator &) = delete;
+    InterfaceGenerator(InterfaceGenerator &&) = delete;
+    InterfaceGenerator &operator=(const InterfaceGenerator &) = delete;
+    InterfaceGenerator &operator=(InterfaceGenerator &&) = delete;
 
-    std::string first_arg =
-        std::format("{}::handle_t *{}_handle", interface_type, n);
+  private:
+    wl_gena::types::Interface _interface;
+    const ResolvedProtocol &_resolved;
+    const ResolvedProtocol::Interface &_resolved_interface;
+    const InterfaceTraits &_traits;
+    const EmitOptions &_options;
+    std::pmr::memory_resource *_resource;
+};
 
-    o += std::format(
-        "int add_listener({}, const listener_t *listener, void *data)",
-        first_arg);
-    o += "{";
+/*
+ * The request object is the first argument, named [<interface>_ptr]
+ */
+struct RequestGenerator
+{
+    RequestGenerator(
+        wl_gena::types::Message request,
+        const ResolvedProtocol &resolved,
+        const ResolvedProtocol::Interface &resolved_interface,
+        std::string_view interface_name,
+        const EmitOptions &options,
+        std::pmr::memory_resource *resource)
+        : _request{request}, _resolved{resolved},
+          _resolved_interface{resolved_interface},
+          _resolved_request{resolved.request_of(request)},
+          _traits{resolved_interface.traits},
+          _interface_name{interface_name}, _options{options},
+          _new_ids{resource},
+          _new_id_inteface_name{"interface"}, _resource{resource}
     {
-        StringList b;
-        b += std::format("return L.wl_proxy_add_listener(");
-        b += std::format("    reinterpret_cast<{}*>({}_handle),", proxy, n);
-        b += std::format("    (void (**)(void))listener,");
-        b += std::format("    data");
-        b += std::format(");");
-        o += indent(b);
+        for (wl_gena::types::Arg arg : _request.args()) {
+            if (arg.kind() == wl_gena::types::ArgKind::NewID) {
+                _new_ids.push_back(arg);
+            }
+        }
+        if (!_new_ids.empty()) {
+            _return_type = _new_ids[0];
+        }
     }
-    o += "}";
-    return o;
-}
 
-StringList wl_gena::InterfaceGenerator::emit_enums() const
-{
-    StringList o;
-    o += std::format("// {}", func());
+    void emit_interface_request(CodeWriter &w) const;
+    void emit_interface_request_signature_args(CodeWriter &w) const;
+    void emit_interface_request_body(CodeWriter &w) const;
+    void emit_interface_request_array_args(CodeWriter &w) const;
 
-    bool first = true;
-    for (auto &e : _interface.enums) {
-        if (!first) {
-            o += "";
-        }
-        first = false;
-        o += emit_enum(e);
-    }
+  private:
+    wl_gena::types::Message _request;
+    const ResolvedProtocol &_resolved;
+    const ResolvedProtocol::Interface &_resolved_interface;
+    const ResolvedProtocol::Request &_resolved_request;
+    const InterfaceTraits &_traits;
+    std::string_view _interface_name;
+    const EmitOptions &_options;
 
-    return o;
+    std::pmr::vector<wl_gena::types::Arg> _new_ids;
+
+    std::optional<wl_gena::types::Arg> _return_type;
+    std::string_view _new_id_inteface_name;
+    std::pmr::memory_resource *_resource;
 };
 
-auto wl_gena::InterfaceGenerator::emit_enum(const wl_gena::types::Enum &eenum)
-    -> StringList
+void InterfaceGenerator::emit_interface_listener_type_event(
+    CodeWriter &w, size_t event_index) const
 {
-    StringList o;
-    o += std::format("// {}", func());
+    w.line("// {}", func());
 
-    o += std::format("enum class {}_e", eenum.name);
-    o += "{";
+    const types::Message ev = _interface.events()[event_index];
 
-    StringList es;
-    for (auto &entry : eenum.entries) {
-        std::string val;
-        if (entry.is_hex) {
-            val = std::format("0x{:x}", entry.value);
-        } else {
-            val = std::format("{}", entry.value);
-        }
-        std::string enum_name = entry.name;
-        if (std::isdigit(enum_name.at(0))) {
-            enum_name = std::format("n{}", enum_name);
-        }
+    std::pmr::vector<DocTag> tags{_resource};
+    for (types::Arg arg : ev.args()) {
+        tags.push_back(DocTag{"param", arg.name(), arg.doc()});
+    }
+    doc_comment(w, ev.doc(), tags, _resource);
 
-        auto bad_enum_name = [](const std::string &name) {
-            if (name == "default") {
-                return true;
+    w.line("using {}_FN = void(", ev.name());
+    {
+        auto in = w.indent();
+        CodeWriter::List args{w};
+
+        args.item("void *data");
+        args.item("{} *handle", _resolved_interface.handle_type);
+
+        for (types::Arg arg : ev.args()) {
+            bool untyped_new_id = arg.kind() == types::ArgKind::NewID &&
+                                  !arg.interface_name().has_value();
+            if (untyped_new_id) {
+                args.item("const char *{}_interface", arg.name());
+                args.item("uint32_t {}_version", arg.name());
+                args.item("void *{}", arg.name());
+                continue;
             }
-            return false;
-        };
-
-        if (bad_enum_name(enum_name)) {
-            enum_name = std::format("e{}", enum_name);
+            args.item("{} {}", _resolved.arg_of(arg).type, arg.name());
         }
-        es += std::format("{} = {}", enum_name, val);
     }
+    w.line(");");
+    w.line("{}_FN *{} = nullptr;", ev.name(), ev.name());
+}
 
-    auto rev = std::ranges::views::reverse(es.get());
+void InterfaceGenerator::emit_interface_event_listener_type(
+    CodeWriter &w) const
+{
+    if (_interface.events().empty()) {
+        throw std::logic_error("Cannot generate listener for empty events");
+    }
 
-    bool first = true;
-    for (std::string &s : rev) {
-        if (first) {
-            first = false;
-            continue;
+    w.line("// {}", func());
+    w.line("struct listener_t");
+    w.line("{");
+    {
+        auto in = w.indent();
+        for (size_t event_i = 0; event_i != _interface.events().size();
+             ++event_i) {
+            if (event_i != 0) {
+                w.separate();
+            }
+            emit_interface_listener_type_event(w, event_i);
         }
-        s = std::format("{},", s);
     }
+    w.line("};");
+}
 
-    o += indent(es);
-    o += "};";
-
-    return o;
+void InterfaceGenerator::emit_interface_add_listener_member_fn(
+    CodeWriter &w) const
+{
+    w.line("// {}", func());
+
+    std::string_view n = _interface.name();
+    const std::pmr::string &proxy =
+        _traits.wayland_client_core_wl_proxy_typename;
+
+    w.line(
+        "int add_listener({} *{}_handle, "
+        "const listener_t *listener, void *data)",
+        _resolved_interface.handle_type,
+        n);
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line("return {}wl_proxy_add_listener(", _options.library_call());
+        w.line("    reinterpret_cast<{}*>({}_handle),", proxy, n);
+        w.line("    (void (**)(void))listener,");
+        w.line("    data");
+        w.line(");");
+    }
+    w.line("}");
 }
 
-StringList RequestGenerator::emit_interface_request_signature_args() const
+/*
+ * Handler call of one event: wl_argument members are converted to the
+ * listener_t parameter types. A new_id with interface is signed "i", so
+ * it arrives as the plain id. One without takes three wl_argument slots
+ * ("sun"): the interface name, the version and the new proxy
+ */
+void InterfaceGenerator::emit_interface_dispatch_event(
+    CodeWriter &w, size_t event_index) const
 {
-    using NewID = wl_gena::types::ArgTypes::NewID;
+    using Kind = types::ArgKind;
 
-    StringList args_strings;
-    args_strings += std::format("// {}", func());
+    const types::Message ev = _interface.events()[event_index];
 
-    struct ArgEmitInfo
-    {
-        ArgEmitInfo() : _v{"No diagnostic"}
-        {
-        }
+    std::pmr::string call{_resource};
+    auto o = std::back_inserter(call);
+    std::format_to(o, "handler->{}(handle", ev.name());
 
-        ArgEmitInfo(std::string val) : _v{std::move(val)}
-        {
-        }
-
-        void set_diagnostic(std::string diagnostic)
-        {
-            _v.reset();
-            _diagnostic = std::move(diagnostic);
-        }
+    size_t arg_i = 0;
+    for (types::Arg arg : ev.args()) {
+        const ResolvedProtocol::Arg &resolved = _resolved.arg_of(arg);
 
-        bool has_value() const
-        {
-            return _v.has_value();
+        switch (arg.kind()) {
+        case Kind::Int:
+            std::format_to(o, ", args[{}].i", arg_i);
+            break;
+        case Kind::Fixed:
+            std::format_to(o, ", args[{}].f", arg_i);
+            break;
+        case Kind::FD:
+            std::format_to(o, ", args[{}].h", arg_i);
+            break;
+        case Kind::UInt:
+            std::format_to(o, ", args[{}].u", arg_i);
+            break;
+        case Kind::UIntEnum:
+            std::format_to(
+                o, ", static_cast<{}>(args[{}].u)", resolved.type, arg_i);
+            break;
+        case Kind::String:
+        case Kind::NullString:
+            std::format_to(o, ", args[{}].s", arg_i);
+            break;
+        case Kind::Array:
+            std::format_to(o, ", args[{}].a", arg_i);
+            break;
+        case Kind::Object:
+        case Kind::NullObject:
+            std::format_to(
+                o, ", reinterpret_cast<{}>(args[{}].o)", resolved.type, arg_i);
+            break;
+        case Kind::NewID:
+            if (arg.interface_name()) {
+                std::format_to(
+                    o, ", static_cast<uint32_t>(args[{}].i)", arg_i);
+                break;
+            }
+            std::format_to(
+                o,
+                ", args[{0}].s, args[{1}].u, static_cast<void *>(args[{2}].o)",
+                arg_i,
+                arg_i + 1,
+                arg_i + 2);
+            arg_i += 2;
+            break;
         }
+        arg_i++;
+    }
+    call += ')';
 
-        std::string &value()
-        {
-            return _v.value();
-        }
+    w.line("case event_index_{}:", ev.name());
+    {
+        auto in = w.indent();
+        w.line("if constexpr (requires {{ {}; }}) {{", call);
+        w.line("    {};", call);
+        w.line("}");
+        w.line("return 0;");
+    }
+}
 
-        std::string &diagnostic()
-        {
-            return _diagnostic.value();
+void InterfaceGenerator::emit_interface_dispatch_fn(CodeWriter &w) const
+{
+    w.line("// {}", func());
+
+    bool has_args = false;
+    for (size_t event_i = 0; event_i != _interface.events().size();
+         ++event_i) {
+        w.line(
+            "static constexpr size_t event_index_{} = {};",
+            _interface.events()[event_i].name(),
+            event_i);
+        has_args = has_args || !_interface.events()[event_i].args().empty();
+    }
+    w.blank();
+
+    w.line("/*");
+    w.line(" * Calls handler->event(handle, args...) for the events handler_t");
+    w.line(" * has a member for and skips the others, without libffi");
+    w.line(" */");
+    w.line("template <typename handler_t>");
+    w.line("static int dispatch(");
+    {
+        auto in = w.indent();
+        CodeWriter::List params{w};
+        params.item("const void *handler_ptr");
+        params.item("void *target");
+        params.item("uint32_t opcode");
+        params.item(
+            "const typename {} * /* message */",
+            _traits.wayland_client_core_wl_message_typename);
+        params.item(
+            "typename {} *{}",
+            _traits.wayland_client_core_wl_argument_typename,
+            has_args ? "args" : "/* args */");
+    }
+    w.line(")");
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line(
+            "handler_t *handler = "
+            "static_cast<handler_t *>(const_cast<void *>(handler_ptr));");
+        w.line(
+            "{0} *handle = reinterpret_cast<{0} *>(target);",
+            _resolved_interface.handle_type);
+        w.line("switch (opcode) {");
+        for (size_t event_i = 0; event_i != _interface.events().size();
+             ++event_i) {
+            emit_interface_dispatch_event(w, event_i);
         }
+        w.line("}");
+        w.line("return -1;");
+    }
+    w.line("}");
+}
 
-      private:
-        std::optional<std::string> _v{};
-        std::optional<std::string> _diagnostic{};
-    };
+void InterfaceGenerator::emit_interface_add_dispatcher_member_fn(
+    CodeWriter &w) const
+{
+    w.line("// {}", func());
+
+    std::string_view n = _interface.name();
+    const std::pmr::string &proxy =
+        _traits.wayland_client_core_wl_proxy_typename;
+
+    w.line("template <typename handler_t>");
+    w.line(
+        "int add_dispatcher({} *{}_handle, "
+        "handler_t *handler, void *data = nullptr)",
+        _resolved_interface.handle_type,
+        n);
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line(
+            "return {}wl_proxy_add_dispatcher(", _options.library_call());
+        w.line("    reinterpret_cast<{}*>({}_handle),", proxy, n);
+        w.line("    &dispatch<handler_t>,");
+        w.line("    handler,");
+        w.line("    data");
+        w.line(");");
+    }
+    w.line("}");
+}
 
-    std::vector<ArgEmitInfo> signature_args;
+void wl_gena::InterfaceGenerator::emit_enums(CodeWriter &w) const
+{
+    w.line("// {}", func());
 
-    std::string interface_type = std::format(
-        "{}::{}<{}>",
-        _ns_info.get_namespace(_interface_name),
-        _interface_name,
-        _traits.typename_string);
+    bool first = true;
+    for (types::Enum e : _interface.enums()) {
+        if (!first) {
+            w.separate();
+        }
+        first = false;
+        emit_enum(w, e);
+    }
+};
 
-    signature_args.emplace_back(
-        std::format("{}::handle_t *{}", interface_type, _first_arg_name));
+void wl_gena::InterfaceGenerator::emit_enum(
+    CodeWriter &w, wl_gena::types::Enum eenum) const
+{
+    w.line("// {}", func());
 
-    for (auto &arg : _request.args) {
-        const NewID *arg_new_id_p = std::get_if<NewID>(&arg.type);
-        if (arg_new_id_p != nullptr) {
-            auto arg_interface_name = arg_new_id_p->interface_name;
-            if (!arg_interface_name) {
-                std::string arg_str = std::format(
-                    "const {} *{}",
-                    _traits.wayland_client_core_wl_interface_typename,
-                    _new_id_inteface_name);
-                signature_args.emplace_back(arg_str);
-                signature_args.emplace_back("uint32_t version");
-                continue;
+    doc_comment(w, eenum.doc(), _resource);
+    w.line("enum class {}_e", eenum.name());
+    w.line("{");
+    {
+        auto in = w.indent();
+        CodeWriter::List entries{w};
+
+        for (types::Enum::Entry entry : eenum.entries()) {
+            std::string_view enum_name = entry.name();
+
+            /*
+             * Names that are no C++ identifiers get a prefix
+             */
+            std::string_view prefix;
+            if (std::isdigit(enum_name.at(0))) {
+                prefix = "n";
+            } else if (enum_name == "default") {
+                prefix = "e";
             }
 
-            std::string diagnostic = std::format(
-                "(name=[{}] type=[new_id] interface=[{}])",
-                arg.name,
-                arg_interface_name.value());
-
-            ArgEmitInfo diag_arg;
-            diag_arg.set_diagnostic(diagnostic);
-            signature_args.emplace_back(std::move(diag_arg));
-
-            continue;
+            doc_comment(w, entry.doc(), _resource);
+            if (entry.is_hex()) {
+                entries.item(
+                    "{}{} = 0x{:x}", prefix, enum_name, entry.value());
+            } else {
+                entries.item("{}{} = {}", prefix, enum_name, entry.value());
+            }
         }
-
-        std::string arg_typename =
-            std::visit(TypeToStringVisitor{_traits, _ns_info}, arg.type);
-        signature_args.emplace_back(
-            std::format("{} {}", arg_typename, arg.name));
     }
+    w.line("};");
+}
 
-    auto args_inv = std::ranges::views::reverse(signature_args);
-    bool first = true;
-    for (auto &arg : args_inv) {
-        if (!arg.has_value()) {
-            continue;
-        }
+void RequestGenerator::emit_interface_request_signature_args(
+    CodeWriter &w) const
+{
+    w.line("// {}", func());
 
-        if (!first) {
-            arg.value() = std::format("{},", arg.value());
-        }
-        first = false;
-    }
+    CodeWriter::List args{w};
+    args.item("{} *{}_ptr", _resolved_interface.handle_type, _interface_name);
+
+    for (types::Arg arg : _request.args()) {
+        if (arg.kind() == types::ArgKind::NewID) {
+            auto arg_interface_name = arg.interface_name();
+            if (!arg_interface_name) {
+                args.item(
+                    "const {} *{}",
+                    _traits.wayland_client_core_wl_interface_typename,
+                    _new_id_inteface_name);
+                args.item("uint32_t version");
+                continue;
+            }
 
-    for (auto arg : signature_args) {
-        if (!arg.has_value()) {
-            args_strings += std::format("// [[nogen]]: {}", arg.diagnostic());
+            w.line(
+                "// [[nogen]]: (name=[{}] type=[new_id] interface=[{}])",
+                arg.name(),
+                arg_interface_name.value());
             continue;
         }
-        args_strings += std::move(arg.value());
-    }
 
-    return args_strings;
+        args.item("{} {}", _resolved.arg_of(arg).type, arg.name());
+    }
 }
 
-StringList RequestGenerator::emit_interface_request_body() const
-{
-    StringList o;
-    o += std::format("// {}", func());
-
-    std::string first_arg_proxy_id =
-        std::format("{}_as_proxy", _first_arg_name);
-    std::string first_arg_proxy;
-    first_arg_proxy += std::format(
-        "typename {} *{}",
-        _traits.wayland_client_core_wl_proxy_typename,
-        first_arg_proxy_id);
-    first_arg_proxy +=
-        std::format(" = reinterpret_cast<decltype({})>", first_arg_proxy_id);
-    first_arg_proxy += std::format("({});", _first_arg_name);
-    o += std::move(first_arg_proxy);
-
-    std::optional<std::string> output_identifier;
-    if (_return_type.has_value()) {
-        output_identifier = std::format("out_{}", _return_type.value().name);
-        o += std::format(
-            "typename {} *{} = nullptr;",
-            _traits.wayland_client_core_wl_proxy_typename,
-            output_identifier.value());
-    }
-
-    std::string wl_proxy_marshal_flags_call_start = "L.wl_proxy_marshal_flags(";
-    if (output_identifier) {
-        wl_proxy_marshal_flags_call_start = std::format(
-            "{} = {}",
-            output_identifier.value(),
-            wl_proxy_marshal_flags_call_start);
-    }
-    o += std::move(wl_proxy_marshal_flags_call_start);
-
-    StringList args;
-    args += std::format("{}", first_arg_proxy_id);
-    args += std::string{_request_index_name};
+void RequestGenerator::emit_interface_request_body(CodeWriter &w) const
+{
+    w.line("// {}", func());
 
-    if (_return_type) {
-        const NewIDArg &return_type = _return_type.value();
-        if (return_type.arg.interface_name) {
-            const std::string &interface_name =
-                return_type.arg.interface_name.value();
-
-            std::string rtti_interface_type = std::format(
-                "{}::rtti<{}>",
-                _ns_info.get_namespace(interface_name),
-                _traits.typename_string);
+    std::string_view n = _interface_name;
+    const std::pmr::string &proxy =
+        _traits.wayland_client_core_wl_proxy_typename;
 
-            args += std::format(
-                "&{}::{}_interface", rtti_interface_type, interface_name);
-        } else {
-            args += std::string{_new_id_inteface_name};
-        }
-    } else {
-        args += "nullptr";
+    w.line(
+        "typename {0} *{1}_ptr_as_proxy = "
+        "reinterpret_cast<decltype({1}_ptr_as_proxy)>({1}_ptr);",
+        proxy,
+        n);
+
+    bool array = _options.array_marshalling;
+    std::string_view marshal =
+        array ? "wl_proxy_marshal_array_flags" : "wl_proxy_marshal_flags";
+    if (array) {
+        emit_interface_request_array_args(w);
     }
 
-    if (_return_type && !_return_type.value().arg.interface_name.has_value()) {
-        args += "version";
+    if (_return_type) {
+        w.line(
+            "typename {} *out_{} = nullptr;",
+            proxy,
+            _return_type.value().name());
+        w.line(
+            "out_{} = {}{}(",
+            _return_type.value().name(),
+            _options.library_call(),
+            marshal);
     } else {
-        args += std::format("L.wl_proxy_get_version({})", first_arg_proxy_id);
+        w.line("{}{}(", _options.library_call(), marshal);
     }
 
-    if (_request.destructor) {
-        args += "/* WL_MARSHAL_FLAG_DESTROY */ (1 << 0)";
-    } else {
-        args += "0";
-    }
-
-    using Arg = wl_gena::types::Arg;
-    using ArgTypes = wl_gena::types::ArgTypes;
-    for (const Arg &arg : _request.args) {
-        const ArgTypes::NewID *new_id_arg =
-            std::get_if<ArgTypes::NewID>(&arg.type);
-        bool is_new_id = new_id_arg != nullptr;
-        if (is_new_id) {
-            bool no_interface = !new_id_arg->interface_name.has_value();
-            if (no_interface) {
-                args += std::format("{}->name", _new_id_inteface_name);
-                args += "version";
+    {
+        auto in = w.indent();
+        CodeWriter::List args{w};
+
+        args.item("{}_ptr_as_proxy", n);
+        args.item("request_index_{}", _request.name());
+
+        if (_return_type) {
+            if (_return_type.value().interface_name()) {
+                args.item(_resolved_request.return_rtti_interface);
+            } else {
+                args.item(_new_id_inteface_name);
             }
-            args += "nullptr";
-            continue;
+        } else {
+            args.item("nullptr");
         }
 
-        args += std::string{arg.name};
-    }
+        if (_return_type &&
+            !_return_type.value().interface_name().has_value()) {
+            args.item("version");
+        } else {
+            args.item(
+                "{}wl_proxy_get_version({}_ptr_as_proxy)",
+                _options.library_call(),
+                n);
+        }
 
-    auto args_rev = std::ranges::views::reverse(args.get());
-    bool first = true;
-    for (auto &arg : args_rev) {
-        if (!first) {
-            arg = std::format("{},", arg);
+        if (_request.destructor()) {
+            args.item("/* WL_MARSHAL_FLAG_DESTROY */ (1 << 0)");
+        } else {
+            args.item("0");
         }
-        first = false;
-    }
 
-    o += indent(args);
-    o += ");";
+        if (array && _request.args().empty()) {
+            args.item("nullptr");
+        } else if (array) {
+            args.item("{}_args", n);
+        } else {
+            for (types::Arg arg : _request.args()) {
+                bool is_new_id = arg.kind() == types::ArgKind::NewID;
+                if (is_new_id) {
+                    bool no_interface = !arg.interface_name().has_value();
+                    if (no_interface) {
+                        args.item("{}->name", _new_id_inteface_name);
+                        args.item("version");
+                    }
+                    args.item("nullptr");
+                    continue;
+                }
+
+                args.item(arg.name());
+            }
+        }
+    }
+    w.line(");");
 
-    if (_return_type && !_return_type.value().arg.interface_name.has_value()) {
-        o += std::format(
-            "return reinterpret_cast<void*>({});", output_identifier.value());
+    if (_return_type && !_return_type.value().interface_name().has_value()) {
+        w.line(
+            "return reinterpret_cast<void*>(out_{});",
+            _return_type.value().name());
     } else if (_return_type) {
-        o += std::format(
-            "return reinterpret_cast<{}<{}>::handle_t*>({});",
-            _return_type.value().arg.interface_name.value(),
+        w.line(
+            "return reinterpret_cast<{}<{}>::handle_t*>(out_{});",
+            _return_type.value().interface_name().value(),
             _traits.typename_string,
-            output_identifier.value());
+            _return_type.value().name());
     }
+}
 
-    return o;
+/*
+ * The wl_argument array wl_proxy_marshal_array_flags takes, laid out
+ * like the wire signature: a new_id without interface is the interface
+ * name, the version and the id
+ *
+ * The id slot is left null, as the varargs stubs pass it. libwayland
+ * only puts the id of the new proxy into an 'n' slot, which is what an
+ * untyped new_id has; a typed one is signed 'i' in the rtti, so its
+ * slot goes on the wire as is
+ */
+void RequestGenerator::emit_interface_request_array_args(CodeWriter &w) const
+{
+    using Kind = types::ArgKind;
+
+    w.line("// {}", func());
+
+    std::string_view n = _interface_name;
+
+    size_t wire_arg_count = 0;
+    for (types::Arg arg : _request.args()) {
+        bool untyped_new_id =
+            arg.kind() == Kind::NewID && !arg.interface_name().has_value();
+        wire_arg_count += untyped_new_id ? 3 : 1;
+    }
+    if (wire_arg_count == 0) {
+        return;
+    }
+
+    w.line(
+        "typename {} {}_args[{}];",
+        _traits.wayland_client_core_wl_argument_typename,
+        n,
+        wire_arg_count);
+
+    size_t arg_i = 0;
+    for (types::Arg arg : _request.args()) {
+        switch (arg.kind()) {
+        case Kind::Int:
+            w.line("{}_args[{}].i = {};", n, arg_i, arg.name());
+            break;
+        case Kind::UInt:
+            w.line("{}_args[{}].u = {};", n, arg_i, arg.name());
+            break;
+        case Kind::UIntEnum:
+            w.line(
+                "{}_args[{}].u = static_cast<uint32_t>({});",
+                n,
+                arg_i,
+                arg.name());
+            break;
+        case Kind::Fixed:
+            w.line("{}_args[{}].f = {};", n, arg_i, arg.name());
+            break;
+        case Kind::String:
+        case Kind::NullString:
+            w.line("{}_args[{}].s = {};", n, arg_i, arg.name());
+            break;
+        case Kind::Object:
+        case Kind::NullObject:
+            w.line(
+                "{0}_args[{1}].o = "
+                "reinterpret_cast<decltype({0}_args[{1}].o)>({2});",
+                n,
+                arg_i,
+                arg.name());
+            break;
+        case Kind::NewID:
+            if (!arg.interface_name()) {
+                w.line(
+                    "{}_args[{}].s = {}->name;",
+                    n,
+                    arg_i,
+                    _new_id_inteface_name);
+                arg_i++;
+                w.line("{}_args[{}].u = version;", n, arg_i);
+                arg_i++;
+            }
+            w.line("{}_args[{}].o = nullptr;", n, arg_i);
+            break;
+        case Kind::Array:
+            w.line("{}_args[{}].a = {};", n, arg_i, arg.name());
+            break;
+        case Kind::FD:
+            w.line("{}_args[{}].h = {};", n, arg_i, arg.name());
+            break;
+        }
+        arg_i++;
+    }
 }
 
-StringList RequestGenerator::emit_interface_request() const
+void RequestGenerator::emit_interface_request(CodeWriter &w) const
 {
-    StringList o;
-    o += std::format("// {}", func());
+    w.line("// {}", func());
 
     if (_new_ids.size() > 1) {
         /*
@@ -778,333 +1436,316 @@ StringList RequestGenerator::emit_interface_request() const
          *
          * So it seems right to do the same thing here
          */
-        o += "/*";
-        o += std::format(
+        w.line("/*");
+        w.line(
             " * Multiple new_id args: Ignore [{}] request generation",
-            _request.name);
+            _request.name());
         size_t new_id_name_i = 0;
         for (auto &new_id : _new_ids) {
-            o += std::format(" * new_id[{}] {}", new_id_name_i, new_id.name);
+            w.line(" * new_id[{}] {}", new_id_name_i, new_id.name());
             new_id_name_i++;
         }
-        o += " */";
-        return o;
+        w.line(" */");
+        return;
     }
 
-    std::string return_type_string = "void";
-    if (_return_type.has_value()) {
-        return_type_string = "void *";
-        auto &new_id = _return_type.value().arg;
-        if (new_id.interface_name.has_value()) {
-            const std::string &interface_name = new_id.interface_name.value();
-            std::string interface_type = std::format(
-                "{}::{}<{}>",
-                _ns_info.get_namespace(interface_name),
-                interface_name,
-                _traits.typename_string);
-
-            return_type_string = std::format("{}::handle_t *", interface_type);
+    std::pmr::vector<DocTag> tags{_resource};
+    for (types::Arg arg : _request.args()) {
+        bool is_returned = _return_type && arg.record == _return_type->record;
+        if (is_returned && arg.interface_name()) {
+            tags.push_back(DocTag{"return", "", arg.doc()});
+        } else {
+            tags.push_back(DocTag{"param", arg.name(), arg.doc()});
         }
     }
+    doc_comment(w, _request.doc(), tags, _resource);
 
-    o += std::format("{} {}(", return_type_string, _request.name);
-    auto signature_args = emit_interface_request_signature_args();
-    o += indent(signature_args);
-    o += ")";
-
-    StringList body = emit_interface_request_body();
-
-    o += "{";
-    o += indent(body);
-    o += "}";
+    if (!_return_type) {
+        w.line("void {}(", _request.name());
+    } else if (!_return_type.value().interface_name()) {
+        w.line("void * {}(", _request.name());
+    } else {
+        w.line(
+            "{} * {}(",
+            _resolved_request.return_handle_type,
+            _request.name());
+    }
+    {
+        auto in = w.indent();
+        emit_interface_request_signature_args(w);
+    }
+    w.line(")");
 
-    return o;
+    w.line("{");
+    {
+        auto in = w.indent();
+        emit_interface_request_body(w);
+    }
+    w.line("}");
 }
 
-StringList InterfaceGenerator::emit_interface_requests() const
+void InterfaceGenerator::emit_interface_requests(CodeWriter &w) const
 {
-    StringList o;
-    o += std::format("// {}", func());
+    w.line("// {}", func());
 
     size_t next_req_index = 0;
-    for (auto &request : _interface.requests) {
+    for (types::Message request : _interface.requests()) {
         auto req_i = next_req_index;
         next_req_index++;
         if (req_i != 0) {
-            o += "";
+            w.separate();
         }
-        std::string request_index_name =
-            std::format("request_index_{}", request.name);
-        o += std::format(
-            "static constexpr size_t {} = {};", request_index_name, req_i);
+        w.line(
+            "static constexpr size_t request_index_{} = {};",
+            request.name(),
+            req_i);
         RequestGenerator req_gen{
-            request, _traits, _ns_info, _interface.name, request_index_name};
-        o += req_gen.emit_interface_request();
+            request,
+            _resolved,
+            _resolved_interface,
+            _interface.name(),
+            _options,
+            _resource};
+        req_gen.emit_interface_request(w);
     }
-
-    return o;
 }
 
-StringList InterfaceGenerator::emit_interface_destroy_proxy() const
+void InterfaceGenerator::emit_interface_destroy_proxy(CodeWriter &w) const
 {
-    StringList o;
-    std::optional<std::string> omit_and_why;
-
-    if (omit_and_why) {
-        return o;
-    }
+    std::optional<std::pmr::string> omit_and_why;
 
     bool has_destructor = false;
     bool has_destroy = false;
-    for (auto msg : _interface.requests) {
-        has_destructor = has_destructor || msg.destructor;
-        has_destroy = has_destroy || msg.name == "destroy";
+    for (types::Message msg : _interface.requests()) {
+        has_destructor = has_destructor || msg.destructor();
+        has_destroy = has_destroy || msg.name() == "destroy";
     }
 
     if (!has_destructor && has_destroy) {
-        omit_and_why = std::format(
+        omit_and_why = format_in(
+            _resource,
             "interface [{}] has method named [destroy] but no destructor",
-            _interface.name);
+            _interface.name());
     }
 
     if (has_destroy) {
-        omit_and_why = std::format(
-            "interface [{}] has method named [destroy]", _interface.name);
+        omit_and_why = format_in(
+            _resource,
+            "interface [{}] has method named [destroy]",
+            _interface.name());
     }
 
     if (omit_and_why) {
-        o += "/*";
-        o += " * Destroy via proxy is omitted";
-        o += std::format(" * {}", omit_and_why.value());
-        o += " */";
-        return o;
-    }
-
-    std::string interface_type = std::format(
-        "{}::{}<{}>",
-        _ns_info.get_namespace(_interface.name),
-        _interface.name,
-        _traits.typename_string);
-
-    o +=
-        std::format("void destroy_proxy({}::handle_t *object)", interface_type);
-    o += "{";
-    StringList b;
-    b += std::format(
-        "L.wl_proxy_destroy(reinterpret_cast<{}*>(object));",
-        _traits.wayland_client_core_wl_proxy_typename);
-    o += indent(b);
-    o += "}";
+        w.line("/*");
+        w.line(" * Destroy via proxy is omitted");
+        w.line(" * {}", omit_and_why.value());
+        w.line(" */");
+        return;
+    }
 
-    return o;
+    w.line(
+        "void destroy_proxy({} *object)", _resolved_interface.handle_type);
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line(
+            "{}wl_proxy_destroy(reinterpret_cast<{}*>(object));",
+            _options.library_call(),
+            _traits.wayland_client_core_wl_proxy_typename);
+    }
+    w.line("}");
 };
 
-StringList wl_gena::InterfaceGenerator::generate() const
+void wl_gena::InterfaceGenerator::generate(CodeWriter &w) const
 {
-    StringList o;
-    o += std::format("// {}", func());
+    w.line("// {}", func());
 
-    o += std::format("template <typename {}>", _traits.typename_string);
-    o += std::format("struct {}", _interface.name);
-    o += "{";
-    bool has_structure = false;
-    auto add_sep = [&has_structure, &o]() {
-        if (has_structure) {
-            o += "";
-        }
-        has_structure = true;
-    };
+    doc_comment(w, _interface.doc(), _resource);
+    w.line("template <typename {}>", _traits.typename_string);
+    w.line("struct {}", _interface.name());
+    w.line("{");
+    {
+        auto in = w.indent();
 
-    add_sep();
-    StringList handle_def;
-    if (_interface.name == "wl_display") {
-        handle_def +=
-            "// Special case for wl_display from client library via traits";
-        handle_def += std::format(
-            "using handle_t = {}::wl_display_t;", _traits.typename_string);
-    } else {
-        handle_def += "struct handle_t;";
-    }
-    o += indent(handle_def);
+        if (_interface.name() == "wl_display") {
+            w.line("// Special case for wl_display from client library via "
+                   "traits");
+            w.line(
+                "using handle_t = {}::wl_display_t;",
+                _traits.typename_string);
+        } else {
+            w.line("struct handle_t;");
+        }
 
-    add_sep();
-    auto enums = emit_enums();
-    o += indent(enums);
+        w.separate();
+        emit_enums(w);
 
-    bool has_events = !_interface.events.empty();
-    if (has_events) {
-        add_sep();
+        bool has_events = !_interface.events().empty();
+        if (has_events) {
+            w.separate();
+            emit_interface_event_listener_type(w);
+        }
 
-        StringList type = emit_interface_event_listener_type();
-        o += indent(type);
-    }
+        w.separate();
+        emit_interface_destroy_proxy(w);
 
-    {
-        auto destroy_via_proxy = emit_interface_destroy_proxy();
-        if (!destroy_via_proxy.empty()) {
-            add_sep();
-            o += indent(destroy_via_proxy);
+        if (has_events) {
+            w.separate();
+            emit_interface_add_listener_member_fn(w);
         }
-    }
 
-    if (has_events) {
-        add_sep();
-        StringList add_listener_code = emit_interface_add_listener_member_fn();
-        o += indent(add_listener_code);
-    }
+        if (has_events && _options.dispatchers) {
+            w.separate();
+            emit_interface_dispatch_fn(w);
 
-    {
-        add_sep();
-        StringList requests = emit_interface_requests();
-        o += indent(requests);
-    }
+            w.separate();
+            emit_interface_add_dispatcher_member_fn(w);
+        }
 
-    add_sep();
-    o += std::format(
-        "    typename {} L;", _traits.wayland_client_library_typename);
-    o += "};";
+        w.separate();
+        emit_interface_requests(w);
 
-    return o;
+        w.separate();
+        if (_options.static_library) {
+            w.line(
+                "using L = typename {};",
+                _traits.wayland_client_library_typename);
+        } else {
+            w.line(
+                "typename {} L;", _traits.wayland_client_library_typename);
+        }
+    }
+    w.line("};");
 }
 
-StringList wl_gena::HeaderGenerator::emit_object_forward() const
+void wl_gena::HeaderGenerator::emit_object_forward(CodeWriter &w) const
 {
-    StringList o;
-    o += std::format("// {}", func());
+    w.line("// {}", func());
 
-    for (auto &iface : _protocol.interfaces) {
-        o += std::format(
-            "template <typename {0}_traits> struct {0};", iface.name);
+    for (types::Interface iface : _protocol.interfaces()) {
+        w.line("template <typename {0}_traits> struct {0};", iface.name());
     }
-
-    return o;
 }
 
 namespace rtti {
 
-struct ArgsSignantureVisitor
+std::string_view args_signature(const wl_gena::types::Arg &arg)
 {
-    using ArgTypes = wl_gena::types::ArgTypes;
-#define OVERLOAD(TYPE, type_literal)                                           \
-    std::string operator()(const ArgTypes::TYPE &)                             \
-    {                                                                          \
-        return type_literal;                                                   \
-    }
+    using Kind = wl_gena::types::ArgKind;
 
-    OVERLOAD(Int, "i");
-    OVERLOAD(UInt, "u");
-    OVERLOAD(UIntEnum, "u");
-    OVERLOAD(Fixed, "f");
-    OVERLOAD(String, "s");
-    OVERLOAD(NullString, "?s");
-    OVERLOAD(Object, "o");
-    OVERLOAD(NullObject, "?o");
-    std::string operator()(const ArgTypes::NewID &id)
-    {
-        if (!id.interface_name) {
+    switch (arg.kind()) {
+    case Kind::Int:
+        return "i";
+    case Kind::UInt:
+    case Kind::UIntEnum:
+        return "u";
+    case Kind::Fixed:
+        return "f";
+    case Kind::String:
+        return "s";
+    case Kind::NullString:
+        return "?s";
+    case Kind::Object:
+        return "o";
+    case Kind::NullObject:
+        return "?o";
+    case Kind::NewID:
+        if (!arg.interface_name()) {
             return "sun";
         }
         return "i";
-    };
-    OVERLOAD(Array, "a");
-    OVERLOAD(FD, "h");
-#undef OVERLOAD
-};
-
-struct ArgsTypesVisitor
-{
-    using ArgTypes = wl_gena::types::ArgTypes;
-    using InterfaceNameable = wl_gena::types::InterfaceNameable;
-
-#define OVERLOAD(TYPE)                                                         \
-    std::optional<std::string> operator()(const ArgTypes::TYPE &)              \
-    {                                                                          \
-        return std::nullopt;                                                   \
-    }
-
-#define OVERLOAD_IFACE(TYPE)                                                   \
-    std::optional<std::string> operator()(const ArgTypes::TYPE &o)             \
-    {                                                                          \
-        return iface_typename(o);                                              \
+    case Kind::Array:
+        return "a";
+    case Kind::FD:
+        return "h";
     }
+    throw std::logic_error{"Unknown arg kind"};
+}
 
-    OVERLOAD(Int);
-    OVERLOAD(UInt);
-    OVERLOAD(UIntEnum);
-    OVERLOAD(Fixed);
-    OVERLOAD(String);
-    OVERLOAD(NullString);
-    OVERLOAD_IFACE(Object);
-    OVERLOAD_IFACE(NullObject);
-    OVERLOAD_IFACE(NewID);
-    OVERLOAD(Array);
-    OVERLOAD(FD);
-
-#undef OVERLOAD
-#undef OVERLOAD_IFACE
+/*
+ * Interface an arg refers to in the rtti types array
+ */
+std::optional<std::string_view> args_type(const wl_gena::types::Arg &arg)
+{
+    using Kind = wl_gena::types::ArgKind;
 
-    std::optional<std::string> iface_typename(InterfaceNameable n)
-    {
-        return n.interface_name;
+    switch (arg.kind()) {
+    case Kind::Object:
+    case Kind::NullObject:
+    case Kind::NewID:
+        return arg.interface_name();
+    default:
+        return std::nullopt;
     }
-};
+}
 
 struct Arg
 {
-    std::string name;
-    std::optional<std::string> rtti_type;
+    std::string_view name;
+    /*
+     * Entry of the types array
+     */
+    std::string_view type;
 };
 
 struct Message
 {
-    Message(const wl_gena::types::Message &msg)
+    Message(
+        wl_gena::types::Message msg,
+        const ResolvedProtocol &resolved,
+        std::pmr::memory_resource *resource)
+        : rtti_args{resource}, args_signature{resource}
     {
-        name = msg.name;
+        name = msg.name();
 
-        if (msg.since && msg.since.value() > 1) {
-            args_signature += std::format("{}", msg.since.value());
+        if (msg.since() && msg.since().value() > 1) {
+            std::format_to(
+                std::back_inserter(args_signature), "{}", msg.since().value());
         }
 
-        for (auto &arg : msg.args) {
-            args_signature += std::visit(ArgsSignantureVisitor{}, arg.type);
+        for (wl_gena::types::Arg arg : msg.args()) {
+            args_signature += rtti::args_signature(arg);
         }
 
-        for (auto &arg : msg.args) {
-            auto arg_rtti_type_op = std::visit(ArgsTypesVisitor{}, arg.type);
-            if (arg_rtti_type_op.has_value()) {
+        for (wl_gena::types::Arg arg : msg.args()) {
+            if (args_type(arg).has_value()) {
                 only_primitives = false;
             }
             Arg rtti_arg;
-            rtti_arg.name = arg.name;
-            rtti_arg.rtti_type = arg_rtti_type_op;
-            rtti_args.push_back(std::move(rtti_arg));
+            rtti_arg.name = arg.name();
+            rtti_arg.type = resolved.arg_of(arg).rtti_type;
+            rtti_args.push_back(rtti_arg);
         }
     }
-    std::string name;
+    std::string_view name;
     bool only_primitives = true;
-    std::vector<Arg> rtti_args;
-    std::string args_signature;
+    std::pmr::vector<Arg> rtti_args;
+    std::pmr::string args_signature;
 };
 
 struct Interface
 {
-    Interface(const wl_gena::types::Interface &iface)
+    Interface(
+        wl_gena::types::Interface iface,
+        const ResolvedProtocol &resolved,
+        std::pmr::memory_resource *resource)
+        : requests{resource}, events{resource}
     {
-        name = iface.name;
-        version = iface.version;
-        for (auto &req : iface.requests) {
-            requests.push_back(Message{req});
+        name = iface.name();
+        version = iface.version();
+        for (wl_gena::types::Message req : iface.requests()) {
+            requests.push_back(Message{req, resolved, resource});
         }
 
-        for (auto &ev : iface.events) {
-            events.push_back(Message{ev});
+        for (wl_gena::types::Message ev : iface.events()) {
+            events.push_back(Message{ev, resolved, resource});
         }
     }
 
-    std::string name;
+    std::string_view name;
     uint32_t version;
-    std::vector<Message> requests;
-    std::vector<Message> events;
+    std::pmr::vector<Message> requests;
+    std::pmr::vector<Message> events;
 };
 
 struct TypeArrayInfo
@@ -1112,17 +1753,20 @@ struct TypeArrayInfo
     struct Entry
     {
         std::optional<size_t> index;
-        std::string type;
+        std::string_view type;
 
-        std::string interface_name;
-        std::string message_name;
-        std::string arg_name;
+        std::string_view interface_name;
+        std::string_view message_name;
+        bool is_event = false;
+        std::string_view arg_name;
     };
 
     TypeArrayInfo(
-        const std::vector<Interface> &interfaces, const NamespaceInfo &ns_info)
+        const std::pmr::vector<Interface> &interfaces,
+        std::pmr::memory_resource *resource)
+        : array{resource}, _first_entries{resource}
     {
-        auto get_max_null_run = [](const std::vector<Message> &msgs) {
+        auto get_max_null_run = [](const std::pmr::vector<Message> &msgs) {
             size_t o = 0;
             for (auto &ev : msgs) {
                 if (ev.only_primitives) {
@@ -1140,512 +1784,1358 @@ struct TypeArrayInfo
                 std::max(null_run_length, get_max_null_run(iface.requests));
         }
 
-        array = [&interfaces, &ns_info]() {
-            auto generate_entries =
-                [&ns_info](
-                    const std::vector<Message> &msgs,
-                    const std::string iface_name) -> std::vector<Entry> {
-                std::vector<Entry> o;
+        auto generate_entries = [this](const std::pmr::vector<Message> &msgs,
+                                       std::string_view iface_name,
+                                       bool is_event) {
+            for (auto &msg : msgs) {
+
+                if (msg.only_primitives) {
+                    continue;
+                }
+                for (auto &arg : msg.rtti_args) {
+                    Entry entry{};
+                    entry.type = arg.type;
 
-                for (auto &msg : msgs) {
+                    entry.interface_name = iface_name;
+                    entry.message_name = msg.name;
+                    entry.is_event = is_event;
+                    entry.arg_name = arg.name;
 
-                    if (msg.only_primitives) {
-                        continue;
-                    }
-                    for (auto &arg : msg.rtti_args) {
+                    array.push_back(std::move(entry));
+                }
+            }
+        };
+
+        for (auto &iface : interfaces) {
+            generate_entries(iface.requests, iface.name, false);
+            generate_entries(iface.events, iface.name, true);
+        }
 
-                        std::string type = "nullptr";
-                        if (arg.rtti_type) {
-                            const std::string &interface_name =
-                                arg.rtti_type.value();
+        _first_entries.reserve(array.size());
+        for (size_t e_i = 0; e_i != array.size(); ++e_i) {
+            Entry &e = array[e_i];
+            if (e.index) {
+                throw std::runtime_error{
+                    "Type array should not have indexes here"};
+            }
+            e.index = e_i;
+            _first_entries.try_emplace(
+                MessageKey{e.interface_name, e.message_name, e.is_event}, e_i);
+        }
+    }
 
-                            type = std::format(
-                                "&{}::rtti<traits>::{}_interface",
-                                ns_info.get_namespace(interface_name),
-                                interface_name);
-                        }
+    /*
+     * Index of the first entry of a message
+     */
+    size_t find_index(
+        std::string_view interface_name,
+        std::string_view message_name,
+        bool is_event) const
+    {
+        auto it = _first_entries.find(
+            MessageKey{interface_name, message_name, is_event});
+        if (it == std::end(_first_entries)) {
+            std::string message = std::format(
+                "Cannot find index for [{}.{}] {}",
+                interface_name,
+                message_name,
+                is_event ? "event" : "request");
+            throw std::runtime_error{std::move(message)};
+        }
+        return it->second;
+    }
 
-                        Entry entry{};
-                        entry.type = std::move(type);
+    size_t null_run_length;
+    std::pmr::vector<Entry> array;
 
-                        entry.interface_name = iface_name;
-                        entry.message_name = msg.name;
-                        entry.arg_name = arg.name;
+  private:
+    struct MessageKey
+    {
+        std::string_view interface_name;
+        std::string_view message_name;
+        bool is_event;
 
-                        o.push_back(std::move(entry));
-                    }
-                }
+        bool operator==(const MessageKey &) const = default;
+    };
 
-                return o;
-            };
+    struct MessageKeyHash
+    {
+        size_t operator()(const MessageKey &key) const
+        {
+            std::hash<std::string_view> hash;
+            return hash(key.interface_name) * 31 +
+                   hash(key.message_name) * 2 + key.is_event;
+        }
+    };
 
-            std::vector<Entry> o;
-            for (auto &iface : interfaces) {
-                auto request_entries =
-                    generate_entries(iface.requests, iface.name);
-                auto event_entries = generate_entries(iface.events, iface.name);
+    std::pmr::unordered_map<MessageKey, size_t, MessageKeyHash> _first_entries;
+};
 
-                for (auto &req : request_entries) {
-                    o.push_back(std::move(req));
-                }
+struct Generator
+{
+    Generator(
+        const types::Protocol &proto,
+        const ResolvedProtocol &resolved,
+        std::pmr::memory_resource *resource)
+        : _interfaces{make_interfaces(proto, resolved, resource)},
+          _type_array_info{_interfaces, resource}
+    {
+    }
 
-                for (auto &ev : event_entries) {
-                    o.push_back(std::move(ev));
-                }
+    static std::pmr::vector<Interface> make_interfaces(
+        const types::Protocol &proto,
+        const ResolvedProtocol &resolved,
+        std::pmr::memory_resource *resource)
+    {
+        std::pmr::vector<Interface> interfaces{resource};
+        for (types::Interface iface : proto.interfaces()) {
+            interfaces.emplace_back(iface, resolved, resource);
+        }
+        return interfaces;
+    };
+
+    void emit_rtti_struct(CodeWriter &w) const;
+    void emit_rtti_interface_struct_members_forward(
+        CodeWriter &w, size_t interface_index) const;
+    void emit_rtti(CodeWriter &w) const;
+    void emit_rtti_interface_struct_types_member(CodeWriter &w) const;
+    void emit_rtti_interface_struct_members(
+        CodeWriter &w, size_t interface_index) const;
+
+  private:
+    std::pmr::vector<Interface> _interfaces;
+    TypeArrayInfo _type_array_info;
+};
+
+void Generator::emit_rtti_interface_struct_members_forward(
+    CodeWriter &w, size_t iface_index) const
+{
+    w.line("// {}", func());
+
+    const rtti::Interface &interface = _interfaces.at(iface_index);
+
+    w.line(
+        "static const typename traits::wl_interface_t {}_interface;",
+        interface.name);
+
+    if (!interface.requests.empty()) {
+        w.line(
+            "static const typename traits::wl_message_t {}_requests[];",
+            interface.name);
+    }
+
+    if (!interface.events.empty()) {
+        w.line(
+            "static const typename traits::wl_message_t {}_events[];",
+            interface.name);
+    }
+}
+
+void Generator::emit_rtti_struct(CodeWriter &w) const
+{
+    w.line("// {}", func());
+
+    w.line("template <typename traits>");
+    w.line("struct rtti");
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line("static const typename traits::wl_interface_t *types[];");
+        w.blank();
+        for (size_t iface_i = 0; iface_i != _interfaces.size(); ++iface_i) {
+            if (iface_i != 0) {
+                w.separate();
             }
+            emit_rtti_interface_struct_members_forward(w, iface_i);
+        }
+    }
+    w.line("};");
+}
 
-            for (size_t e_i = 0; e_i != o.size(); ++e_i) {
-                Entry &e = o[e_i];
-                if (e.index) {
-                    throw std::runtime_error{
-                        "Type array should not have indexes here"};
-                }
-                e.index = e_i;
+void Generator::emit_rtti_interface_struct_types_member(CodeWriter &w) const
+{
+    w.line("// {}", func());
+
+    w.line("template <typename traits>");
+    w.line("const typename traits::wl_interface_t *rtti<traits>::types[] {");
+
+    /*
+     * The null run comes first, then one entry per arg of every message
+     * that refers to interfaces. Types are padded to one column, with the
+     * separating comma counted in
+     */
+    size_t null_run_length = _type_array_info.null_run_length;
+    const auto &array = _type_array_info.array;
+    size_t entry_count = null_run_length + array.size();
+
+    auto entry_type = [&](size_t entry_i) -> std::string_view {
+        if (entry_i < null_run_length) {
+            return "nullptr";
+        }
+        return array[entry_i - null_run_length].type;
+    };
+    auto separator = [entry_count](size_t entry_i) -> std::string_view {
+        return entry_i + 1 != entry_count ? "," : "";
+    };
+
+    size_t type_width = 0;
+    for (size_t entry_i = 0; entry_i != entry_count; ++entry_i) {
+        type_width = std::max(
+            type_width,
+            entry_type(entry_i).size() + separator(entry_i).size());
+    }
+    size_t index_width =
+        std::formatted_size("{}", entry_count == 0 ? 0 : entry_count - 1);
+
+    {
+        auto in = w.indent();
+        for (size_t entry_i = 0; entry_i != entry_count; ++entry_i) {
+            std::string_view type = entry_type(entry_i);
+            size_t separator_width = type_width - type.size();
+
+            if (entry_i < null_run_length) {
+                w.line(
+                    "{}{:{}} /* [{:{}}][null_run_stub] */",
+                    type,
+                    separator(entry_i),
+                    separator_width,
+                    entry_i,
+                    index_width);
+                continue;
             }
 
-            return o;
-        }();
+            const TypeArrayInfo::Entry &type_entry =
+                array[entry_i - null_run_length];
+            w.line(
+                "{}{:{}} /* [{:{}}][{}.{}.{}] */",
+                type,
+                separator(entry_i),
+                separator_width,
+                type_entry.index.value() + null_run_length,
+                index_width,
+                type_entry.interface_name,
+                type_entry.message_name,
+                type_entry.arg_name);
+        }
     }
 
-    size_t find_index(
-        const std::string interface_name, const std::string &message_name) const
+    w.line("};");
+}
+
+void Generator::emit_rtti_interface_struct_members(
+    CodeWriter &w, size_t iface_index) const
+{
+    w.line("// {}", func());
+
+    const rtti::Interface &interface = _interfaces.at(iface_index);
+
+    auto emit_rtti_message_elements =
+        [&](const std::pmr::vector<rtti::Message> &msgs, bool is_event) {
+            CodeWriter::List elements{w};
+            for (auto &msg : msgs) {
+                if (msg.only_primitives) {
+                    elements.item(
+                        "{{\"{}\", \"{}\", "
+                        "rtti<traits>::types + /* [null_run_stub] */ 0}}",
+                        msg.name,
+                        msg.args_signature);
+                    continue;
+                }
+
+                size_t offset = _type_array_info.find_index(
+                    interface.name, msg.name, is_event);
+                offset += _type_array_info.null_run_length;
+                elements.item(
+                    "{{\"{}\", \"{}\", "
+                    "rtti<traits>::types + /* [{}.{}] */ {}}}",
+                    msg.name,
+                    msg.args_signature,
+                    interface.name,
+                    msg.name,
+                    offset);
+            }
+        };
+
+    w.line("template <typename traits>");
+    w.line(
+        "const typename traits::wl_interface_t rtti<traits>::{}_interface {{",
+        interface.name);
     {
-        namespace V = std::ranges::views;
-        auto interface_filtered = V::filter([&interface_name](const Entry &e) {
-            return e.interface_name == interface_name;
-        });
+        auto in = w.indent();
+        w.line("\"{}\", {},", interface.name, interface.version);
+        if (!interface.requests.empty()) {
+            w.line(
+                "{}, rtti<traits>::{}_requests,",
+                interface.requests.size(),
+                interface.name);
+        } else {
+            w.line("0, nullptr,");
+        }
+
+        if (!interface.events.empty()) {
+            w.line(
+                "{}, rtti<traits>::{}_events",
+                interface.events.size(),
+                interface.name);
+        } else {
+            w.line("0, nullptr");
+        }
+    }
+    w.line("};");
+
+    if (!interface.requests.empty()) {
+        w.separate();
+        w.line("template <typename traits>");
+        w.line(
+            "const typename traits::wl_message_t rtti<traits>::{}_requests[] = "
+            "{{",
+            interface.name);
+        {
+            auto in = w.indent();
+            emit_rtti_message_elements(interface.requests, false);
+        }
+        w.line("};");
+    }
+
+    if (!interface.events.empty()) {
+        w.separate();
+        w.line("template <typename traits>");
+        w.line(
+            "const typename traits::wl_message_t rtti<traits>::{}_events[] = "
+            "{{",
+            interface.name);
+        {
+            auto in = w.indent();
+            emit_rtti_message_elements(interface.events, true);
+        }
+        w.line("};");
+    }
+}
 
-        auto message_filtered = V::filter([&message_name](const Entry &e) {
-            return e.message_name == message_name;
-        });
+void Generator::emit_rtti(CodeWriter &w) const
+{
+    w.line("// {}", func());
 
-        auto entry_range =
-            array | interface_filtered | message_filtered | V::take(1);
+    emit_rtti_interface_struct_types_member(w);
 
-        std::optional<Entry> first_entry_op;
-        for (auto &entry : entry_range) {
-            first_entry_op = entry;
-            break;
+    w.blank();
+    for (size_t iface_i = 0; iface_i != _interfaces.size(); ++iface_i) {
+        if (iface_i != 0) {
+            w.separate();
         }
+        emit_rtti_interface_struct_members(w, iface_i);
+    }
+}
+} // namespace rtti
 
-        if (!first_entry_op) {
-            std::string message = std::format(
-                "Cannot find index for [{}.{}] message",
-                interface_name,
-                message_name);
-            throw std::runtime_error{std::move(message)};
-        }
-        auto &first_entry = first_entry_op.value();
+namespace wire {
 
-        if (!first_entry.index) {
-            std::string message = std::format(
-                "Message [{}.{}] does not have an index",
-                interface_name,
-                message_name);
-            throw std::runtime_error{std::move(message)};
-        }
+/*
+ * Strings and arrays have a length word and padded bytes in the message
+ * body, an untyped new_id starts with the interface name string
+ */
+bool has_variable_size(types::Arg arg)
+{
+    using Kind = types::ArgKind;
+
+    switch (arg.kind()) {
+    case Kind::String:
+    case Kind::NullString:
+    case Kind::Array:
+        return true;
+    case Kind::NewID:
+        return !arg.interface_name().has_value();
+    default:
+        return false;
+    }
+}
+
+/*
+ * Body bytes of an arg without padded string and array bytes, FDs go
+ * into the side array
+ */
+size_t fixed_size(types::Arg arg)
+{
+    using Kind = types::ArgKind;
 
-        return first_entry.index.value();
+    switch (arg.kind()) {
+    case Kind::FD:
+        return 0;
+    case Kind::NewID:
+        return arg.interface_name() ? 4 : 12;
+    default:
+        return 4;
     }
+}
 
-    size_t null_run_length;
-    std::vector<Entry> array;
-};
+/*
+ * Name of the byte count of a variable size arg in the encoder
+ */
+std::string_view size_suffix(types::Arg arg)
+{
+    return arg.kind() == types::ArgKind::NewID ? "_interface_size" : "_size";
+}
 
+/*
+ * Encoders and decoders of Wayland wire messages, in one struct per
+ * interface. They do not depend on the traits or the client library:
+ * objects are their ids and enums their values
+ */
 struct Generator
 {
-    Generator(const types::Protocol &proto, const NamespaceInfo &deps)
-        : _deps{deps}, _interfaces{make_interfaces(proto)},
-          _type_array_info{_interfaces, _deps}
+    Generator(
+        const types::Protocol &proto,
+        const EmitOptions &options,
+        std::pmr::memory_resource *resource)
+        : _protocol{proto}, _options{options}, _resource{resource}
     {
     }
 
-    static std::vector<Interface> make_interfaces(const types::Protocol &proto)
-    {
-        std::vector<Interface> interfaces;
-        for (auto &iface : proto.interfaces) {
-            interfaces.emplace_back(iface);
-        }
-        return interfaces;
-    };
-
-    StringList emit_rtti_struct() const;
-    StringList emit_rtti_interface_struct_members_forward(
-        size_t interface_index) const;
-    StringList emit_rtti() const;
-    StringList emit_rtti_interface_struct_types_member() const;
-    StringList emit_rtti_interface_struct_members(size_t interface_index) const;
+    void emit_wire(CodeWriter &w) const;
+    void emit_wire_buffer_struct(CodeWriter &w) const;
+    void emit_wire_reader_struct(CodeWriter &w) const;
+    void emit_wire_struct(CodeWriter &w, types::Interface iface) const;
+    void emit_wire_request_size(
+        CodeWriter &w, types::Message request, size_t fixed_bytes) const;
+    void emit_wire_request_encoder(
+        CodeWriter &w, types::Message request, size_t fixed_bytes) const;
+    void emit_wire_request_encoder_args(
+        CodeWriter &w, types::Message request) const;
+    void emit_wire_event_struct(CodeWriter &w, types::Message event) const;
+    void emit_wire_event_decoder(CodeWriter &w, types::Message event) const;
+    void emit_wire_event_table(CodeWriter &w, types::Interface iface) const;
 
   private:
-    const NamespaceInfo &_deps;
-    std::vector<Interface> _interfaces;
-    TypeArrayInfo _type_array_info;
+    const types::Protocol &_protocol;
+    const EmitOptions &_options;
+    std::pmr::memory_resource *_resource;
 };
 
-StringList Generator::emit_rtti_interface_struct_members_forward(
-    size_t iface_index) const
+void Generator::emit_wire_buffer_struct(CodeWriter &w) const
 {
-    StringList o;
-    o += std::format("// {}", func());
-
-    const rtti::Interface &interface = _interfaces.at(iface_index);
-
-    o += std::format(
-        "static const typename traits::wl_interface_t {}_interface;",
-        interface.name);
-
-    if (!interface.requests.empty()) {
-        o += std::format(
-            "static const typename traits::wl_message_t {}_requests[];",
-            interface.name);
-    }
-
-    if (!interface.events.empty()) {
-        o += std::format(
-            "static const typename traits::wl_message_t {}_events[];",
-            interface.name);
+    w.line("// {}", func());
+
+    w.line("/*");
+    w.line(" * Caller memory the wire encoders append messages to, back to");
+    w.line(" * back, so one sendmsg flushes all of them: the words as the");
+    w.line(" * data and the fds as SCM_RIGHTS. An encoder that returns false");
+    w.line(" * left the buffer as it was: flush and clear() it and encode");
+    w.line(" * again. If it was empty() already, the message can never fit,");
+    w.line(" * it is larger than max_message_size or needs more words or fds");
+    w.line(" * than the buffer holds, and encoding again fails the same way");
+    w.line(" *");
+    w.line(" * Encoders take any buffer type with these members, so the one");
+    w.line(" * of any protocol batches messages of all protocols");
+    w.line(" */");
+    w.line("struct wire_buffer_t");
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line("/*");
+        w.line(" * Largest message libwayland accepts by default");
+        w.line(" */");
+        w.line("static constexpr size_t max_message_size = 4096;");
+        w.blank();
+        w.line("uint32_t *words = nullptr;");
+        w.line("size_t word_capacity = 0;");
+        w.line("int32_t *fds = nullptr;");
+        w.line("size_t fd_capacity = 0;");
+        w.blank();
+        w.line("size_t word_count = 0;");
+        w.line("size_t fd_count = 0;");
+        w.blank();
+        w.line("/*");
+        w.line(" * Words of a message of [message_size] bytes with");
+        w.line(" * [message_fds] fds, nullptr if it does not fit");
+        w.line(" */");
+        w.line("uint32_t *reserve(size_t message_size, size_t message_fds)");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("if (message_size > max_message_size ||");
+            w.line("    word_capacity - word_count < message_size / 4 ||");
+            w.line("    fd_capacity - fd_count < message_fds) {");
+            w.line("    return nullptr;");
+            w.line("}");
+            w.line("uint32_t *message = words + word_count;");
+            w.line("word_count += message_size / 4;");
+            w.line("return message;");
+        }
+        w.line("}");
+        w.blank();
+        w.line("void push_fd(int32_t fd)");
+        w.line("{");
+        w.line("    fds[fd_count++] = fd;");
+        w.line("}");
+        w.blank();
+        w.line("size_t byte_count() const");
+        w.line("{");
+        w.line("    return word_count * 4;");
+        w.line("}");
+        w.blank();
+        w.line("bool empty() const");
+        w.line("{");
+        w.line("    return word_count == 0 && fd_count == 0;");
+        w.line("}");
+        w.blank();
+        w.line("void clear()");
+        w.line("{");
+        w.line("    word_count = 0;");
+        w.line("    fd_count = 0;");
+        w.line("}");
+        w.blank();
+        w.line("/*");
+        w.line(" * Wire length of a string, with the terminating zero, 0 for");
+        w.line(" * nullptr");
+        w.line(" */");
+        w.line("static constexpr size_t string_size(const char *s)");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("if (s == nullptr) {");
+            w.line("    return 0;");
+            w.line("}");
+            w.line("size_t size = 1;");
+            w.line("while (s[size - 1] != '\\0') {");
+            w.line("    ++size;");
+            w.line("}");
+            w.line("return size;");
+        }
+        w.line("}");
+        w.blank();
+        w.line("static constexpr size_t padded_size(size_t size)");
+        w.line("{");
+        w.line("    return (size + 3) / 4 * 4;");
+        w.line("}");
+        w.blank();
+        w.line("/*");
+        w.line(" * Copies [size] bytes to [p] with zeros up to the next word,");
+        w.line(" * returns the word after them");
+        w.line(" */");
+        w.line(
+            "static uint32_t *put_bytes(uint32_t *p, const void *data, "
+            "size_t size)");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("if (size == 0) {");
+            w.line("    return p;");
+            w.line("}");
+            w.line("size_t padded_words = padded_size(size) / 4;");
+            w.line("p[padded_words - 1] = 0;");
+            w.line("auto *to = reinterpret_cast<unsigned char *>(p);");
+            w.line("auto *from = static_cast<const unsigned char *>(data);");
+            w.line("for (size_t i = 0; i != size; ++i) {");
+            w.line("    to[i] = from[i];");
+            w.line("}");
+            w.line("return p + padded_words;");
+        }
+        w.line("}");
     }
-
-    return o;
+    w.line("};");
 }
 
-StringList Generator::emit_rtti_struct() const
+void Generator::emit_wire_reader_struct(CodeWriter &w) const
 {
-    StringList o;
-    o += std::format("// {}", func());
-
-    o += "template <typename traits>";
-    o += "struct rtti";
-    o += "{";
-    o += "    static const typename traits::wl_interface_t *types[];";
-    o += "";
-    bool first = true;
-    for (size_t iface_i = 0; iface_i != _interfaces.size(); ++iface_i) {
-        auto iface_members =
-            emit_rtti_interface_struct_members_forward(iface_i);
-        if (!first) {
-            o += "";
+    w.line("// {}", func());
+
+    w.line("/*");
+    w.line(" * Reads the args of one received message in place. Strings and");
+    w.line(" * arrays are views of the received words, which must outlive");
+    w.line(" * them. A malformed message sets [failed], reads after that");
+    w.line(" * return zeros and empty views");
+    w.line(" */");
+    w.line("struct wire_reader_t");
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line("std::span<const uint32_t> words;");
+        w.line("/*");
+        w.line(" * Received with the whole batch, taken in message order");
+        w.line(" */");
+        w.line("std::span<const int32_t> *fds = nullptr;");
+        w.line("bool failed = false;");
+        w.blank();
+        w.line("uint32_t word()");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("if (words.empty()) {");
+            w.line("    failed = true;");
+            w.line("    return 0;");
+            w.line("}");
+            w.line("uint32_t word = words.front();");
+            w.line("words = words.subspan(1);");
+            w.line("return word;");
         }
-        first = false;
-        o += indent(iface_members);
+        w.line("}");
+        w.blank();
+        w.line("uint32_t object(bool nullable)");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("uint32_t id = word();");
+            w.line("failed = failed || (id == 0 && !nullable);");
+            w.line("return id;");
+        }
+        w.line("}");
+        w.blank();
+        w.line("/*");
+        w.line(" * Without the terminating zero, a null string has no data");
+        w.line(" */");
+        w.line("std::string_view string(bool nullable)");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("size_t size = word();");
+            w.line("if (size == 0) {");
+            w.line("    failed = failed || !nullable;");
+            w.line("    return {};");
+            w.line("}");
+            w.line("size_t padded_words = (size + 3) / 4;");
+            w.line("if (padded_words > words.size()) {");
+            w.line("    failed = true;");
+            w.line("    return {};");
+            w.line("}");
+            w.line(
+                "const char *data = "
+                "reinterpret_cast<const char *>(words.data());");
+            w.line("words = words.subspan(padded_words);");
+            w.line("if (data[size - 1] != '\\0') {");
+            w.line("    failed = true;");
+            w.line("    return {};");
+            w.line("}");
+            w.line("return std::string_view{data, size - 1};");
+        }
+        w.line("}");
+        w.blank();
+        w.line("std::span<const unsigned char> array()");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("size_t size = word();");
+            w.line("size_t padded_words = (size + 3) / 4;");
+            w.line("if (padded_words > words.size()) {");
+            w.line("    failed = true;");
+            w.line("    return {};");
+            w.line("}");
+            w.line(
+                "const auto *data = "
+                "reinterpret_cast<const unsigned char *>(words.data());");
+            w.line("words = words.subspan(padded_words);");
+            w.line("return std::span<const unsigned char>{data, size};");
+        }
+        w.line("}");
+        w.blank();
+        w.line("int32_t fd()");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("if (fds == nullptr || fds->empty()) {");
+            w.line("    failed = true;");
+            w.line("    return -1;");
+            w.line("}");
+            w.line("int32_t fd = fds->front();");
+            w.line("*fds = fds->subspan(1);");
+            w.line("return fd;");
+        }
+        w.line("}");
+        w.blank();
+        w.line("/*");
+        w.line(" * All args read and none missing");
+        w.line(" */");
+        w.line("bool done() const");
+        w.line("{");
+        w.line("    return !failed && words.empty();");
+        w.line("}");
+    }
+    w.line("};");
+
+    w.blank();
+    w.line("/*");
+    w.line(" * A received message, split off the front of a batch of words");
+    w.line(" */");
+    w.line("struct wire_message_t");
+    w.line("{");
+    {
+        auto in = w.indent();
+        w.line("uint32_t object_id = 0;");
+        w.line("uint16_t opcode = 0;");
+        w.line("wire_reader_t args;");
+        w.blank();
+        w.line("/*");
+        w.line(" * False if [words] does not start with a whole message,");
+        w.line(" * [fds] are given to the args reader of the message");
+        w.line(" */");
+        w.line("static bool take(");
+        w.line("    std::span<const uint32_t> &words,");
+        w.line("    std::span<const int32_t> &fds,");
+        w.line("    wire_message_t &message)");
+        w.line("{");
+        {
+            auto in2 = w.indent();
+            w.line("if (words.size() < 2) {");
+            w.line("    return false;");
+            w.line("}");
+            w.line("size_t size = words[1] >> 16;");
+            w.line(
+                "if (size < 8 || size % 4 != 0 || "
+                "size / 4 > words.size()) {");
+            w.line("    return false;");
+            w.line("}");
+            w.line("message.object_id = words[0];");
+            w.line(
+                "message.opcode = static_cast<uint16_t>(words[1] & 0xffff);");
+            w.line(
+                "message.args = "
+                "wire_reader_t{words.subspan(2, size / 4 - 2), &fds};");
+            w.line("words = words.subspan(size / 4);");
+            w.line("return true;");
+        }
+        w.line("}");
     }
-
-    o += "};";
-
-    return o;
+    w.line("};");
 }
 
-StringList Generator::emit_rtti_interface_struct_types_member() const
+void Generator::emit_wire_event_struct(
+    CodeWriter &w, types::Message event) const
 {
-    StringList o;
-    o += std::format("// {}", func());
-
-    std::string sig;
-    sig += "const typename traits::wl_interface_t *";
-    sig += "rtti<traits>::types[]";
+    using Kind = types::ArgKind;
 
-    o += "template <typename traits>";
-    o += std::format("{} {{", sig);
+    w.line("// {}", func());
 
-    struct RTTITypeEntry
+    w.line("struct {}_event_t", event.name());
+    w.line("{");
     {
-        std::string type;
-        size_t index;
-        std::string debug;
-    };
+        auto in = w.indent();
+        for (types::Arg arg : event.args()) {
+            switch (arg.kind()) {
+            case Kind::Int:
+            case Kind::FD:
+                w.line("int32_t {};", arg.name());
+                break;
+            case Kind::UInt:
+            case Kind::UIntEnum:
+                w.line("uint32_t {};", arg.name());
+                break;
+            case Kind::Fixed:
+                w.line("/* wl_fixed_t */ int32_t {};", arg.name());
+                break;
+            case Kind::String:
+                w.line("std::string_view {};", arg.name());
+                break;
+            case Kind::NullString:
+                w.line(
+                    "/* nullptr<string> */ std::string_view {};", arg.name());
+                break;
+            case Kind::Object:
+                w.line("/* object id */ uint32_t {};", arg.name());
+                break;
+            case Kind::NullObject:
+                w.line("/* object id or 0 */ uint32_t {};", arg.name());
+                break;
+            case Kind::NewID:
+                if (!arg.interface_name()) {
+                    w.line("std::string_view {}_interface;", arg.name());
+                    w.line("uint32_t {}_version;", arg.name());
+                }
+                w.line("/* new object id */ uint32_t {};", arg.name());
+                break;
+            case Kind::Array:
+                w.line("std::span<const unsigned char> {};", arg.name());
+                break;
+            }
+        }
+    }
+    w.line("};");
+}
 
-    std::vector<RTTITypeEntry> types_array_entries;
+void Generator::emit_wire_event_decoder(
+    CodeWriter &w, types::Message event) const
+{
+    using Kind = types::ArgKind;
 
-    {
-        size_t null_run_length = _type_array_info.null_run_length;
+    w.line("// {}", func());
 
-        size_t types_array_offset = 0;
-        RTTITypeEntry entry;
-        entry.type = "nullptr";
-        entry.debug = "[null_run_stub]";
-        for (size_t nul_i = 0; nul_i != null_run_length; ++nul_i) {
-            entry.index = types_array_offset++;
-            types_array_entries.push_back(entry);
-        }
+    if (event.args().empty()) {
+        w.line(
+            "static bool decode_{0}(wire_reader_t &wire_in, {0}_event_t &)",
+            event.name());
+        w.line("{");
+        w.line("    return wire_in.done();");
+        w.line("}");
+        return;
     }
 
+    w.line(
+        "static bool decode_{0}(wire_reader_t &wire_in, "
+        "{0}_event_t &wire_event)",
+        event.name());
+    w.line("{");
     {
-        for (const TypeArrayInfo::Entry &type_entry : _type_array_info.array) {
-            RTTITypeEntry entry;
-            entry.type = type_entry.type;
-            entry.index =
-                type_entry.index.value() + _type_array_info.null_run_length;
-            entry.debug = std::format(
-                "[{}.{}.{}]",
-                type_entry.interface_name,
-                type_entry.message_name,
-                type_entry.arg_name);
-            types_array_entries.push_back(std::move(entry));
+        auto in = w.indent();
+        for (types::Arg arg : event.args()) {
+            switch (arg.kind()) {
+            case Kind::Int:
+            case Kind::Fixed:
+                w.line(
+                    "wire_event.{} = static_cast<int32_t>(wire_in.word());",
+                    arg.name());
+                break;
+            case Kind::UInt:
+            case Kind::UIntEnum:
+                w.line("wire_event.{} = wire_in.word();", arg.name());
+                break;
+            case Kind::String:
+            case Kind::NullString:
+                w.line(
+                    "wire_event.{} = wire_in.string({});",
+                    arg.name(),
+                    arg.kind() == Kind::NullString);
+                break;
+            case Kind::Object:
+            case Kind::NullObject:
+                w.line(
+                    "wire_event.{} = wire_in.object({});",
+                    arg.name(),
+                    arg.kind() == Kind::NullObject);
+                break;
+            case Kind::NewID:
+                if (!arg.interface_name()) {
+                    w.line(
+                        "wire_event.{}_interface = wire_in.string(false);",
+                        arg.name());
+                    w.line(
+                        "wire_event.{}_version = wire_in.word();",
+                        arg.name());
+                }
+                w.line("wire_event.{} = wire_in.object(false);", arg.name());
+                break;
+            case Kind::Array:
+                w.line("wire_event.{} = wire_in.array();", arg.name());
+                break;
+            case Kind::FD:
+                w.line("wire_event.{} = wire_in.fd();", arg.name());
+                break;
+            }
         }
+        w.line("return wire_in.done();");
     }
+    w.line("}");
+}
 
+void Generator::emit_wire_event_table(
+    CodeWriter &w, types::Interface iface) const
+{
+    w.line("// {}", func());
+
+    w.line(
+        "static constexpr uint16_t event_count = {};", iface.events().size());
+    w.blank();
+    w.line("/*");
+    w.line(" * Decodes event [opcode] and calls handler(<event>_event_t) if");
+    w.line(" * the handler takes it. False for an unknown opcode or a");
+    w.line(" * malformed message");
+    w.line(" */");
+    w.line("template <typename handler_t>");
+    w.line(
+        "static bool decode_event(uint16_t opcode, wire_reader_t &wire_in, "
+        "handler_t &handler)");
+    w.line("{");
     {
-        std::optional<size_t> max_index_size;
-        for (auto &e : types_array_entries) {
-            size_t index_size = std::formatted_size("{}", e.index);
-            max_index_size =
-                std::max(max_index_size.value_or(index_size), index_size);
+        auto in = w.indent();
+        w.line("using decode_fn = bool (*)(wire_reader_t &, handler_t &);");
+        w.line("static constexpr decode_fn decoders[] = {");
+        {
+            auto in2 = w.indent();
+            size_t event_i = 0;
+            for (types::Message event : iface.events()) {
+                w.line(
+                    "[](wire_reader_t &in, [[maybe_unused]] handler_t &h) {");
+                {
+                    auto in3 = w.indent();
+                    w.line("{}_event_t event{{}};", event.name());
+                    w.line("if (!decode_{}(in, event)) {{", event.name());
+                    w.line("    return false;");
+                    w.line("}");
+                    w.line("if constexpr (requires { h(event); }) {");
+                    w.line("    h(event);");
+                    w.line("}");
+                    w.line("return true;");
+                }
+                event_i++;
+                w.line(event_i == iface.events().size() ? "}" : "},");
+            }
         }
+        w.line("};");
+        w.line("if (opcode >= event_count) {");
+        w.line("    return false;");
+        w.line("}");
+        w.line("return decoders[opcode](wire_in, handler);");
+    }
+    w.line("}");
+}
 
-        for (auto &e : types_array_entries) {
-            e.debug = std::format(
-                "[{:{}}]{}", e.index, max_index_size.value(), e.debug);
-        }
-    };
+void Generator::emit_wire_request_size(
+    CodeWriter &w, types::Message request, size_t fixed_bytes) const
+{
+    w.line("// {}", func());
 
-    auto types_array_entries_reversed =
-        std::views::reverse(types_array_entries);
-    bool first = true;
-    for (auto &e : types_array_entries_reversed) {
-        if (!first) {
-            e.type = std::format("{},", e.type);
-        }
-        first = false;
+    bool variable = false;
+    for (types::Arg arg : request.args()) {
+        variable = variable || has_variable_size(arg);
     }
 
-    std::optional<size_t> max_type_size = [&types_array_entries]() {
-        std::optional<size_t> o_size;
-        for (auto &entry : types_array_entries) {
-            size_t e_size = entry.type.size();
-            o_size = std::max(o_size.value_or(e_size), e_size);
-        }
-        return o_size;
-    }();
-
-    StringList types_array_entry_strings;
-    for (auto &entry : types_array_entries) {
-        types_array_entry_strings += std::format(
-            "{:<{}} /* {} */", entry.type, max_type_size.value(), entry.debug);
+    if (!variable) {
+        w.line(
+            "static constexpr size_t wire_size_{} = {};",
+            request.name(),
+            fixed_bytes);
+        return;
     }
-    o += indent(types_array_entry_strings);
 
-    o += "};";
-    return o;
+    std::pmr::string sum = format_in(_resource, "{}", fixed_bytes);
+    w.line("static constexpr size_t wire_size_{}(", request.name());
+    {
+        auto in = w.indent();
+        CodeWriter::List args{w};
+        for (types::Arg arg : request.args()) {
+            if (!has_variable_size(arg)) {
+                continue;
+            }
+            if (arg.kind() == types::ArgKind::Array) {
+                args.item("size_t {}_size", arg.name());
+                sum += format_in(
+                    _resource,
+                    " + wire_buffer_t::padded_size({}_size)",
+                    arg.name());
+                continue;
+            }
+
+            std::string_view suffix =
+                arg.kind() == types::ArgKind::NewID ? "_interface" : "";
+            args.item("const char *{}{}", arg.name(), suffix);
+            sum += format_in(
+                _resource,
+                " + wire_buffer_t::padded_size("
+                "wire_buffer_t::string_size({}{}))",
+                arg.name(),
+                suffix);
+        }
+    }
+    w.line(")");
+    w.line("{");
+    w.line("    return {};", sum);
+    w.line("}");
 }
 
-StringList
-    Generator::emit_rtti_interface_struct_members(size_t iface_index) const
+void Generator::emit_wire_request_encoder_args(
+    CodeWriter &w, types::Message request) const
 {
-    StringList o;
-    o += std::format("// {}", func());
+    using Kind = types::ArgKind;
+
+    w.line("// {}", func());
 
-    bool has_entity = false;
-    auto add_sep = [&has_entity, &o]() {
-        if (has_entity) {
-            o += "";
+    CodeWriter::List args{w};
+    args.item("buffer_t &wire_out");
+    args.item("uint32_t wire_object_id");
+
+    for (types::Arg arg : request.args()) {
+        switch (arg.kind()) {
+        case Kind::Int:
+            args.item("int32_t {}", arg.name());
+            break;
+        case Kind::UInt:
+        case Kind::UIntEnum:
+            args.item("uint32_t {}", arg.name());
+            break;
+        case Kind::Fixed:
+            args.item("/* wl_fixed_t */ int32_t {}", arg.name());
+            break;
+        case Kind::String:
+            args.item("const char *{}", arg.name());
+            break;
+        case Kind::NullString:
+            args.item("/* nullptr<string> */ const char *{}", arg.name());
+            break;
+        case Kind::Object:
+            args.item("/* object id */ uint32_t {}", arg.name());
+            break;
+        case Kind::NullObject:
+            args.item("/* object id or 0 */ uint32_t {}", arg.name());
+            break;
+        case Kind::NewID:
+            if (!arg.interface_name()) {
+                args.item("const char *{}_interface", arg.name());
+                args.item("uint32_t {}_version", arg.name());
+            }
+            args.item("/* new object id */ uint32_t {}", arg.name());
+            break;
+        case Kind::Array:
+            args.item("const void *{}_data", arg.name());
+            args.item("size_t {}_size", arg.name());
+            break;
+        case Kind::FD:
+            args.item("int32_t {}", arg.name());
+            break;
         }
-        has_entity = true;
-    };
+    }
+}
 
-    const rtti::Interface &interface = _interfaces.at(iface_index);
+void Generator::emit_wire_request_encoder(
+    CodeWriter &w, types::Message request, size_t fixed_bytes) const
+{
+    using Kind = types::ArgKind;
 
-    auto emit_rtti_message_elements =
-        [&](const std::vector<rtti::Message> &msgs) -> StringList {
-        StringList ro;
-        if (msgs.empty()) {
-            return ro;
+    w.line("// {}", func());
+
+    size_t fd_count = 0;
+    bool variable = false;
+    for (types::Arg arg : request.args()) {
+        fd_count += arg.kind() == Kind::FD ? 1 : 0;
+        variable = variable || has_variable_size(arg);
+    }
+
+    w.line("template <typename buffer_t>");
+    w.line("static bool {}(", request.name());
+    {
+        auto in = w.indent();
+        emit_wire_request_encoder_args(w, request);
+    }
+    w.line(")");
+    w.line("{");
+    {
+        auto in = w.indent();
+
+        if (!variable) {
+            w.line("size_t wire_size = wire_size_{};", request.name());
+        } else {
+            std::pmr::string sum = format_in(_resource, "{}", fixed_bytes);
+            for (types::Arg arg : request.args()) {
+                if (!has_variable_size(arg)) {
+                    continue;
+                }
+                if (arg.kind() == Kind::String ||
+                    arg.kind() == Kind::NullString) {
+                    w.line(
+                        "size_t {0}_size = wire_buffer_t::string_size({0});",
+                        arg.name());
+                } else if (arg.kind() == Kind::NewID) {
+                    w.line(
+                        "size_t {0}_interface_size = "
+                        "wire_buffer_t::string_size({0}_interface);",
+                        arg.name());
+                }
+                sum += format_in(
+                    _resource,
+                    " + wire_buffer_t::padded_size({}{})",
+                    arg.name(),
+                    size_suffix(arg));
+            }
+            w.line("size_t wire_size = {};", sum);
         }
 
-        for (auto &msg : msgs) {
-            std::string rtti_ref_offset_str = "/* [null_run_stub] */ 0";
-            if (!msg.only_primitives) {
-                size_t offset =
-                    _type_array_info.find_index(interface.name, msg.name);
-                offset += _type_array_info.null_run_length;
-                std::string info_comment =
-                    std::format("[{}.{}]", interface.name, msg.name);
-                rtti_ref_offset_str =
-                    std::format("/* {} */ {}", info_comment, offset);
+        w.line(
+            "uint32_t *wire_p = wire_out.reserve(wire_size, {});", fd_count);
+        w.line("if (wire_p == nullptr) {");
+        w.line("    return false;");
+        w.line("}");
+        w.line("*wire_p++ = wire_object_id;");
+        w.line(
+            "*wire_p++ = static_cast<uint32_t>("
+            "wire_size << 16 | request_index_{});",
+            request.name());
+
+        for (types::Arg arg : request.args()) {
+            switch (arg.kind()) {
+            case Kind::Int:
+            case Kind::Fixed:
+                w.line("*wire_p++ = static_cast<uint32_t>({});", arg.name());
+                break;
+            case Kind::UInt:
+            case Kind::UIntEnum:
+            case Kind::Object:
+            case Kind::NullObject:
+                w.line("*wire_p++ = {};", arg.name());
+                break;
+            case Kind::String:
+            case Kind::NullString:
+                w.line(
+                    "*wire_p++ = static_cast<uint32_t>({}_size);",
+                    arg.name());
+                w.line(
+                    "wire_p = wire_buffer_t::put_bytes("
+                    "wire_p, {0}, {0}_size);",
+                    arg.name());
+                break;
+            case Kind::NewID:
+                if (!arg.interface_name()) {
+                    w.line(
+                        "*wire_p++ = static_cast<uint32_t>("
+                        "{}_interface_size);",
+                        arg.name());
+                    w.line(
+                        "wire_p = wire_buffer_t::put_bytes("
+                        "wire_p, {0}_interface, {0}_interface_size);",
+                        arg.name());
+                    w.line("*wire_p++ = {}_version;", arg.name());
+                }
+                w.line("*wire_p++ = {};", arg.name());
+                break;
+            case Kind::Array:
+                w.line(
+                    "*wire_p++ = static_cast<uint32_t>({}_size);",
+                    arg.name());
+                w.line(
+                    "wire_p = wire_buffer_t::put_bytes("
+                    "wire_p, {0}_data, {0}_size);",
+                    arg.name());
+                break;
+            case Kind::FD:
+                w.line("wire_out.push_fd({});", arg.name());
+                break;
             }
-            std::string rtti_ref_str =
-                std::format("rtti<traits>::types + {}", rtti_ref_offset_str);
-            ro += std::format(
-                "{{\"{}\", \"{}\", {}}}",
-                msg.name,
-                msg.args_signature,
-                rtti_ref_str);
         }
+        w.line("return true;");
+    }
+    w.line("}");
+}
+
+void Generator::emit_wire_struct(CodeWriter &w, types::Interface iface) const
+{
+    w.line("// {}", func());
+
+    w.line("struct {}_wire", iface.name());
+    w.line("{");
+    {
+        auto in = w.indent();
 
-        auto rev = std::views::reverse(ro.get());
         bool first = true;
-        for (std::string &elem : rev) {
+        auto separate = [&w, &first]() {
             if (!first) {
-                elem = elem + ",";
+                w.separate();
             }
             first = false;
-        }
+        };
 
-        return ro;
-    };
+        size_t request_i = 0;
+        for (types::Message request : iface.requests()) {
+            if (!_options.wire_encoders) {
+                break;
+            }
+            separate();
+            size_t fixed_bytes = 8;
+            for (types::Arg arg : request.args()) {
+                fixed_bytes += fixed_size(arg);
+            }
 
-    add_sep();
-    o += "template <typename traits>";
-    o += std::format(
-        "const typename traits::wl_interface_t rtti<traits>::{}_interface {{",
-        interface.name);
-    o += [&interface]() {
-        StringList o_memb;
-        o_memb += std::format("\"{}\", {},", interface.name, interface.version);
-        if (!interface.requests.empty()) {
-            o_memb += std::format(
-                "{}, rtti<traits>::{}_requests,",
-                interface.requests.size(),
-                interface.name);
-        } else {
-            o_memb += "0, nullptr,";
+            w.line(
+                "static constexpr uint16_t request_index_{} = {};",
+                request.name(),
+                request_i);
+            emit_wire_request_size(w, request, fixed_bytes);
+            emit_wire_request_encoder(w, request, fixed_bytes);
+            request_i++;
         }
 
-        if (!interface.events.empty()) {
-            o_memb += std::format(
-                "{}, rtti<traits>::{}_events",
-                interface.events.size(),
-                interface.name);
-        } else {
-            o_memb += "0, nullptr";
-        }
+        if (_options.wire_decoders && !iface.events().empty()) {
+            size_t event_i = 0;
+            for (types::Message event : iface.events()) {
+                separate();
+                w.line(
+                    "static constexpr uint16_t event_index_{} = {};",
+                    event.name(),
+                    event_i);
+                emit_wire_event_struct(w, event);
+                emit_wire_event_decoder(w, event);
+                event_i++;
+            }
 
-        return indent(o_memb);
-    }();
-    o += "};";
+            separate();
+            emit_wire_event_table(w, iface);
+        }
+    }
+    w.line("};");
+}
 
-    if (!interface.requests.empty()) {
-        add_sep();
-        o += "template <typename traits>";
-        o += std::format(
-            "const typename traits::wl_message_t rtti<traits>::{}_requests[] = "
-            "{{",
-            interface.name);
+void Generator::emit_wire(CodeWriter &w) const
+{
+    w.line("// {}", func());
 
-        StringList requests_list =
-            emit_rtti_message_elements(interface.requests);
-        o += indent(requests_list);
-        o += "};";
+    if (_options.wire_encoders) {
+        emit_wire_buffer_struct(w);
     }
 
-    if (!interface.events.empty()) {
-        add_sep();
-        o += "template <typename traits>";
-        o += std::format(
-            "const typename traits::wl_message_t rtti<traits>::{}_events[] = "
-            "{{",
-            interface.name);
-
-        StringList requests_list = emit_rtti_message_elements(interface.events);
-        o += indent(requests_list);
-        o += "};";
+    if (_options.wire_decoders) {
+        w.separate();
+        emit_wire_reader_struct(w);
     }
 
-    return o;
+    for (types::Interface iface : _protocol.interfaces()) {
+        bool requests = _options.wire_encoders && !iface.requests().empty();
+        bool events = _options.wire_decoders && !iface.events().empty();
+        if (!requests && !events) {
+            continue;
+        }
+        w.separate();
+        emit_wire_struct(w, iface);
+    }
 }
 
-StringList Generator::emit_rtti() const
-{
-    StringList o;
-    o += std::format("// {}", func());
+} // namespace wire
 
-    o += emit_rtti_interface_struct_types_member();
+void wl_gena::HeaderGenerator::emit_copyright(CodeWriter &w) const
+{
+    auto copyright = _protocol.copyright_xml();
+    if (!copyright) {
+        return;
+    }
 
-    o += "";
-    bool first = true;
-    for (size_t iface_i = 0; iface_i != _interfaces.size(); ++iface_i) {
-        auto iface_members = emit_rtti_interface_struct_members(iface_i);
-        if (!first) {
-            o += "";
-        }
-        first = false;
-        o += std::move(iface_members);
+    std::string decoded = decode_character_data(copyright.value());
+    if (!has_doc_text(decoded)) {
+        return;
     }
 
-    return o;
+    w.line("/*");
+    for_each_doc_line(decoded, [&w, this](std::string_view line) {
+        doc_text_line(w, line, _resource);
+    });
+    w.line(" */");
+    w.blank();
 }
-} // namespace rtti
 
-StringList wl_gena::HeaderGenerator::generate() const
+void wl_gena::HeaderGenerator::generate(CodeWriter &w) const
 {
-    StringList o;
-    o += "#pragma once";
-    o += "";
+    w.line("#pragma once");
+    w.blank();
+
+    emit_copyright(w);
+
     for (const std::string &include_file : _includes) {
-        o += std::format("#include {}", include_file);
+        w.line("#include {}", include_file);
     }
 
     if (!_includes.empty()) {
-        o += "";
+        w.blank();
     }
 
-    if (_ns_info.top_namespace().has_value()) {
-        o += std::format("namespace {} {{", _ns_info.top_namespace().value());
+    if (_resolved.top_namespace().has_value()) {
+        w.line("namespace {} {{", _resolved.top_namespace().value());
     }
 
-    o += std::format("namespace {} {{", _protocol.name);
+    w.line("namespace {} {{", _protocol.name());
 
-    o += "";
-    o += emit_object_forward();
+    w.blank();
+    emit_object_forward(w);
 
-    rtti::Generator rtti_gena{_protocol, _ns_info};
-    o += "";
-    o += rtti_gena.emit_rtti_struct();
+    _phases.enter(HeaderPhase::rtti);
+    rtti::Generator rtti_gena{_protocol, _resolved, _resource};
+    w.blank();
+    rtti_gena.emit_rtti_struct(w);
+    _phases.enter(HeaderPhase::emit);
 
-    o += "";
+    w.blank();
 
     bool first = true;
-    for (auto &iface : _protocol.interfaces) {
+    for (types::Interface iface : _protocol.interfaces()) {
         if (!first) {
-            o += "";
+            w.separate();
         }
         first = false;
 
-        InterfaceGenerator iface_gena{iface, _ns_info};
-        o += iface_gena.generate();
+        InterfaceGenerator iface_gena{
+            iface, _resolved, _options, _resource};
+        iface_gena.generate(w);
+    }
+
+    if (_options.wire_encoders || _options.wire_decoders) {
+        w.separate();
+        wire::Generator wire_gena{_protocol, _options, _resource};
+        wire_gena.emit_wire(w);
     }
 
-    o += "";
-    o += rtti_gena.emit_rtti();
+    _phases.enter(HeaderPhase::rtti);
+    w.blank();
+    rtti_gena.emit_rtti(w);
+    _phases.enter(HeaderPhase::emit);
 
-    o += std::format("}} // namespace {}", _protocol.name);
+    w.line("}} // namespace {}", _protocol.name());
 
-    if (_ns_info.top_namespace().has_value()) {
-        o +=
-            std::format("}} // namespace {}", _ns_info.top_namespace().value());
+    if (_resolved.top_namespace().has_value()) {
+        w.line("}} // namespace {}", _resolved.top_namespace().value());
     }
+};
 
-    auto make_empty_if_blank = [](std::string &str) {
-        auto non_space =
-            std::ranges::find_if(str, [](char c) { return c != ' '; });
-        if (non_space != std::end(str)) {
-            return;
-        }
-        str.clear();
-    };
+namespace {
 
-    std::string output;
-    for (auto &o_line : o.get()) {
-        make_empty_if_blank(o_line);
+void write_header(
+    const GenerateHeaderInput &I,
+    CodeWriter &w,
+    std::pmr::memory_resource *resource)
+{
+    if (!I.protocol) {
+        throw std::invalid_argument{"No protocol to generate header for"};
     }
 
-    return o;
-};
+    std::optional<std::string_view> top_namespace;
+    if (I.top_namespace_id) {
+        top_namespace = I.top_namespace_id.value();
+    }
 
-GenerateHeaderOutput generate_header(const GenerateHeaderInput &I)
-{
-    NamespaceInfo ns_info{I.protocol, I.context_protocols, I.top_namespace_id};
+    PhaseSwitch phases{I.phase_hook};
+    phases.enter(HeaderPhase::resolve);
+
+    NamespaceInfo ns_info{
+        *I.protocol, I.context_protocols, top_namespace, resource};
+
+    ResolvedProtocol resolved{*I.protocol, ns_info, resource};
 
-    HeaderGenerator gena{I.protocol, ns_info};
+    phases.enter(HeaderPhase::emit);
+    HeaderGenerator gena{*I.protocol, resolved, phases, resource};
     gena.includes() = I.includes;
+    gena.options().dispatchers = I.dispatchers;
+    gena.options().array_marshalling = I.array_marshalling;
+    gena.options().wire_encoders = I.wire_encoders;
+    gena.options().wire_decoders = I.wire_decoders;
+    gena.options().static_library = I.static_library;
 
-    auto lines = gena.generate();
+    gena.generate(w);
+}
 
-    std::string output;
-    for (auto &o_line : lines.get()) {
-        output += o_line;
-        output += "\n";
-    }
+} // namespace
+
+GenerateHeaderOutput generate_header(
+    const GenerateHeaderInput &I, std::pmr::memory_resource *resource)
+{
+    CodeWriter w{resource};
+    write_header(I, w, resource);
+    return GenerateHeaderOutput{w.take()};
+}
+
+void generate_header(
+    const GenerateHeaderInput &I,
+    const OutputSink &sink,
+    std::pmr::memory_resource *resource)
+{
+    CodeWriter w{sink, resource};
+    write_header(I, w, resource);
+    w.finish();
+}
+
+OutputSink buffer_sink(std::string &buffer)
+{
+    return [&buffer](std::span<const std::string_view> chunks) {
+        for (std::string_view chunk : chunks) {
+            buffer += chunk;
+        }
+    };
+}
 
-    return GenerateHeaderOutput{std::move(output)};
+OutputSink fd_sink(int fd)
+{
+    return [fd, name = std::format("descriptor {}", fd)](
+               std::span<const std::string_view> chunks) {
+        write_chunks(fd, chunks, name);
+    };
 }
 } // namespace wl_gena
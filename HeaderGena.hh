@@ -1,26 +1,113 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "CodeWriter.hh"
 #include "Types.hh"
 
 namespace wl_gena {
 
+/*
+ * Parts of header generation. One phase is active at a time: after the
+ * references are resolved, rtti and the rest of the header take turns
+ */
+enum class HeaderPhase
+{
+    resolve,
+    rtti,
+    emit,
+};
+
+/*
+ * Told when generation enters a phase and when it leaves it, a phase
+ * may be entered several times. Must not throw
+ */
+using HeaderPhaseHook = std::function<void(HeaderPhase phase, bool entering)>;
+
 struct GenerateHeaderInput
 {
-    wl_gena::types::Protocol protocol;
+    std::shared_ptr<const wl_gena::types::Protocol> protocol;
     std::optional<std::string> top_namespace_id;
     std::vector<std::string> includes;
-    std::vector<wl_gena::types::Protocol> context_protocols;
+    std::vector<std::shared_ptr<const wl_gena::types::Protocol>>
+        context_protocols;
+    /*
+     * Also emit a typed dispatcher for wl_proxy_add_dispatcher per
+     * interface with events. The traits then need wl_argument_t, and the
+     * client library wl_proxy_add_dispatcher
+     */
+    bool dispatchers = false;
+    /*
+     * Requests fill a wl_argument array on the stack and marshal it with
+     * wl_proxy_marshal_array_flags instead of the variadic
+     * wl_proxy_marshal_flags. The traits then need wl_argument_t, and the
+     * client library wl_proxy_marshal_array_flags
+     */
+    bool array_marshalling = false;
+    /*
+     * Also emit <interface>_wire structs with encoders that write the
+     * requests in the Wayland wire format into a wire_buffer_t, without
+     * the client library. Messages are batched back to back for a single
+     * sendmsg
+     */
+    bool wire_encoders = false;
+    /*
+     * Also emit decoders of received events into views of the wire
+     * bytes, and a decode_event jump table per interface with events.
+     * The header then needs <span> and <string_view>, e.g. via includes
+     */
+    bool wire_decoders = false;
+    /*
+     * The client library of the traits is called through its static
+     * member functions instead of a client_library_t member of every
+     * interface struct, so calls bind directly and the interface structs
+     * are empty. The functions may forward to one shared table
+     */
+    bool static_library = false;
+    /*
+     * Optional, for measurements
+     */
+    HeaderPhaseHook phase_hook;
 };
 
 struct GenerateHeaderOutput
 {
-    std::string output;
+    std::pmr::string output;
 };
 
-GenerateHeaderOutput generate_header(const GenerateHeaderInput &I);
+/*
+ * All the scratch strings and the output are allocated from the given
+ * resource, a monotonic buffer per header drops them all at once
+ *
+ * If the protocol was parsed with documentation, it is emitted as
+ * Doxygen comments and the copyright as a comment on top
+ */
+GenerateHeaderOutput generate_header(
+    const GenerateHeaderInput &I,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+/*
+ * Streams the header into [sink] while it is generated, only a bounded
+ * part of the output is held in memory at a time
+ */
+void generate_header(
+    const GenerateHeaderInput &I,
+    const OutputSink &sink,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+/*
+ * Appends to a caller buffer
+ */
+OutputSink buffer_sink(std::string &buffer);
+
+/*
+ * Writes to a descriptor with writev
+ */
+OutputSink fd_sink(int fd);
 
 } // namespace wl_gena
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+
+#include "JobPool.hh"
+
+namespace wl_gena {
+
+namespace {
+
+struct WorkerQueue
+{
+    void push(size_t job_index)
+    {
+        std::lock_guard lock{_mutex};
+        _jobs.push_back(job_index);
+    }
+
+    std::optional<size_t> pop_front()
+    {
+        std::lock_guard lock{_mutex};
+        if (_jobs.empty()) {
+            return std::nullopt;
+        }
+        size_t job_index = _jobs.front();
+        _jobs.pop_front();
+        return job_index;
+    }
+
+    std::optional<size_t> steal_back()
+    {
+        std::lock_guard lock{_mutex};
+        if (_jobs.empty()) {
+            return std::nullopt;
+        }
+        size_t job_index = _jobs.back();
+        _jobs.pop_back();
+        return job_index;
+    }
+
+  private:
+    std::mutex _mutex;
+    std::deque<size_t> _jobs;
+};
+
+struct JobRunner
+{
+    JobRunner(std::span<const Job> jobs, size_t worker_count)
+        : _jobs{jobs}, _queues(worker_count), _errors(jobs.size())
+    {
+        for (size_t job_i = 0; job_i != _jobs.size(); ++job_i) {
+            _queues[job_i % worker_count].push(job_i);
+        }
+    }
+
+    void work(size_t worker_index)
+    {
+        while (true) {
+            auto job_index_op = next_job(worker_index);
+            if (!job_index_op) {
+                return;
+            }
+            size_t job_index = job_index_op.value();
+
+            try {
+                _jobs[job_index]();
+            } catch (...) {
+                _errors[job_index] = std::current_exception();
+            }
+        }
+    }
+
+    void rethrow_first_error() const
+    {
+        for (const std::exception_ptr &error : _errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+  private:
+    /*
+     * Jobs are never added after construction, so once every queue was
+     * seen empty there is nothing left to run or steal
+     */
+    std::optional<size_t> next_job(size_t worker_index)
+    {
+        auto own_job = _queues[worker_index].pop_front();
+        if (own_job) {
+            return own_job;
+        }
+
+        for (size_t offset = 1; offset != _queues.size(); ++offset) {
+            size_t victim = (worker_index + offset) % _queues.size();
+            auto stolen_job = _queues[victim].steal_back();
+            if (stolen_job) {
+                return stolen_job;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    std::span<const Job> _jobs;
+    std::vector<WorkerQueue> _queues;
+    std::vector<std::exception_ptr> _errors;
+};
+
+} // namespace
+
+void run_jobs(std::span<const Job> jobs, size_t thread_count)
+{
+    if (jobs.empty()) {
+        return;
+    }
+    size_t worker_count = std::clamp<size_t>(thread_count, 1, jobs.size());
+
+    JobRunner runner{jobs, worker_count};
+
+    {
+        std::vector<std::jthread> helpers;
+        for (size_t worker_i = 1; worker_i < worker_count; ++worker_i) {
+            helpers.emplace_back([&runner, worker_i]() {
+                runner.work(worker_i);
+            });
+        }
+        runner.work(0);
+    }
+
+    runner.rethrow_first_error();
+}
+
+size_t default_thread_count()
+{
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+} // namespace wl_gena
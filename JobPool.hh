@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <span>
+
+namespace wl_gena {
+
+using Job = std::function<void()>;
+
+/*
+ * Runs every job exactly once on up to thread_count workers and blocks
+ * until all of them are done.
+ *
+ * Jobs are dealt round-robin into per-worker deques in the given order,
+ * so callers should put the most expensive ones first. A worker pops
+ * from the front of its own deque and, once it runs dry, steals from the
+ * back of the others.
+ *
+ * If jobs throw, the exception of the first failed job (in job order,
+ * not completion order) is rethrown after all workers have finished.
+ */
+void run_jobs(std::span<const Job> jobs, size_t thread_count);
+
+size_t default_thread_count();
+
+} // namespace wl_gena
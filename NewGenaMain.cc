@@ -1,14 +1,22 @@
 #include <algorithm>
+#include <charconv>
+#include <exception>
 #include <expected>
+#include <filesystem>
 #include <format>
-#include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <optional>
+#include <ostream>
 #include <ranges>
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -19,23 +27,135 @@
 #include <cstdint>
 #include <cstdlib>
 
+#include <unistd.h>
+
 #include "wl_gena/GenaMain.hh"
 
+#include "Daemon.hh"
+#include "File.hh"
 #include "Format.hh"
 #include "HeaderGena.hh"
+#include "JobPool.hh"
 #include "Parser.hh"
+#include "ProtocolStore.hh"
+#include "Trace.hh"
 #include "Types.hh"
 
 namespace {
 
+/*
+ * Where a mode writes its output and which parsed protocols it may reuse
+ *
+ * A null protocol_store makes the mode create its own for the run, the
+ * server hands in its long-lived store instead
+ *
+ * out_fd is the descriptor behind [out], if output may bypass the stream
+ *
+ * Relative paths in the arguments are relative to base_dir, the working
+ * directory of the client in server mode; empty means the own one
+ */
+struct ModeContext
+{
+    std::ostream &out;
+    std::ostream &err;
+    wl_gena::ProtocolStore *protocol_store = nullptr;
+    int out_fd = -1;
+    std::filesystem::path base_dir = {};
+};
+
+/*
+ * [file_name] as seen from [base_dir], for opening it. Names that end
+ * up in generated files (depfiles) stay as given
+ */
+std::string resolve_path(
+    const std::filesystem::path &base_dir, const std::string &file_name)
+{
+    if (base_dir.empty()) {
+        return file_name;
+    }
+    return (base_dir / file_name).string();
+}
+
+/*
+ * What --stats and --trace=<file> ask a mode to measure
+ */
+struct MeasureArgs
+{
+    bool stats = false;
+    std::optional<std::string> trace_file_name;
+
+    bool any() const
+    {
+        return stats || trace_file_name.has_value();
+    }
+};
+
+/*
+ * Removes --stats and --trace=<file> from args
+ */
+auto take_measure_args(std::vector<std::string> &args)
+    -> std::expected<MeasureArgs, std::string>
+{
+    MeasureArgs out{};
+
+    auto stats_it = std::ranges::find(args, "--stats");
+    if (stats_it != std::end(args)) {
+        args.erase(stats_it);
+        out.stats = true;
+    }
+
+    constexpr std::string_view trace_prefix = "--trace=";
+    auto trace_it = std::ranges::find_if(args, [](const std::string &arg) {
+        return arg.starts_with(trace_prefix);
+    });
+    if (trace_it != std::end(args)) {
+        std::string trace_file_name = trace_it->substr(trace_prefix.size());
+        if (trace_file_name.empty()) {
+            return std::unexpected("No file for --trace= option was found");
+        }
+        args.erase(trace_it);
+        out.trace_file_name = std::move(trace_file_name);
+    }
+
+    return out;
+}
+
+/*
+ * Stats go to the error stream, so they never mix with generated output
+ */
+void report_measurements(
+    const MeasureArgs &args,
+    const wl_gena::JobStats &stats,
+    const wl_gena::Trace &trace,
+    ModeContext &ctx)
+{
+    if (args.stats) {
+        ctx.err << wl_gena::format_job_stats(stats);
+    }
+    if (args.trace_file_name) {
+        wl_gena::write_file_if_changed(
+            resolve_path(ctx.base_dir, args.trace_file_name.value()),
+            trace.json());
+    }
+}
+
 struct JsonModeArgs
 {
     std::string proto_file_name;
+    MeasureArgs measure;
 };
 
 auto parse_json_mode_args(std::vector<std::string> args)
     -> std::expected<JsonModeArgs, std::string>
 {
+    JsonModeArgs out{};
+
+    auto measure_op = take_measure_args(args);
+    if (!measure_op) {
+        return std::unexpected(std::move(measure_op.error()));
+    }
+    out.measure = std::move(measure_op.value());
+
     if (args.empty()) {
         return std::unexpected("Expected <protocol_file> argument");
     }
@@ -46,66 +166,134 @@ auto parse_json_mode_args(std::vector<std::string> args)
         }
         FormatVectorWrap args_f{args};
 
-        return std::unexpected(
-            std::format("Expected <protocol_file> only: got {}", args_f));
+        return std::unexpected(std::format(
+            "Expected <protocol_file> [--stats] [--trace=file] only: got {}",
+            args_f));
     }
 
     std::string input_proto_filename = *args.begin();
     args.clear();
 
-    JsonModeArgs out{};
     out.proto_file_name = input_proto_filename;
 
     return out;
 }
 
-std::vector<std::byte> read_file(const std::string &name)
+void count_elements(
+    const wl_gena::types::Protocol &protocol, wl_gena::JobStats &stats)
 {
-    std::ifstream ifile{name, std::ios::binary};
-    ifile.exceptions(std::fstream::badbit);
-    ifile.exceptions(std::fstream::failbit);
-    auto start = std::istreambuf_iterator<char>{ifile};
-    auto end = std::istreambuf_iterator<char>{};
-    std::vector<std::byte> out;
-    while (start != end) {
-        uint8_t val = *start;
-        out.emplace_back(std::byte{val});
-        start++;
-    }
-
-    return out;
+    stats.interfaces += protocol.interface_records.size();
+    stats.messages +=
+        protocol.request_records.size() + protocol.event_records.size();
+    stats.args += protocol.arg_records.size();
+    stats.enums += protocol.enum_records.size();
 }
 
-std::string read_text_file(const std::string &name)
+void process_json_mode(const JsonModeArgs &args, ModeContext &ctx)
 {
-    std::string output;
-    auto data = read_file(name);
+    wl_gena::JobStats stats;
+    wl_gena::Trace trace;
+    {
+        wl_gena::JobClock job_clock{
+            stats,
+            args.measure.trace_file_name ? &trace : nullptr,
+            0,
+            args.proto_file_name};
+        wl_gena::JobClock *clock = args.measure.any() ? &job_clock : nullptr;
+
+        std::string file_name =
+            resolve_path(ctx.base_dir, args.proto_file_name);
+        std::expected<wl_gena::types::Protocol, std::string> protocol_op;
+        if (clock) {
+            /*
+             * Read whole, rather than streamed into the parser, so reading
+             * and parsing show up as phases of their own
+             */
+            std::unique_ptr<wl_gena::InputFile> protocol_file;
+            {
+                wl_gena::PhaseScope read_phase{
+                    clock, wl_gena::JobPhase::read};
+                protocol_file =
+                    std::make_unique<wl_gena::InputFile>(file_name);
+            }
+            std::string_view protocol_xml = protocol_file->view();
+            stats.input_bytes = protocol_xml.size();
+
+            wl_gena::PhaseScope parse_phase{clock, wl_gena::JobPhase::parse};
+            protocol_op = wl_gena::parse_protocol(protocol_xml);
+        } else {
+            wl_gena::OpenedFile protocol_file{file_name};
+            protocol_op = wl_gena::parse_protocol_fd(protocol_file.fd());
+        }
+        if (!protocol_op) {
+            ctx.err << protocol_op.error();
+            return;
+        }
+        const wl_gena::types::Protocol &protocol = protocol_op.value();
+        count_elements(protocol, stats);
+
+        std::string output;
+        {
+            wl_gena::PhaseScope emit_phase{clock, wl_gena::JobPhase::emit};
+            output = std::format("{}\n", protocol);
+        }
+        stats.output_bytes = output.size();
+
+        wl_gena::PhaseScope write_phase{clock, wl_gena::JobPhase::write};
+        ctx.out << output;
+    }
 
-    auto to_char = [](std::byte b) { return std::to_integer<char>(b); };
-    std::ranges::copy(
-        data | std::views::transform(to_char), std::back_inserter(output));
-    return output;
+    report_measurements(args.measure, stats, trace, ctx);
 }
 
-void process_json_mode(const JsonModeArgs &args)
+/*
+ * Removes "<option> <value>" from args and returns the value
+ */
+auto take_option_value(
+    std::vector<std::string> &args,
+    std::string_view option,
+    std::string_view syntax_message)
+    -> std::expected<std::optional<std::string>, std::string>
 {
-    std::string protocol_xml = read_text_file(args.proto_file_name);
-    auto protocol_op = wl_gena::parse_protocol(protocol_xml);
-    if (!protocol_op) {
-        std::cerr << protocol_op.error();
-        return;
+    auto option_it = std::ranges::find(args, option);
+    if (option_it == std::end(args)) {
+        return std::nullopt;
+    }
+
+    auto option_val_it = option_it + 1;
+    if (option_val_it == std::end(args)) {
+        std::string message =
+            std::format("No value for {} option was found. ", option);
+        message += std::format(
+            "Expected arguments with following syntax ({})", syntax_message);
+        return std::unexpected(std::move(message));
     }
-    auto &protocol = protocol_op.value();
 
-    std::cout << std::format("{}\n", protocol);
+    std::string value = std::move(*option_val_it);
+    args.erase(option_it, option_val_it + 1);
+    return value;
 }
 
+/*
+ * Output file name that writes the header to stdout
+ */
+constexpr std::string_view stdout_file_name = "-";
+
 struct HeaderModeArgs
 {
     std::string proto_file_name;
     std::string output_file_name;
     std::vector<std::string> includes;
     std::vector<std::string> context_protocol_file_names;
+    std::optional<std::string> cache_dir;
+    std::optional<std::string> depfile_name;
+    bool docs = false;
+    bool dispatchers = false;
+    bool array_marshalling = false;
+    bool wire_encoders = false;
+    bool wire_decoders = false;
+    bool static_library = false;
+    MeasureArgs measure;
 };
 
 auto parse_header_mode_args(std::vector<std::string> args)
@@ -115,15 +303,79 @@ auto parse_header_mode_args(std::vector<std::string> args)
 
     std::string syntax_message;
     syntax_message +=
-        "<protocol_file> <output_file> "
+        "<protocol_file> <output_file|-> "
         "[--includes file[,file_2,/system_file,/system_file_2,...]] "
-        "[--context_protocols protocol_file[,protocol_file_2,...]]";
+        "[--context_protocols protocol_file[,protocol_file_2,...]] "
+        "[--cache_dir directory] "
+        "[--depfile file] "
+        "[--docs] "
+        "[--dispatchers] "
+        "[--array_marshalling] "
+        "[--wire_encoders] "
+        "[--wire_decoders] "
+        "[--static_library] "
+        "[--stats] "
+        "[--trace=file]";
 
     auto help_it = std::ranges::find(args, "--help");
     if (help_it != std::end(args)) {
         return std::unexpected(std::move(syntax_message));
     }
 
+    auto cache_dir_op = take_option_value(args, "--cache_dir", syntax_message);
+    if (!cache_dir_op) {
+        return std::unexpected(std::move(cache_dir_op.error()));
+    }
+    out.cache_dir = std::move(cache_dir_op.value());
+
+    auto depfile_op = take_option_value(args, "--depfile", syntax_message);
+    if (!depfile_op) {
+        return std::unexpected(std::move(depfile_op.error()));
+    }
+    out.depfile_name = std::move(depfile_op.value());
+
+    auto measure_op = take_measure_args(args);
+    if (!measure_op) {
+        return std::unexpected(std::move(measure_op.error()));
+    }
+    out.measure = std::move(measure_op.value());
+
+    auto docs_it = std::ranges::find(args, "--docs");
+    if (docs_it != std::end(args)) {
+        args.erase(docs_it);
+        out.docs = true;
+    }
+
+    auto dispatchers_it = std::ranges::find(args, "--dispatchers");
+    if (dispatchers_it != std::end(args)) {
+        args.erase(dispatchers_it);
+        out.dispatchers = true;
+    }
+
+    auto array_marshalling_it = std::ranges::find(args, "--array_marshalling");
+    if (array_marshalling_it != std::end(args)) {
+        args.erase(array_marshalling_it);
+        out.array_marshalling = true;
+    }
+
+    auto wire_encoders_it = std::ranges::find(args, "--wire_encoders");
+    if (wire_encoders_it != std::end(args)) {
+        args.erase(wire_encoders_it);
+        out.wire_encoders = true;
+    }
+
+    auto wire_decoders_it = std::ranges::find(args, "--wire_decoders");
+    if (wire_decoders_it != std::end(args)) {
+        args.erase(wire_decoders_it);
+        out.wire_decoders = true;
+    }
+
+    auto static_library_it = std::ranges::find(args, "--static_library");
+    if (static_library_it != std::end(args)) {
+        args.erase(static_library_it);
+        out.static_library = true;
+    }
+
     auto includes_it = std::ranges::find(args, "--includes");
     if (includes_it != std::end(args)) {
         auto includes_val_it = includes_it + 1;
@@ -214,51 +466,552 @@ auto parse_header_mode_args(std::vector<std::string> args)
     out.proto_file_name = args.at(0);
     out.output_file_name = args.at(1);
 
+    if (out.depfile_name && out.output_file_name == stdout_file_name) {
+        return std::unexpected(std::string{
+            "--depfile needs an output file to name as its target, "
+            "not stdout (\"-\")"});
+    }
+
     return out;
 }
 
-void process_header_mode(const HeaderModeArgs &args)
+/*
+ * Make/Ninja compatible escaping of a depfile path
+ */
+std::string escape_depfile_path(std::string_view path)
 {
-    std::string protocol_xml = read_text_file(args.proto_file_name);
-    std::ofstream output_file{args.output_file_name};
+    std::string out;
+    for (char c : path) {
+        if (c == ' ' || c == '#') {
+            out += '\\';
+        }
+        if (c == '$') {
+            out += '$';
+        }
+        out += c;
+    }
+    return out;
+}
 
-    output_file.exceptions(std::ifstream::failbit);
-    output_file.exceptions(std::ifstream::badbit);
+std::string make_depfile(const HeaderModeArgs &args)
+{
+    std::string out = escape_depfile_path(args.output_file_name);
+    out += ':';
 
-    auto protocol_op = wl_gena::parse_protocol(protocol_xml);
-    if (!protocol_op) {
-        throw std::runtime_error{protocol_op.error()};
-    }
-    auto protocol = protocol_op.value();
+    auto add_dependency = [&out](std::string_view path) {
+        out += " \\\n  ";
+        out += escape_depfile_path(path);
+    };
 
-    std::vector<std::string> context_proto_content_list;
-    for (auto &ctx_proto_filename : args.context_protocol_file_names) {
-        std::string ctx_proto_content = read_text_file(ctx_proto_filename);
-        context_proto_content_list.push_back(std::move(ctx_proto_content));
+    add_dependency(args.proto_file_name);
+    for (const std::string &ctx_proto : args.context_protocol_file_names) {
+        add_dependency(ctx_proto);
     }
+    out += '\n';
 
-    std::vector<wl_gena::types::Protocol> context_protocols;
-    for (const std::string &proto_file_content : context_proto_content_list) {
-        auto context_proto_op = wl_gena::parse_protocol(proto_file_content);
-        if (!context_proto_op) {
-            throw std::runtime_error{context_proto_op.error()};
-        }
-        context_protocols.push_back(std::move(context_proto_op.value()));
+    return out;
+}
+
+/*
+ * [stdout_sink] receives the header if the output file is "-", relative
+ * paths are relative to [base_dir] (see ModeContext)
+ *
+ * A given clock measures the job
+ */
+void process_header_job(
+    const HeaderModeArgs &args,
+    wl_gena::ProtocolStore &protocol_store,
+    const std::filesystem::path &base_dir,
+    const wl_gena::OutputSink &stdout_sink = {},
+    wl_gena::JobClock *clock = nullptr)
+{
+    /*
+     * Only the protocol the header is generated for is parsed with
+     * documentation, context protocols are just looked up in
+     */
+    auto protocol = protocol_store.get(
+        resolve_path(base_dir, args.proto_file_name), args.docs, clock);
+
+    std::vector<wl_gena::ProtocolStore::ProtocolPtr> context_protocols;
+    for (auto &ctx_proto_filename : args.context_protocol_file_names) {
+        context_protocols.push_back(protocol_store.get(
+            resolve_path(base_dir, ctx_proto_filename), false, clock));
     }
 
     wl_gena::GenerateHeaderInput I;
     I.protocol = std::move(protocol);
     I.includes = args.includes;
+    I.dispatchers = args.dispatchers;
+    I.array_marshalling = args.array_marshalling;
+    I.wire_encoders = args.wire_encoders;
+    I.wire_decoders = args.wire_decoders;
+    I.static_library = args.static_library;
     I.context_protocols = std::move(context_protocols);
 
-    auto O = generate_header(I);
+    auto measured_sink =
+        [clock](const wl_gena::OutputSink &sink) -> wl_gena::OutputSink {
+        if (!clock) {
+            return sink;
+        }
+        return [clock, &sink](std::span<const std::string_view> chunks) {
+            wl_gena::PhaseScope write_phase{clock, wl_gena::JobPhase::write};
+            for (std::string_view chunk : chunks) {
+                clock->stats().output_bytes += chunk.size();
+            }
+            sink(chunks);
+        };
+    };
+
+    if (clock) {
+        count_elements(*I.protocol, clock->stats());
+        I.phase_hook = [clock](wl_gena::HeaderPhase phase, bool entering) {
+            if (entering) {
+                clock->enter(wl_gena::job_phase_of(phase));
+            } else {
+                clock->leave();
+            }
+        };
+    }
+
+    /*
+     * Generation scratch is dropped in one go once the header is written;
+     * the protocols themselves are shared through the store and stay on
+     * the default heap
+     */
+    std::pmr::monotonic_buffer_resource arena;
+    if (args.output_file_name == stdout_file_name) {
+        generate_header(I, measured_sink(stdout_sink), &arena);
+    } else {
+        wl_gena::FileUpdate output{
+            resolve_path(base_dir, args.output_file_name)};
+        wl_gena::OutputSink output_sink =
+            [&output](std::span<const std::string_view> chunks) {
+                output.write(chunks);
+            };
+        generate_header(I, measured_sink(output_sink), &arena);
 
-    output_file << O.output;
+        wl_gena::PhaseScope write_phase{clock, wl_gena::JobPhase::write};
+        output.commit();
+    }
+
+    if (args.depfile_name) {
+        wl_gena::PhaseScope write_phase{clock, wl_gena::JobPhase::write};
+        wl_gena::write_file_if_changed(
+            resolve_path(base_dir, args.depfile_name.value()),
+            make_depfile(args));
+    }
 }
 
-} // namespace
+/*
+ * The store handed in through the context unless the request names a
+ * cache directory: a server store is shared by all clients and has no
+ * cache, so such a request gets a store of its own in [own_store]
+ */
+wl_gena::ProtocolStore &select_protocol_store(
+    const std::optional<std::string> &cache_dir,
+    ModeContext &ctx,
+    std::optional<wl_gena::ProtocolStore> &own_store)
+{
+    if (ctx.protocol_store && !cache_dir) {
+        return *ctx.protocol_store;
+    }
+    std::optional<std::filesystem::path> resolved_cache_dir;
+    if (cache_dir) {
+        resolved_cache_dir = resolve_path(ctx.base_dir, cache_dir.value());
+    }
+    return own_store.emplace(std::move(resolved_cache_dir));
+}
 
-void wl_gena::main(const std::vector<std::string> &argv)
+void process_header_mode(const HeaderModeArgs &args, ModeContext &ctx)
+{
+    wl_gena::OutputSink stdout_sink;
+    if (ctx.out_fd >= 0) {
+        ctx.out.flush();
+        stdout_sink = wl_gena::fd_sink(ctx.out_fd);
+    } else {
+        stdout_sink = [&ctx](std::span<const std::string_view> chunks) {
+            for (std::string_view chunk : chunks) {
+                ctx.out.write(chunk.data(), std::streamsize(chunk.size()));
+            }
+        };
+    }
+
+    std::optional<wl_gena::ProtocolStore> own_protocol_store;
+    wl_gena::ProtocolStore &protocol_store =
+        select_protocol_store(args.cache_dir, ctx, own_protocol_store);
+
+    if (!args.measure.any()) {
+        process_header_job(args, protocol_store, ctx.base_dir, stdout_sink);
+        return;
+    }
+
+    wl_gena::JobStats stats;
+    wl_gena::Trace trace;
+    {
+        wl_gena::JobClock clock{
+            stats,
+            args.measure.trace_file_name ? &trace : nullptr,
+            0,
+            args.output_file_name};
+        process_header_job(
+            args, protocol_store, ctx.base_dir, stdout_sink, &clock);
+    }
+    report_measurements(args.measure, stats, trace, ctx);
+}
+
+struct BatchModeArgs
+{
+    std::string jobs_file_name;
+    size_t thread_count = 1;
+    std::optional<std::string> cache_dir;
+    MeasureArgs measure;
+};
+
+auto parse_batch_mode_args(std::vector<std::string> args)
+    -> std::expected<BatchModeArgs, std::string>
+{
+    BatchModeArgs out{};
+    out.thread_count = wl_gena::default_thread_count();
+
+    std::string syntax_message =
+        "[-j thread_count] [--cache_dir directory] [--stats] "
+        "[--trace=file] <jobs_file> "
+        "(one header mode job per line: "
+        "<protocol_file> <output_file> [--includes ...] "
+        "[--context_protocols ...] [--docs] [--dispatchers] "
+        "[--array_marshalling] [--wire_encoders] [--wire_decoders] "
+        "[--static_library])";
+
+    auto help_it = std::ranges::find(args, "--help");
+    if (help_it != std::end(args)) {
+        return std::unexpected(std::move(syntax_message));
+    }
+
+    auto cache_dir_op = take_option_value(args, "--cache_dir", syntax_message);
+    if (!cache_dir_op) {
+        return std::unexpected(std::move(cache_dir_op.error()));
+    }
+    out.cache_dir = std::move(cache_dir_op.value());
+
+    auto measure_op = take_measure_args(args);
+    if (!measure_op) {
+        return std::unexpected(std::move(measure_op.error()));
+    }
+    out.measure = std::move(measure_op.value());
+
+    auto threads_op = take_option_value(args, "-j", syntax_message);
+    if (!threads_op) {
+        return std::unexpected(std::move(threads_op.error()));
+    }
+    if (threads_op.value()) {
+        const std::string &threads_val = threads_op.value().value();
+        size_t thread_count = 0;
+        auto status = std::from_chars(
+            threads_val.data(),
+            threads_val.data() + threads_val.size(),
+            thread_count);
+        bool parsed = status.ec == std::errc{} &&
+                      status.ptr == threads_val.data() + threads_val.size();
+        if (!parsed || thread_count == 0) {
+            return std::unexpected(std::format(
+                "Bad -j value [{}]: expected positive integer", threads_val));
+        }
+
+        out.thread_count = thread_count;
+    }
+
+    if (args.size() != 1) {
+        for (auto &dec_arg : args) {
+            dec_arg = std::format("({})", dec_arg);
+        }
+        FormatVectorWrap args_f{args};
+
+        return std::unexpected(std::format(
+            "Expected arguments with following syntax ({}), got {} instead",
+            syntax_message,
+            args_f));
+    }
+
+    out.jobs_file_name = args.at(0);
+    return out;
+}
+
+auto split_job_line(std::string_view line) -> std::vector<std::string>
+{
+    std::vector<std::string> out;
+    std::string current;
+    for (char c : line) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            if (!current.empty()) {
+                out.push_back(std::move(current));
+                current.clear();
+            }
+            continue;
+        }
+        current += c;
+    }
+    if (!current.empty()) {
+        out.push_back(std::move(current));
+    }
+    return out;
+}
+
+auto parse_batch_jobs(std::string_view jobs_file_content)
+    -> std::expected<std::vector<HeaderModeArgs>, std::string>
+{
+    std::vector<HeaderModeArgs> jobs;
+
+    size_t line_number = 0;
+    for (auto line_range : jobs_file_content | std::views::split('\n')) {
+        line_number++;
+        std::string_view line{line_range.begin(), line_range.end()};
+
+        std::vector<std::string> job_args = split_job_line(line);
+        if (job_args.empty() || job_args.front().starts_with('#')) {
+            continue;
+        }
+
+        auto job_op = parse_header_mode_args(std::move(job_args));
+        if (!job_op) {
+            return std::unexpected(
+                std::format("Job at line {}: {}", line_number, job_op.error()));
+        }
+        if (job_op.value().output_file_name == stdout_file_name) {
+            return std::unexpected(std::format(
+                "Job at line {}: jobs run in parallel and cannot share "
+                "stdout, give them output files",
+                line_number));
+        }
+        if (job_op.value().cache_dir) {
+            return std::unexpected(std::format(
+                "Job at line {}: --cache_dir is shared by all jobs, "
+                "pass it to batch mode instead",
+                line_number));
+        }
+        if (job_op.value().measure.any()) {
+            return std::unexpected(std::format(
+                "Job at line {}: --stats and --trace= cover the whole batch, "
+                "pass them to batch mode instead",
+                line_number));
+        }
+        jobs.push_back(std::move(job_op.value()));
+    }
+
+    return jobs;
+}
+
+auto job_cost(const HeaderModeArgs &job, const std::filesystem::path &base_dir)
+    -> uintmax_t
+{
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(
+        resolve_path(base_dir, job.proto_file_name), ec);
+    if (ec) {
+        return 0;
+    }
+    return size;
+}
+
+void process_batch_mode(const BatchModeArgs &args, ModeContext &ctx)
+{
+    wl_gena::InputFile jobs_file{
+        resolve_path(ctx.base_dir, args.jobs_file_name)};
+
+    auto jobs_op = parse_batch_jobs(jobs_file.view());
+    if (!jobs_op) {
+        throw std::runtime_error{jobs_op.error()};
+    }
+    std::vector<HeaderModeArgs> &header_jobs = jobs_op.value();
+
+    /*
+     * Job sizes are very uneven (wayland.xml vs small staging protocols)
+     * so start the biggest ones first and let the small ones fill the gaps.
+     * Every job writes its own output file, which keeps the result
+     * independent of the order jobs are picked up in
+     */
+    std::vector<uintmax_t> costs;
+    for (const HeaderModeArgs &job : header_jobs) {
+        costs.push_back(job_cost(job, ctx.base_dir));
+    }
+    std::vector<size_t> order(header_jobs.size());
+    std::iota(std::begin(order), std::end(order), 0);
+    std::ranges::stable_sort(order, [&costs](size_t l, size_t r) {
+        return costs[l] > costs[r];
+    });
+
+    std::optional<wl_gena::ProtocolStore> own_protocol_store;
+    wl_gena::ProtocolStore &protocol_store =
+        select_protocol_store(args.cache_dir, ctx, own_protocol_store);
+    const std::filesystem::path &base_dir = ctx.base_dir;
+
+    /*
+     * Jobs are numbered in jobs file order, each has its own stats so
+     * workers never share them
+     */
+    std::vector<wl_gena::JobStats> job_stats(header_jobs.size());
+    wl_gena::Trace trace;
+    wl_gena::Trace *trace_ptr =
+        args.measure.trace_file_name ? &trace : nullptr;
+
+    /*
+     * run_jobs would report the first failure in the cost order jobs are
+     * handed to it in, so failures are kept by jobs file index instead
+     */
+    std::vector<std::exception_ptr> job_errors(header_jobs.size());
+
+    std::vector<wl_gena::Job> jobs;
+    for (size_t job_i : order) {
+        const HeaderModeArgs &job = header_jobs[job_i];
+        wl_gena::JobStats *stats =
+            args.measure.any() ? &job_stats[job_i] : nullptr;
+        jobs.emplace_back([&, stats, job_i]() {
+            try {
+                if (!stats) {
+                    process_header_job(job, protocol_store, base_dir);
+                    return;
+                }
+                wl_gena::JobClock clock{
+                    *stats, trace_ptr, job_i, job.output_file_name};
+                process_header_job(
+                    job, protocol_store, base_dir, {}, &clock);
+            } catch (std::exception &e) {
+                std::string message = std::format(
+                    "Job [{} -> {}] failed: {}",
+                    job.proto_file_name,
+                    job.output_file_name,
+                    e.what());
+                job_errors[job_i] = std::make_exception_ptr(
+                    std::runtime_error{std::move(message)});
+            }
+        });
+    }
+
+    wl_gena::run_jobs(jobs, args.thread_count);
+    for (const std::exception_ptr &error : job_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    wl_gena::JobStats total_stats;
+    for (size_t job_i = 0; job_i != header_jobs.size(); ++job_i) {
+        const HeaderModeArgs &job = header_jobs[job_i];
+        const wl_gena::JobStats &stats = job_stats[job_i];
+        if (args.measure.stats) {
+            ctx.err << std::format(
+                "{} -> {}: {}\n",
+                job.proto_file_name,
+                job.output_file_name,
+                wl_gena::format_job_stats_line(stats));
+        }
+        total_stats += stats;
+    }
+    report_measurements(args.measure, total_stats, trace, ctx);
+}
+
+struct ServerModeArgs
+{
+    std::string socket_path;
+};
+
+auto parse_server_mode_args(std::vector<std::string> args)
+    -> std::expected<ServerModeArgs, std::string>
+{
+    std::string syntax_message = "<socket_path>";
+
+    if (args.size() != 1 || args.at(0) == "--help") {
+        return std::unexpected(std::format(
+            "Expected arguments with following syntax ({})", syntax_message));
+    }
+
+    ServerModeArgs out{};
+    out.socket_path = args.at(0);
+    return out;
+}
+
+struct ClientModeArgs
+{
+    std::string socket_path;
+    std::vector<std::string> forwarded_argv;
+};
+
+auto parse_client_mode_args(std::vector<std::string> args)
+    -> std::expected<ClientModeArgs, std::string>
+{
+    std::string syntax_message = "<socket_path> <mode> [mode arguments...]";
+
+    if (args.size() < 2 || args.at(0) == "--help") {
+        return std::unexpected(std::format(
+            "Expected arguments with following syntax ({})", syntax_message));
+    }
+
+    ClientModeArgs out{};
+    out.socket_path = args.at(0);
+    out.forwarded_argv.assign(std::begin(args) + 1, std::end(args));
+    return out;
+}
+
+/*
+ * Modes a server can run on behalf of a client
+ */
+bool is_forwardable_mode(std::string_view mode)
+{
+    return mode == "json" || mode == "header" || mode == "batch";
+}
+
+/*
+ * "-" reads the stdin of the client, which the server cannot reach: it
+ * would read its own instead, and block
+ */
+bool uses_stdin(const std::vector<std::string> &argv)
+{
+    return std::ranges::find(argv, "-") != argv.end();
+}
+
+void run_mode(const std::vector<std::string> &argv, ModeContext &ctx);
+
+void process_server_mode(const ServerModeArgs &args)
+{
+    // Owned by the handler, connections may outlive this function
+    auto protocol_store = std::make_shared<wl_gena::ProtocolStore>();
+
+    auto handler = std::make_shared<const wl_gena::ServerRequestHandler>(
+        [protocol_store](
+            const std::string &client_cwd,
+            const std::vector<std::string> &argv,
+            std::ostream &out,
+            std::ostream &err) {
+            if (argv.empty() || !is_forwardable_mode(argv.front())) {
+                throw std::runtime_error{
+                    "Server accepts json, header and batch requests only"};
+            }
+            if (uses_stdin(argv)) {
+                throw std::runtime_error{
+                    "Server cannot read the stdin of a client"};
+            }
+
+            protocol_store->drop_stale();
+
+            ModeContext ctx{out, err, protocol_store.get()};
+            ctx.base_dir = client_cwd;
+            run_mode(argv, ctx);
+        });
+
+    wl_gena::serve(args.socket_path, std::move(handler));
+}
+
+void process_client_mode(const ClientModeArgs &args)
+{
+    if (uses_stdin(args.forwarded_argv)) {
+        throw std::runtime_error{"Server cannot read the stdin of a client"};
+    }
+    if (!wl_gena::forward_to_server(args.socket_path, args.forwarded_argv)) {
+        throw std::runtime_error{
+            std::format("No server listening on [{}]", args.socket_path)};
+    }
+}
+
+void run_mode(const std::vector<std::string> &argv, ModeContext &ctx)
 {
     std::vector<std::string> argv_loc{argv};
     if (argv_loc.empty()) {
@@ -273,7 +1026,7 @@ void wl_gena::main(const std::vector<std::string> &argv)
     if (mode_str == all_modes.back()) {
         auto json_mode_args_op = parse_json_mode_args(argv_loc);
         if (json_mode_args_op) {
-            process_json_mode(json_mode_args_op.value());
+            process_json_mode(json_mode_args_op.value(), ctx);
             return;
         }
 
@@ -286,7 +1039,7 @@ void wl_gena::main(const std::vector<std::string> &argv)
     if (mode_str == all_modes.back()) {
         auto header_mode_args_op = parse_header_mode_args(argv_loc);
         if (header_mode_args_op) {
-            process_header_mode(header_mode_args_op.value());
+            process_header_mode(header_mode_args_op.value(), ctx);
             return;
         }
         std::string header_mode_message =
@@ -294,9 +1047,79 @@ void wl_gena::main(const std::vector<std::string> &argv)
         throw std::runtime_error{std::move(header_mode_message)};
     }
 
+    all_modes.push_back("batch");
+    if (mode_str == all_modes.back()) {
+        auto batch_mode_args_op = parse_batch_mode_args(argv_loc);
+        if (batch_mode_args_op) {
+            process_batch_mode(batch_mode_args_op.value(), ctx);
+            return;
+        }
+        std::string batch_mode_message =
+            std::format("BATCH Mode: [{}]", batch_mode_args_op.error());
+        throw std::runtime_error{std::move(batch_mode_message)};
+    }
+
+    all_modes.push_back("server");
+    if (mode_str == all_modes.back()) {
+        auto server_mode_args_op = parse_server_mode_args(argv_loc);
+        if (server_mode_args_op) {
+            process_server_mode(server_mode_args_op.value());
+            return;
+        }
+        std::string server_mode_message =
+            std::format("SERVER Mode: [{}]", server_mode_args_op.error());
+        throw std::runtime_error{std::move(server_mode_message)};
+    }
+
+    all_modes.push_back("client");
+    if (mode_str == all_modes.back()) {
+        auto client_mode_args_op = parse_client_mode_args(argv_loc);
+        if (client_mode_args_op) {
+            process_client_mode(client_mode_args_op.value());
+            return;
+        }
+        std::string client_mode_message =
+            std::format("CLIENT Mode: [{}]", client_mode_args_op.error());
+        throw std::runtime_error{std::move(client_mode_message)};
+    }
+
     std::string msg = std::format(
         "Unknown mode [{}]: available modes {}",
         mode_str,
         FormatVectorWrap{all_modes});
     throw std::runtime_error{std::move(msg)};
 }
+
+/*
+ * Lets existing build rules use a running server without changes. If
+ * none answers on the socket the invocation runs in-process as usual
+ */
+constexpr const char *server_socket_env = "WL_GENA_SERVER_SOCKET";
+
+/*
+ * A server parses with the backend its own environment picked, so a
+ * client that picks one runs in-process to get what it asked for
+ */
+constexpr const char *parser_backend_env = "WL_GENA_PARSER";
+
+bool is_forwardable(const std::vector<std::string> &argv)
+{
+    return !argv.empty() && is_forwardable_mode(argv.front()) &&
+           !uses_stdin(argv) && std::getenv(parser_backend_env) == nullptr;
+}
+
+} // namespace
+
+void wl_gena::main(const std::vector<std::string> &argv)
+{
+    const char *server_socket = std::getenv(server_socket_env);
+    bool forward = server_socket != nullptr && *server_socket != '\0' &&
+                   is_forwardable(argv);
+    if (forward && wl_gena::forward_to_server(server_socket, argv)) {
+        return;
+    }
+
+    ModeContext ctx{std::cout, std::cerr};
+    ctx.out_fd = STDOUT_FILENO;
+    run_mode(argv, ctx);
+}
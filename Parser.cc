@@ -1,36 +1,104 @@
+#include <algorithm>
+#include <array>
 #include <charconv>
 #include <expected>
 #include <format>
+#include <functional>
+#include <memory_resource>
 #include <optional>
-#include <stack>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <system_error>
-#include <unordered_map>
 #include <utility>
-#include <variant>
 #include <vector>
 
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+
+#include <malloc.h>
+#include <unistd.h>
 
 #include <expat.h>
 #include <expat_external.h>
 
+#include "AllocStats.hh"
 #include "Parser.hh"
 #include "Types.hh"
+#include "XmlTokenizer.hh"
 
 namespace wl_gena {
 
 namespace {
 
+/*
+ * expat allocates with malloc, not operator new: these report its
+ * buffers to the same hooks as the operator new replacement, so they
+ * count towards the phase that parses
+ */
+void *expat_malloc(size_t size)
+{
+    void *p = std::malloc(size);
+    if (p != nullptr) {
+        alloc_hooks::allocated(malloc_usable_size(p), size);
+    }
+    return p;
+}
+
+void expat_free(void *p)
+{
+    if (p != nullptr) {
+        alloc_hooks::freed(malloc_usable_size(p));
+        std::free(p);
+    }
+}
+
+void *expat_realloc(void *p, size_t size)
+{
+    if (size == 0) {
+        expat_free(p);
+        return nullptr;
+    }
+    size_t old_usable_size = p != nullptr ? malloc_usable_size(p) : 0;
+    void *resized = std::realloc(p, size);
+    if (resized != nullptr) {
+        if (p != nullptr) {
+            alloc_hooks::freed(old_usable_size);
+        }
+        alloc_hooks::allocated(malloc_usable_size(resized), size);
+    }
+    return resized;
+}
+
+constexpr XML_Memory_Handling_Suite counted_expat_memory{
+    expat_malloc, expat_realloc, expat_free};
+
+/*
+ * Hands out [xml] a buffer at a time, for expat, which copies whatever
+ * it is given into buffers of its own anyway
+ */
+ProtocolReader view_reader(std::string_view xml)
+{
+    return [xml](std::span<char> buffer) mutable -> size_t {
+        size_t size = std::min(buffer.size(), xml.size());
+        std::copy_n(xml.data(), size, buffer.data());
+        xml.remove_prefix(size);
+        return size;
+    };
+}
+
 struct Parser
 {
     Parser()
     {
         handle = []() {
-            auto parser = XML_ParserCreate(nullptr);
+            auto parser = alloc_accounting_enabled()
+                              ? XML_ParserCreate_MM(
+                                    nullptr, &counted_expat_memory, nullptr)
+                              : XML_ParserCreate(nullptr);
             if (!parser) {
                 throw std::runtime_error("Cannot init parser");
             }
@@ -38,42 +106,111 @@ struct Parser
         }();
     }
 
-    struct Attribute
-    {
-        std::string_view key;
-        std::string_view value;
-    };
+    using Attribute = XmlAttribute;
 
+    /*
+     * A null data callback leaves character data unhandled, so expat
+     * does not have to report it at all
+     *
+     * Tags come with their position in the document, see XmlSpan
+     */
     template <typename UserDataT>
     struct Callbacks
     {
         UserDataT &user_data;
         void (UserDataT::*start)(
-            std::string_view el, const std::vector<Attribute> &attrs);
+            std::string_view el, std::span<const Attribute> attrs, XmlSpan tag);
         void (UserDataT::*data)(std::string_view data);
-        void (UserDataT::*end)(std::string_view el);
+        void (UserDataT::*end)(std::string_view el, XmlSpan tag);
     };
 
+    /*
+     * Amount of XML handed to expat at once
+     */
+    static constexpr size_t chunk_size = 64 * 1024;
+
+    template <typename UserDataT>
+    void parse(
+        Callbacks<UserDataT> &callbacks,
+        std::string_view xml,
+        std::pmr::memory_resource *resource)
+    {
+        parse(callbacks, view_reader(xml), resource);
+    }
+
+    template <typename UserDataT>
+    void parse(
+        Callbacks<UserDataT> &callbacks,
+        const ProtocolReader &reader,
+        std::pmr::memory_resource *resource)
+    {
+        Context<UserDataT> context{
+            callbacks, std::pmr::vector<Attribute>{resource}, handle};
+        begin(context);
+
+        while (true) {
+            void *buffer = XML_GetBuffer(handle, chunk_size);
+            if (buffer == nullptr) {
+                throw std::runtime_error("XML_Parser: out of memory");
+            }
+
+            std::span<char> chunk{static_cast<char *>(buffer), chunk_size};
+            size_t got = reader(chunk);
+            bool is_final = got == 0;
+            check_status(XML_ParseBuffer(handle, got, is_final));
+            if (is_final) {
+                return;
+            }
+        }
+    }
+
+    ~Parser()
+    {
+        if (handle) {
+            XML_ParserFree(handle);
+        }
+    }
+
+    Parser(Parser &&) = delete;
+    Parser &operator=(Parser &&) = delete;
+    Parser(const Parser &) = delete;
+    Parser &operator=(const Parser &) = delete;
+
+  private:
     template <typename UserDataT>
-    void parse(Callbacks<UserDataT> &callbacks, std::string_view data)
+    struct Context
     {
-        struct Context
+        Callbacks<UserDataT> &cb;
+        std::pmr::vector<Attribute> attrs;
+        XML_Parser handle;
+
+        XmlSpan current_tag() const
         {
-            Callbacks<UserDataT> &cb;
-            std::vector<Attribute> attrs;
-        } context{callbacks, {}};
+            return XmlSpan{
+                static_cast<size_t>(XML_GetCurrentByteIndex(handle)),
+                static_cast<size_t>(XML_GetCurrentByteCount(handle))};
+        }
+    };
+
+    template <typename UserDataT>
+    void begin(Context<UserDataT> &context)
+    {
+        using ContextT = Context<UserDataT>;
 
         XML_ParserReset(handle, nullptr);
         XML_SetUserData(handle, &context);
-        XML_SetCharacterDataHandler(
-            handle, [](void *userData, const XML_Char *s, int len) {
-                Context &ctx = *reinterpret_cast<Context *>(userData);
-                (ctx.cb.user_data.*ctx.cb.data)(std::string_view{s, s + len});
-            });
+        if (context.cb.data != nullptr) {
+            XML_SetCharacterDataHandler(
+                handle, [](void *userData, const XML_Char *s, int len) {
+                    ContextT &ctx = *reinterpret_cast<ContextT *>(userData);
+                    (ctx.cb.user_data.*ctx.cb.data)(
+                        std::string_view{s, s + len});
+                });
+        }
         XML_SetElementHandler(
             handle,
             [](void *userData, const XML_Char *name, const XML_Char **atts_p) {
-                Context &ctx = *reinterpret_cast<Context *>(userData);
+                ContextT &ctx = *reinterpret_cast<ContextT *>(userData);
 
                 auto &attrs = ctx.attrs;
                 ctx.attrs.clear();
@@ -86,77 +223,230 @@ struct Parser
                     attrs.emplace_back(key, val);
                 }
 
-                (ctx.cb.user_data.*ctx.cb.start)(std::string_view{name}, attrs);
+                (ctx.cb.user_data.*ctx.cb.start)(
+                    std::string_view{name}, attrs, ctx.current_tag());
             },
             [](void *userData, const XML_Char *name) {
-                Context &ctx = *reinterpret_cast<Context *>(userData);
-                (ctx.cb.user_data.*ctx.cb.end)(std::string_view{name});
+                ContextT &ctx = *reinterpret_cast<ContextT *>(userData);
+                (ctx.cb.user_data.*ctx.cb.end)(
+                    std::string_view{name}, ctx.current_tag());
             });
+    }
 
-        XML_Status status = XML_Parse(handle, data.data(), data.size(), true);
+    void check_status(XML_Status status)
+    {
         if (status != XML_STATUS_OK) {
             XML_Error error = XML_GetErrorCode(handle);
-            std::string message =
-                std::format("XML_Parser error: ({})", XML_ErrorString(error));
+            std::string message = std::format(
+                "XML_Parser error: ({}) at line {}",
+                XML_ErrorString(error),
+                XML_GetCurrentLineNumber(handle));
             throw std::runtime_error(std::move(message));
         }
     }
 
-    ~Parser()
+    XML_Parser handle = nullptr;
+};
+
+/*
+ * Same interface as Parser, over the built-in XmlTokenizer
+ */
+struct TokenizerParser
+{
+    explicit TokenizerParser(ScanIsa isa) : _isa{isa}
     {
-        if (handle) {
-            XML_ParserFree(handle);
+    }
+
+    /*
+     * Tokenizes [xml] where it is, a mapped file is not copied at all
+     */
+    template <typename UserDataT>
+    void parse(
+        Parser::Callbacks<UserDataT> &callbacks,
+        std::string_view xml,
+        std::pmr::memory_resource *resource)
+    {
+        XmlTokenizer tokenizer{handlers(callbacks), _isa, resource};
+        tokenizer.parse(xml, true);
+    }
+
+    template <typename UserDataT>
+    void parse(
+        Parser::Callbacks<UserDataT> &callbacks,
+        const ProtocolReader &reader,
+        std::pmr::memory_resource *resource)
+    {
+        XmlTokenizer tokenizer{handlers(callbacks), _isa, resource};
+
+        while (true) {
+            std::span<char> chunk = tokenizer.get_buffer(Parser::chunk_size);
+            size_t got = reader(chunk);
+            bool is_final = got == 0;
+            tokenizer.parse_buffer(got, is_final);
+            if (is_final) {
+                return;
+            }
         }
     }
 
-    Parser(Parser &&) = delete;
-    Parser &operator=(Parser &&) = delete;
-    Parser(const Parser &) = delete;
-    Parser &operator=(const Parser &) = delete;
+  private:
+    template <typename UserDataT>
+    static XmlTokenizer::Handlers
+        handlers(Parser::Callbacks<UserDataT> &callbacks)
+    {
+        using CallbacksT = Parser::Callbacks<UserDataT>;
+
+        XmlTokenizer::Handlers o{};
+        o.user_data = &callbacks;
+        o.start = [](void *user_data,
+                     std::string_view name,
+                     std::span<const XmlAttribute> attrs,
+                     XmlSpan tag) {
+            CallbacksT &cb = *static_cast<CallbacksT *>(user_data);
+            (cb.user_data.*cb.start)(name, attrs, tag);
+        };
+        if (callbacks.data != nullptr) {
+            o.data = [](void *user_data, std::string_view data) {
+                CallbacksT &cb = *static_cast<CallbacksT *>(user_data);
+                (cb.user_data.*cb.data)(data);
+            };
+        }
+        o.end = [](void *user_data, std::string_view name, XmlSpan tag) {
+            CallbacksT &cb = *static_cast<CallbacksT *>(user_data);
+            (cb.user_data.*cb.end)(name, tag);
+        };
+        return o;
+    }
+
+    ScanIsa _isa;
+};
+
+/*
+ * Interns strings into the arena of the protocol being built
+ *
+ * Open addressing over string ids, so interning allocates only when the
+ * table grows; the table itself is dropped once parsing is done
+ */
+struct StringInterner
+{
+    StringInterner(
+        types::StringArena &arena, std::pmr::memory_resource *resource)
+        : _arena{arena}, _slots{resource}
+    {
+    }
+
+    types::StringId intern(std::string_view str)
+    {
+        if ((_used + 1) * 4 > _slots.size() * 3) {
+            grow();
+        }
+
+        size_t mask = _slots.size() - 1;
+        for (size_t slot = hash(str) & mask;; slot = (slot + 1) & mask) {
+            types::StringId &id = _slots[slot];
+            if (id == types::no_string) {
+                id = _arena.add(str);
+                ++_used;
+                return id;
+            }
+            if (_arena.get(id) == str) {
+                return id;
+            }
+        }
+    }
 
   private:
-    XML_Parser handle = nullptr;
+    static size_t hash(std::string_view str)
+    {
+        return std::hash<std::string_view>{}(str);
+    }
+
+    void grow()
+    {
+        std::pmr::vector<types::StringId> old_slots = std::move(_slots);
+        size_t slot_count = std::max<size_t>(min_slots, old_slots.size() * 2);
+        _slots.assign(slot_count, types::no_string);
+
+        size_t mask = _slots.size() - 1;
+        for (types::StringId id : old_slots) {
+            if (id == types::no_string) {
+                continue;
+            }
+            size_t slot = hash(_arena.get(id)) & mask;
+            while (_slots[slot] != types::no_string) {
+                slot = (slot + 1) & mask;
+            }
+            _slots[slot] = id;
+        }
+    }
+
+    static constexpr size_t min_slots = 256;
+
+    types::StringArena &_arena;
+    std::pmr::vector<types::StringId> _slots;
+    size_t _used = 0;
 };
 
+/*
+ * Builds the protocol tables directly while expat walks the document
+ *
+ * Elements never interleave with their siblings, so the children of the
+ * innermost open element are always appended at the end of their table
+ * and a parent only has to count them
+ *
+ * Without [with_docs] summaries, descriptions and the copyright are
+ * skipped; with it they go to the doc table, descriptions as the byte
+ * range between their tags
+ */
 struct ProtoParser
 {
-    // clang-format off
-    using ParseTarget = std::variant<
-        types::Arg,
-        types::Enum,
-        types::Enum::Entry,
-        types::Message,
-        types::Request,
-        types::Event,
-        types::Interface,
-        types::Protocol
-    >;
-    // clang-format on
-
-    using AttributeMap = std::unordered_map<std::string, std::string>;
-
-    auto make_attr_map(const std::vector<Parser::Attribute> &attrs)
-        -> AttributeMap
-    {
-        AttributeMap out;
-
-        for (auto &attr : attrs) {
-            std::string key{attr.key};
-            std::string val{attr.value};
-            if (out.contains(key)) {
-                std::string message = std::format(
-                    "Duplicate interface attribute [{}=[{}]]", key, val);
-                throw std::runtime_error(std::move(message));
+    ProtoParser(std::pmr::memory_resource *resource, bool keep_docs)
+        : proto{resource}, strings{proto.strings, resource}, scopes{resource},
+          with_docs{keep_docs}
+    {
+    }
+
+    /*
+     * Attributes of the current start tag
+     *
+     * Values point into the parser buffer and stay valid only while the
+     * start handler runs. Tags carry a handful of attributes (expat
+     * already rejects duplicates), so a linear scan beats any hashing
+     */
+    struct AttributeMap
+    {
+        std::span<const Parser::Attribute> attrs;
+
+        std::optional<std::string_view> find(std::string_view key) const
+        {
+            for (const Parser::Attribute &attr : attrs) {
+                if (attr.key == key) {
+                    return attr.value;
+                }
             }
-            out[std::move(key)] = std::move(val);
+            return std::nullopt;
         }
 
-        return out;
+        bool contains(std::string_view key) const
+        {
+            return find(key).has_value();
+        }
+
+        std::string_view at(std::string_view key) const
+        {
+            auto value = find(key);
+            if (!value) {
+                std::string message =
+                    std::format("Missing attribute [{}]", key);
+                throw std::runtime_error(std::move(message));
+            }
+            return value.value();
+        }
     };
 
     template <typename T>
     std::expected<T, std::string>
-        parse_num(const std::string &str, int base = 10)
+        parse_num(std::string_view str, int base = 10)
     {
         T out = 0;
         auto status =
@@ -181,36 +471,30 @@ struct ProtoParser
 
     auto parse_protocol(const AttributeMap &attrs) -> void
     {
-        types::Protocol new_proto;
-        std::string name = attrs.at("name");
-        new_proto.name = name;
-        targets.emplace(std::move(new_proto));
-    }
-
-    auto fin_protocol() -> void
-    {
-        if (output_proto.has_value()) {
+        if (has_protocol) {
             throw std::runtime_error(
                 "Multiple protocol parsing is not supported");
         }
+        if (!scopes.empty()) {
+            std::string message = std::format(
+                "Attempt to add protocol field to {}", scope_name());
+            throw std::runtime_error(std::move(message));
+        }
 
-        ParseTarget &active_target = targets.top();
-        types::Protocol active_proto = std::get<types::Protocol>(active_target);
-        targets.pop();
-
-        output_proto = std::move(active_proto);
+        has_protocol = true;
+        proto.name_id = strings.intern(attrs.at("name"));
+        scopes.push_back(Scope{Tag::protocol, 0});
     }
 
     auto parse_interface(const AttributeMap &attrs) -> void
     {
-        types::Interface new_interface{};
+        require_scope(Tag::protocol, "interface");
 
-        std::string name = attrs.at("name");
-        new_interface.name = std::move(name);
-        std::string vesion_string = attrs.at("version");
+        std::string_view name = attrs.at("name");
+        std::string_view vesion_string = attrs.at("version");
 
         auto version_op =
-            parse_num<decltype(types::Interface::version)>(vesion_string);
+            parse_num<decltype(types::InterfaceRecord::version)>(vesion_string);
 
         std::optional<std::string> error_string{};
         if (!version_op.has_value()) {
@@ -223,37 +507,47 @@ struct ProtoParser
                 "status "
                 "[{}]",
                 vesion_string,
-                new_interface.name,
+                name,
                 error_string.value());
             throw std::runtime_error(std::move(message));
         }
 
+        types::InterfaceRecord new_interface{};
+        new_interface.name = strings.intern(name);
         new_interface.version = version_op.value();
+        new_interface.requests.first = proto.request_records.size();
+        new_interface.events.first = proto.event_records.size();
+        new_interface.enums.first = proto.enum_records.size();
 
-        targets.emplace(std::move(new_interface));
+        open(Tag::interface, proto.interface_records, new_interface);
     }
 
-    auto fin_interface() -> void
+    auto parse_since(const AttributeMap &attrs) -> std::optional<uint32_t>
     {
-        ParseTarget &active_interface_target = targets.top();
-        types::Interface active_interface =
-            std::get<types::Interface>(active_interface_target);
-        targets.pop();
-
-        auto &active_proto_target = targets.top();
-        types::Protocol &active_protocol =
-            std::get<types::Protocol>(active_proto_target);
+        std::optional<std::string_view> since_str = attrs.find("since");
+        if (!since_str) {
+            return std::nullopt;
+        }
 
-        active_protocol.interfaces.emplace_back(std::move(active_interface));
+        auto since_parsed = parse_num<uint32_t>(since_str.value());
+        if (!since_parsed) {
+            std::string message = std::format(
+                "Bad since [{}]: {}", since_str.value(), since_parsed.error());
+            throw std::runtime_error{std::move(message)};
+        }
+        return since_parsed.value();
     }
 
     auto parse_request(const AttributeMap &attrs) -> void
     {
-        types::Request new_request;
-        std::string request_name = attrs.at("name");
+        types::InterfaceRecord &interface =
+            proto.interface_records[require_scope(Tag::interface, "request")];
+
+        types::MessageRecord new_request{};
+        std::string_view request_name = attrs.at("name");
 
         if (attrs.contains("type")) {
-            std::string type_string = attrs.at("type");
+            std::string_view type_string = attrs.at("type");
             if (type_string == "destructor") {
                 new_request.destructor = true;
             } else {
@@ -263,123 +557,48 @@ struct ProtoParser
             }
         }
 
-        std::optional<uint32_t> since;
-        if (attrs.contains("since")) {
-            std::string since_str = attrs.at("since");
-            auto since_parsed = parse_num<uint32_t>(since_str);
-            if (!since_parsed) {
-                std::string message = std::format(
-                    "Bad since [{}]: {}", since_str, since_parsed.error());
-                throw std::runtime_error{std::move(message)};
-            }
-            since = since_parsed.value();
-        }
+        new_request.name = strings.intern(request_name);
+        new_request.since = parse_since(attrs);
+        new_request.args.first = proto.arg_records.size();
 
-        new_request.name = std::move(request_name);
-        new_request.since = since;
-        targets.emplace(std::move(new_request));
-    }
-
-    struct FinRequestVisitor
-    {
-        explicit FinRequestVisitor(types::Request &req) : _req(req)
-        {
-        }
-
-        template <typename T>
-        void operator()(T &t)
-        {
-            std::string message = std::format(
-                "Attempt to add request field to {}", target_name(t));
-            throw std::runtime_error(std::move(message));
-        }
-
-        void operator()(types::Interface &interface)
-        {
-            interface.requests.emplace_back(std::move(_req));
-        }
-
-      private:
-        types::Request &_req;
-    };
-
-    auto fin_request() -> void
-    {
-        ParseTarget &active_target = targets.top();
-        types::Request request =
-            std::move(std::get<types::Request>(active_target));
-        targets.pop();
-
-        ParseTarget &request_parent_target = targets.top();
-        std::visit(FinRequestVisitor{request}, request_parent_target);
+        interface.requests.count++;
+        open(Tag::request, proto.request_records, new_request);
     }
 
     auto parse_event(const AttributeMap &attrs) -> void
     {
-        types::Event new_event;
-        std::string event_name = attrs.at("name");
+        types::InterfaceRecord &interface =
+            proto.interface_records[require_scope(Tag::interface, "event")];
 
-        std::optional<uint32_t> since;
-        if (attrs.contains("since")) {
-            std::string since_str = attrs.at("since");
-            auto since_parsed = parse_num<uint32_t>(since_str);
-            if (!since_parsed) {
-                std::string message = std::format(
-                    "Bad since [{}]: {}", since_str, since_parsed.error());
-                throw std::runtime_error{std::move(message)};
-            }
-            since = since_parsed.value();
-        }
+        types::MessageRecord new_event{};
+        new_event.name = strings.intern(attrs.at("name"));
+        new_event.since = parse_since(attrs);
+        new_event.args.first = proto.arg_records.size();
 
-        new_event.name = std::move(event_name);
-        new_event.since = since;
-        targets.emplace(std::move(new_event));
-    }
-
-    struct FinEventVisitor
-    {
-        explicit FinEventVisitor(types::Event &ev) : _ev(ev)
-        {
-        }
-
-        template <typename T>
-        void operator()(T &t)
-        {
-            std::string message =
-                std::format("Attempt to add event field to {}", target_name(t));
-            throw std::runtime_error(std::move(message));
-        }
-
-        void operator()(types::Interface &interface)
-        {
-            interface.events.emplace_back(std::move(_ev));
-        }
-
-      private:
-        types::Event &_ev;
-    };
-
-    auto fin_event() -> void
-    {
-        ParseTarget &active_target = targets.top();
-        types::Event event = std::move(std::get<types::Event>(active_target));
-        targets.pop();
-
-        ParseTarget &request_parent_target = targets.top();
-        std::visit(FinEventVisitor{event}, request_parent_target);
+        interface.events.count++;
+        open(Tag::event, proto.event_records, new_event);
     }
 
     auto parse_arg_type(
-        const std::string &arg_type_string, const AttributeMap &attrs)
-        -> std::expected<types::ArgType, std::string>
+        std::string_view arg_type_string, const AttributeMap &attrs)
+        -> std::expected<types::ArgRecord, std::string>
     {
-
-        const auto interface_name = [&attrs]() -> std::optional<std::string> {
-            if (attrs.contains("interface")) {
-                return attrs.at("interface");
+        using Kind = types::ArgKind;
+
+        auto make = [](Kind kind) {
+            types::ArgRecord o{};
+            o.kind = kind;
+            return o;
+        };
+
+        auto make_with_interface = [this, &attrs, &make](Kind kind) {
+            types::ArgRecord o = make(kind);
+            auto interface_attr = attrs.find("interface");
+            if (interface_attr) {
+                o.interface_name = strings.intern(interface_attr.value());
             }
-            return std::nullopt;
-        }();
+            return o;
+        };
 
         /*
          * * * `i`: int
@@ -394,13 +613,13 @@ struct ProtoParser
          */
 
         if (arg_type_string == "int") {
-            return types::ArgTypes::Int{};
+            return make(Kind::Int);
         }
 
         if (arg_type_string == "uint") {
 
             if (!attrs.contains("enum")) {
-                return types::ArgTypes::UInt{};
+                return make(Kind::UInt);
             }
 
             /*
@@ -408,92 +627,43 @@ struct ProtoParser
              * or
              * "<enum_name>"
              */
-            std::string enum_location = attrs.at("enum");
+            std::string_view enum_location = attrs.at("enum");
 
-            bool has_interface_name =
-                enum_location.find(".") != enum_location.npos;
+            types::ArgRecord out = make(Kind::UIntEnum);
 
-            if (!has_interface_name) {
-                types::ArgTypes::UIntEnum out{};
-                out.name = std::move(enum_location);
+            size_t dot = enum_location.find('.');
+            if (dot == enum_location.npos) {
+                out.enum_name = strings.intern(enum_location);
                 return out;
             }
 
-            auto split_dot = [](const std::string &s)
-                -> std::
-                    expected<std::pair<std::string, std::string>, std::string> {
-                        std::string first;
-                        bool found_sep = false;
-                        std::string second;
-
-                        for (auto c : s) {
-                            if (c == '.') {
-                                found_sep = true;
-                                continue;
-                            }
-
-                            if (!found_sep) {
-                                first += c;
-                                continue;
-                            }
-
-                            second += c;
-                        }
-
-                        if (!found_sep) {
-                            std::string message = std::format(
-                                "Cannot split string [{}] by dot", s);
-                            return std::unexpected(std::move(message));
-                        }
-
-                        return std::make_pair(
-                            std::move(first), std::move(second));
-                    };
-
-            auto sep_op = split_dot(enum_location);
-            if (!sep_op.has_value()) {
-                return std::unexpected(sep_op.error());
-            }
-            auto &sep = sep_op.value();
-
-            types::ArgTypes::UIntEnum out{};
-            out.interface_name = std::move(sep.first);
-            out.name = std::move(sep.second);
+            out.interface_name = strings.intern(enum_location.substr(0, dot));
+            out.enum_name = strings.intern(enum_location.substr(dot + 1));
             return out;
         }
 
         if (arg_type_string == "fixed") {
-            return types::ArgTypes::Fixed{};
+            return make(Kind::Fixed);
         }
 
         if (arg_type_string == "string" || arg_type_string == "object") {
 
-            types::ArgType out_t;
-            types::ArgType null_out_t;
+            types::ArgRecord out_t;
+            types::ArgRecord null_out_t;
 
             if (arg_type_string == "string") {
-                out_t = types::ArgTypes::String{};
-                null_out_t = types::ArgTypes::NullString{};
-            } else if (arg_type_string == "object") {
-                types::ArgTypes::Object obj{};
-                obj.interface_name = interface_name;
-                out_t = std::move(obj);
-                types::ArgTypes::NullObject null_obj{};
-                null_obj.interface_name = interface_name;
-                null_out_t = std::move(null_obj);
+                out_t = make(Kind::String);
+                null_out_t = make(Kind::NullString);
             } else {
-                std::string message = std::format(
-                    "Unexpected arg_type_string value change from"
-                    " \"string\" or \"object\" to [{}]",
-                    arg_type_string);
-                return std::unexpected(std::move(message));
+                out_t = make_with_interface(Kind::Object);
+                null_out_t = make_with_interface(Kind::NullObject);
             }
 
             if (!attrs.contains("allow-null")) {
                 return out_t;
             }
 
-            std::string allow_null_value = attrs.at("allow-null");
+            std::string_view allow_null_value = attrs.at("allow-null");
             if (allow_null_value != "true") {
                 std::string message = std::format(
                     "for tag <arg> \"allow-null\" attribute value must be set "
@@ -506,117 +676,81 @@ struct ProtoParser
         }
 
         if (arg_type_string == "new_id") {
-            types::ArgTypes::NewID new_id{};
-            new_id.interface_name = interface_name;
-            return new_id;
+            return make_with_interface(Kind::NewID);
         }
 
         if (arg_type_string == "array") {
-            return types::ArgTypes::Array{};
+            return make(Kind::Array);
         }
 
         if (arg_type_string == "fd") {
-            return types::ArgTypes::FD{};
+            return make(Kind::FD);
         }
 
         return std::unexpected(
             std::format("[{}] is unknown type", arg_type_string));
     }
 
-    auto parse_arg(const AttributeMap &attrs)
+    void parse_arg(const AttributeMap &attrs)
     {
-        types::Arg arg;
-        std::string name = attrs.at("name");
-        arg.name = std::move(name);
+        types::MessageRecord *message = nullptr;
+        if (!scopes.empty() && scopes.back().tag == Tag::request) {
+            message = &proto.request_records[scopes.back().index];
+        } else if (!scopes.empty() && scopes.back().tag == Tag::event) {
+            message = &proto.event_records[scopes.back().index];
+        } else {
+            std::string message_string = std::format(
+                "Attempt to add argument field to {}", scope_name());
+            throw std::runtime_error(std::move(message_string));
+        }
 
-        std::string type_string = attrs.at("type");
+        std::string_view type_string = attrs.at("type");
         auto arg_type = parse_arg_type(type_string, attrs);
         if (!arg_type) {
-            std::string message = std::format(
+            std::string message_string = std::format(
                 "Parsing [{}] type failure [{}]",
                 type_string,
                 arg_type.error());
-            throw std::runtime_error(std::move(message));
+            throw std::runtime_error(std::move(message_string));
         }
-        arg.type = std::move(arg_type.value());
 
-        targets.emplace(std::move(arg));
-    }
-
-    struct FinArgVisitor
-    {
-        explicit FinArgVisitor(types::Arg &arg) : _arg{arg}
-        {
-        }
+        types::ArgRecord arg = arg_type.value();
+        arg.name = strings.intern(attrs.at("name"));
+        add_summary(arg.doc, attrs);
 
-        template <typename T>
-        void operator()(T &t)
-        {
-            std::string message = std::format(
-                "Attempt to add argument field to {}", target_name(t));
-            throw std::runtime_error(std::move(message));
-        }
-
-        void operator()(types::Request &req)
-        {
-            req.args.emplace_back(std::move(_arg));
-        }
-
-        void operator()(types::Event &event)
-        {
-            event.args.emplace_back(std::move(_arg));
-        }
-
-      private:
-        types::Arg &_arg;
-    };
-
-    auto fin_arg()
-    {
-        ParseTarget &active_target = targets.top();
-        types::Arg arg_target = std::move(std::get<types::Arg>(active_target));
-        targets.pop();
-
-        ParseTarget &request_parent_target = targets.top();
-        std::visit(FinArgVisitor{arg_target}, request_parent_target);
+        message->args.count++;
+        open(Tag::arg, proto.arg_records, arg);
     }
 
-    auto parse_enum(const AttributeMap &attrs)
+    void parse_enum(const AttributeMap &attrs)
     {
-        types::Enum new_enum{};
         if (!attrs.contains("name")) {
 
             std::string message = "Found unnamed enum tag";
-            if (targets.size() != 0) {
-                auto &parent = targets.top();
-                message = std::format("{} in {}", message, target_name(parent));
+            if (!scopes.empty()) {
+                message = std::format("{} in {}", message, scope_name());
             }
             throw std::runtime_error{std::move(message)};
         }
-        new_enum.name = attrs.at("name");
-        targets.emplace(std::move(new_enum));
-    }
 
-    void fin_enum()
-    {
-        ParseTarget &active_target = targets.top();
-        types::Enum enum_target =
-            std::move(std::get<types::Enum>(active_target));
-        targets.pop();
+        types::InterfaceRecord &interface =
+            proto.interface_records[require_scope(Tag::interface, "enum")];
 
-        ParseTarget &interface_parent_target = targets.top();
-        types::Interface &interface =
-            std::get<types::Interface>(interface_parent_target);
+        types::EnumRecord new_enum{};
+        new_enum.name = strings.intern(attrs.at("name"));
+        new_enum.entries.first = proto.entry_records.size();
 
-        interface.enums.emplace_back(std::move(enum_target));
+        interface.enums.count++;
+        open(Tag::enumeration, proto.enum_records, new_enum);
     }
 
-    auto parse_entry(const AttributeMap &attrs)
+    void parse_entry(const AttributeMap &attrs)
     {
-        types::Enum::Entry entry{};
+        types::EnumRecord &wl_enum =
+            proto.enum_records[require_scope(Tag::enumeration, "entry")];
 
-        std::string name = attrs.at("name");
-        std::string value_string = attrs.at("value");
+        std::string_view name = attrs.at("name");
+        std::string_view value_string = attrs.at("value");
 
         bool is_hex = true;
         is_hex = is_hex && value_string.size() > 2;
@@ -629,8 +763,8 @@ struct ProtoParser
             value_string = value_string.substr(2);
         }
 
-        auto value_op =
-            parse_num<decltype(types::Enum::Entry::value)>(value_string, base);
+        auto value_op = parse_num<decltype(types::EntryRecord::value)>(
+            value_string, base);
 
         std::optional<std::string> error_string{};
         if (!value_op.has_value()) {
@@ -648,224 +782,471 @@ struct ProtoParser
             throw std::runtime_error(std::move(message));
         }
 
-        entry.name = std::move(name);
+        types::EntryRecord entry{};
+        entry.name = strings.intern(name);
         entry.value = value_op.value();
         entry.is_hex = is_hex;
+        add_summary(entry.doc, attrs);
 
-        targets.emplace(std::move(entry));
+        wl_enum.entries.count++;
+        open(Tag::entry, proto.entry_records, entry);
     }
 
-    auto fin_entry()
+    void parse_description(const AttributeMap &attrs)
     {
-        ParseTarget &active_target = targets.top();
-        types::Enum::Entry entry =
-            std::move(std::get<types::Enum::Entry>(active_target));
-        targets.pop();
+        if (!with_docs) {
+            return;
+        }
 
-        ParseTarget &enum_target = targets.top();
-        types::Enum &wl_enum = std::get<types::Enum>(enum_target);
+        uint32_t &doc_id = scope_doc_id("description");
+        add_summary(doc_id, attrs);
+        if (doc_id == types::no_doc) {
+            doc_id = proto.doc_records.size();
+            proto.doc_records.emplace_back();
+        }
 
-        wl_enum.entries.emplace_back(std::move(entry));
+        text_first = current_tag.first + current_tag.size;
+        scopes.push_back(Scope{Tag::description, doc_id});
     }
 
-    // clang-format off
-    struct Tag {
-    struct Protocol {};
-    struct Interface {};
-    struct Request {};
-    struct Event {};
-    struct Arg {};
-    struct Enum {};
-    struct Entry {};
-    };
-    using KnownTag = std::variant<
-        Tag::Protocol,
-        Tag::Interface,
-        Tag::Request,
-        Tag::Event,
-        Tag::Arg,
-        Tag::Enum,
-        Tag::Entry
-    >;
-    // clang-format on
-
-    std::optional<KnownTag> parse_tag(std::string_view s)
-    {
-#define RETURN_IF_MATCH(LITERAL, TYPENAME)                                     \
-    if (LITERAL == s) {                                                        \
-        return TYPENAME{};                                                     \
-    }
-        RETURN_IF_MATCH("protocol", Tag::Protocol);
-        RETURN_IF_MATCH("interface", Tag::Interface);
-        RETURN_IF_MATCH("request", Tag::Request);
-        RETURN_IF_MATCH("event", Tag::Event);
-        RETURN_IF_MATCH("arg", Tag::Arg);
-        RETURN_IF_MATCH("enum", Tag::Enum);
-        RETURN_IF_MATCH("entry", Tag::Entry);
-#undef RETURN_IF_MATCH
-        return std::nullopt;
-    };
+    void parse_copyright(const AttributeMap &)
+    {
+        if (!with_docs) {
+            return;
+        }
+
+        require_scope(Tag::protocol, "copyright");
+        text_first = current_tag.first + current_tag.size;
+        scopes.push_back(Scope{Tag::copyright, 0});
+    }
 
-    struct StartTagVisitor
+    void close()
     {
-        ProtoParser &P;
-        AttributeMap attr_map;
+        scopes.pop_back();
+    }
 
-        void operator()(Tag::Protocol)
-        {
-            P.parse_protocol(attr_map);
+    void close_description()
+    {
+        if (!with_docs) {
+            return;
         }
 
-        void operator()(Tag::Interface)
-        {
-            P.parse_interface(attr_map);
-        }
+        proto.doc_records[scopes.back().index].description = text_range();
+        close();
+    }
 
-        void operator()(Tag::Request)
-        {
-            P.parse_request(attr_map);
+    void close_copyright()
+    {
+        if (!with_docs) {
+            return;
         }
 
-        void operator()(Tag::Event)
-        {
-            P.parse_event(attr_map);
-        }
+        proto.copyright = text_range();
+        close();
+    }
 
-        void operator()(Tag::Arg)
-        {
-            P.parse_arg(attr_map);
-        }
+    struct TagHandlers
+    {
+        std::string_view name;
+        void (ProtoParser::*start)(const AttributeMap &attrs);
+        void (ProtoParser::*end)();
+    };
 
-        void operator()(Tag::Enum)
-        {
-            P.parse_enum(attr_map);
+    /*
+     * Perfect hash over the known tag names: every known tag lands in its
+     * own slot, so a lookup costs one hash and one string comparison
+     */
+    static constexpr size_t tag_table_size = 32;
+    static constexpr size_t min_tag_size = 3;
+    static constexpr size_t max_tag_size = 11;
+
+    static constexpr size_t tag_hash(std::string_view tag)
+    {
+        size_t h = tag.size();
+        h += static_cast<unsigned char>(tag[1]);
+        h += static_cast<unsigned char>(tag[3 % tag.size()]);
+        return h % tag_table_size;
+    }
+
+    static const TagHandlers *find_tag(std::string_view tag)
+    {
+        using TagTable = std::array<TagHandlers, tag_table_size>;
+
+        static constexpr TagTable table = []() {
+            // clang-format off
+            constexpr TagHandlers known_tags[] = {
+                {"protocol", &ProtoParser::parse_protocol, &ProtoParser::close},
+                {"interface", &ProtoParser::parse_interface, &ProtoParser::close},
+                {"request", &ProtoParser::parse_request, &ProtoParser::close},
+                {"event", &ProtoParser::parse_event, &ProtoParser::close},
+                {"arg", &ProtoParser::parse_arg, &ProtoParser::close},
+                {"enum", &ProtoParser::parse_enum, &ProtoParser::close},
+                {"entry", &ProtoParser::parse_entry, &ProtoParser::close},
+                {"description", &ProtoParser::parse_description, &ProtoParser::close_description},
+                {"copyright", &ProtoParser::parse_copyright, &ProtoParser::close_copyright},
+            };
+            // clang-format on
+
+            TagTable o{};
+            for (const TagHandlers &known_tag : known_tags) {
+                TagHandlers &slot = o[tag_hash(known_tag.name)];
+                if (!slot.name.empty()) {
+                    throw "tag_hash is not perfect for the known tags";
+                }
+                slot = known_tag;
+            }
+            return o;
+        }();
+
+        if (tag.size() < min_tag_size || tag.size() > max_tag_size) {
+            return nullptr;
         }
 
-        void operator()(Tag::Entry)
-        {
-            P.parse_entry(attr_map);
+        const TagHandlers &slot = table[tag_hash(tag)];
+        if (slot.name != tag) {
+            return nullptr;
         }
-    };
+        return &slot;
+    }
 
-    void
-        start(std::string_view tag, const std::vector<Parser::Attribute> &attrs)
+    void start(
+        std::string_view tag,
+        std::span<const Parser::Attribute> attrs,
+        XmlSpan span)
     {
-        auto parsed_tag = parse_tag(tag);
-        if (!parsed_tag.has_value()) {
+        const TagHandlers *handlers = find_tag(tag);
+        if (handlers == nullptr) {
             return;
         }
 
-        StartTagVisitor vis{*this, make_attr_map(attrs)};
-        std::visit(vis, parsed_tag.value());
+        current_tag = span;
+        (this->*handlers->start)(AttributeMap{attrs});
     }
 
-    auto data([[maybe_unused]] std::string_view data) -> void
+    auto end(std::string_view tag, XmlSpan span) -> void
     {
+        const TagHandlers *handlers = find_tag(tag);
+        if (handlers == nullptr) {
+            return;
+        }
+
+        current_tag = span;
+        (this->*handlers->end)();
     }
 
-    struct EndTagVisitor
+    auto take() -> types::Protocol
     {
-        ProtoParser &parser;
-
-        void operator()(Tag::Protocol)
-        {
-            parser.fin_protocol();
+        if (!has_protocol) {
+            throw std::runtime_error("Document has no <protocol> element");
         }
+        return std::move(proto);
+    };
 
-        void operator()(Tag::Interface)
-        {
-            parser.fin_interface();
-        }
+  private:
+    enum class Tag
+    {
+        protocol,
+        interface,
+        request,
+        event,
+        arg,
+        enumeration,
+        entry,
+        description,
+        copyright,
+    };
 
-        void operator()(Tag::Request)
-        {
-            parser.fin_request();
+    struct Scope
+    {
+        Tag tag;
+        uint32_t index;
+    };
+
+    template <typename RecordT>
+    void open(Tag tag, std::pmr::vector<RecordT> &table, const RecordT &record)
+    {
+        scopes.push_back(Scope{tag, static_cast<uint32_t>(table.size())});
+        table.push_back(record);
+    }
+
+    /*
+     * Index of the innermost open element, which has to be a [parent]
+     */
+    uint32_t require_scope(Tag parent, std::string_view child_tag) const
+    {
+        if (scopes.empty() || scopes.back().tag != parent) {
+            std::string message = std::format(
+                "Attempt to add {} field to {}", child_tag, scope_name());
+            throw std::runtime_error(std::move(message));
         }
+        return scopes.back().index;
+    }
 
-        void operator()(Tag::Event)
-        {
-            parser.fin_event();
+    /*
+     * Doc table index of the innermost open element
+     */
+    uint32_t &scope_doc_id(std::string_view child_tag)
+    {
+        if (!scopes.empty()) {
+            const Scope &scope = scopes.back();
+            switch (scope.tag) {
+            case Tag::protocol:
+                return proto.doc_id;
+            case Tag::interface:
+                return proto.interface_records[scope.index].doc;
+            case Tag::request:
+                return proto.request_records[scope.index].doc;
+            case Tag::event:
+                return proto.event_records[scope.index].doc;
+            case Tag::arg:
+                return proto.arg_records[scope.index].doc;
+            case Tag::enumeration:
+                return proto.enum_records[scope.index].doc;
+            case Tag::entry:
+                return proto.entry_records[scope.index].doc;
+            case Tag::description:
+            case Tag::copyright:
+                break;
+            }
         }
 
-        void operator()(Tag::Arg)
-        {
-            parser.fin_arg();
+        std::string message = std::format(
+            "Attempt to add {} field to {}", child_tag, scope_name());
+        throw std::runtime_error(std::move(message));
+    }
+
+    void add_summary(uint32_t &doc_id, const AttributeMap &attrs)
+    {
+        if (!with_docs) {
+            return;
         }
 
-        void operator()(Tag::Enum)
-        {
-            parser.fin_enum();
+        std::optional<std::string_view> summary = attrs.find("summary");
+        if (!summary) {
+            return;
         }
 
-        void operator()(Tag::Entry)
-        {
-            parser.fin_entry();
+        if (doc_id == types::no_doc) {
+            doc_id = proto.doc_records.size();
+            proto.doc_records.emplace_back();
         }
-    };
+        proto.doc_records[doc_id].summary = strings.intern(summary.value());
+    }
 
-    auto end(std::string_view tag) -> void
+    /*
+     * Content between the start tag of the innermost text element and
+     * the current (end) tag
+     */
+    types::TextRange text_range() const
     {
-        auto parsed_tag = parse_tag(tag);
-        if (!parsed_tag.has_value()) {
-            return;
+        size_t last = std::max(text_first, current_tag.first);
+        return types::TextRange{
+            static_cast<uint32_t>(text_first),
+            static_cast<uint32_t>(last - text_first)};
+    }
+
+    std::string scope_name() const
+    {
+        if (scopes.empty()) {
+            return "document root";
+        }
+
+        const Scope &scope = scopes.back();
+        if (scope.tag == Tag::description || scope.tag == Tag::copyright) {
+            bool is_description = scope.tag == Tag::description;
+            return is_description ? "<description>" : "<copyright>";
         }
 
-        EndTagVisitor vis{*this};
-        std::visit(vis, parsed_tag.value());
+        auto [tag_name, name_id] = [this, &scope]() {
+            using Result = std::pair<std::string_view, types::StringId>;
+            switch (scope.tag) {
+            case Tag::protocol:
+                return Result{"protocol", proto.name_id};
+            case Tag::interface:
+                return Result{
+                    "interface", proto.interface_records[scope.index].name};
+            case Tag::request:
+                return Result{
+                    "request", proto.request_records[scope.index].name};
+            case Tag::event:
+                return Result{"event", proto.event_records[scope.index].name};
+            case Tag::arg:
+                return Result{"arg", proto.arg_records[scope.index].name};
+            case Tag::enumeration:
+                return Result{"enum", proto.enum_records[scope.index].name};
+            case Tag::entry:
+                return Result{"entry", proto.entry_records[scope.index].name};
+            case Tag::description:
+            case Tag::copyright:
+                break;
+            }
+            throw std::logic_error{"Unknown tag"};
+        }();
+
+        return std::format("<{} name=[{}] ...>", tag_name, proto.str(name_id));
     }
 
-    auto get() const -> const types::Protocol &
-    {
-        return output_proto.value();
-    };
+    types::Protocol proto;
+    StringInterner strings;
+    bool has_protocol = false;
+    std::pmr::vector<Scope> scopes;
 
-  private:
-    struct ParseTargetNameVisitor
-    {
-#define ADD_OVERLOAD(TYPENAME, TAG_NAME)                                       \
-    std::string operator()(const TYPENAME &tgt)                                \
-    {                                                                          \
-        return std::format(                                                    \
-            "ParseTarget::{} (<{} name=[{}] ...>)",                            \
-            #TYPENAME,                                                         \
-            #TAG_NAME,                                                         \
-            tgt.name);                                                         \
-    }
-
-        ADD_OVERLOAD(types::Arg, arg)
-        ADD_OVERLOAD(types::Enum, enum)
-        ADD_OVERLOAD(types::Enum::Entry, entry)
-        ADD_OVERLOAD(types::Message, event | request)
-        ADD_OVERLOAD(types::Request, request)
-        ADD_OVERLOAD(types::Event, event)
-        ADD_OVERLOAD(types::Interface, interface)
-        ADD_OVERLOAD(types::Protocol, protocol)
-#undef ADD_OVERLOAD
+    bool with_docs;
+    XmlSpan current_tag;
+    size_t text_first = 0;
+};
+
+/*
+ * Runs [input], a ProtocolReader or a whole document in memory, through
+ * the parser [backend] stands for
+ */
+template <typename InputT>
+types::Protocol parse_with(
+    const InputT &input,
+    std::pmr::memory_resource *resource,
+    ParserBackend backend,
+    bool with_docs)
+{
+    ProtoParser ctx{resource, with_docs};
+    Parser::Callbacks<ProtoParser> pcbs{
+        ctx, &ProtoParser::start, nullptr, &ProtoParser::end};
+
+    auto parse_tokenizer = [&](ScanIsa isa) {
+        TokenizerParser p{isa};
+        p.parse(pcbs, input, resource);
     };
 
-    static std::string target_name(const ParseTarget &tgt)
-    {
-        return std::visit(ParseTargetNameVisitor{}, tgt);
+    switch (backend) {
+    case ParserBackend::expat: {
+        Parser p;
+        p.parse(pcbs, input, resource);
+        break;
+    }
+    case ParserBackend::tokenizer_scalar:
+        parse_tokenizer(ScanIsa::scalar);
+        break;
+    case ParserBackend::tokenizer_sse2:
+        parse_tokenizer(ScanIsa::sse2);
+        break;
+    case ParserBackend::tokenizer_avx2:
+        parse_tokenizer(ScanIsa::avx2);
+        break;
     }
 
-    std::stack<ParseTarget> targets;
+    return ctx.take();
+}
 
-    std::optional<types::Protocol> output_proto;
-};
+constexpr const char *parser_backend_env = "WL_GENA_PARSER";
 
 } // namespace
 
-std::expected<types::Protocol, std::string>
-    parse_protocol(std::string_view protocol_xml)
+auto parser_backend_from_name(std::string_view name)
+    -> std::expected<ParserBackend, std::string>
 {
-    ProtoParser ctx;
-    Parser::Callbacks<ProtoParser> pcbs{
-        ctx, &ProtoParser::start, &ProtoParser::data, &ProtoParser::end};
+    if (name == "tokenizer") {
+        switch (best_scan_isa()) {
+        case ScanIsa::scalar:
+            return ParserBackend::tokenizer_scalar;
+        case ScanIsa::sse2:
+            return ParserBackend::tokenizer_sse2;
+        case ScanIsa::avx2:
+            return ParserBackend::tokenizer_avx2;
+        }
+    }
+
+    for (ParserBackend backend :
+         {ParserBackend::expat,
+          ParserBackend::tokenizer_scalar,
+          ParserBackend::tokenizer_sse2,
+          ParserBackend::tokenizer_avx2}) {
+        if (name == parser_backend_name(backend)) {
+            return backend;
+        }
+    }
+
+    return std::unexpected(std::format(
+        "Unknown parser [{}]: expected expat, tokenizer, tokenizer_scalar, "
+        "tokenizer_sse2 or tokenizer_avx2",
+        name));
+}
+
+std::string_view parser_backend_name(ParserBackend backend)
+{
+    switch (backend) {
+    case ParserBackend::expat:
+        return "expat";
+    case ParserBackend::tokenizer_scalar:
+        return "tokenizer_scalar";
+    case ParserBackend::tokenizer_sse2:
+        return "tokenizer_sse2";
+    case ParserBackend::tokenizer_avx2:
+        return "tokenizer_avx2";
+    }
+    throw std::logic_error{"Unknown parser backend"};
+}
 
-    Parser p;
-    p.parse(pcbs, protocol_xml);
+ParserBackend default_parser_backend()
+{
+    static const ParserBackend backend = []() {
+        const char *name = std::getenv(parser_backend_env);
+        if (name == nullptr || *name == '\0') {
+            return ParserBackend::expat;
+        }
 
-    return ctx.get();
+        auto backend_op = parser_backend_from_name(name);
+        if (!backend_op) {
+            throw std::runtime_error{std::format(
+                "{}: {}", parser_backend_env, backend_op.error())};
+        }
+        return backend_op.value();
+    }();
+    return backend;
+}
+
+std::expected<types::Protocol, std::string> parse_protocol(
+    const ProtocolReader &reader,
+    std::pmr::memory_resource *resource,
+    ParserBackend backend)
+{
+    return parse_with(reader, resource, backend, false);
+}
+
+std::expected<types::Protocol, std::string> parse_protocol_fd(
+    int fd, std::pmr::memory_resource *resource, ParserBackend backend)
+{
+    auto read_fd = [fd](std::span<char> buffer) -> size_t {
+        while (true) {
+            ssize_t got = ::read(fd, buffer.data(), buffer.size());
+            if (got >= 0) {
+                return static_cast<size_t>(got);
+            }
+            if (errno != EINTR) {
+                std::error_code ec{errno, std::system_category()};
+                throw std::runtime_error{
+                    std::format("read failed: {}", ec.message())};
+            }
+        }
+    };
+    return parse_protocol(read_fd, resource, backend);
+}
+
+std::expected<types::Protocol, std::string> parse_protocol(
+    std::string_view protocol_xml,
+    std::pmr::memory_resource *resource,
+    ParserBackend backend)
+{
+    return parse_with(protocol_xml, resource, backend, false);
+}
+
+std::expected<types::Protocol, std::string> parse_protocol(
+    const types::ProtocolSource &source,
+    std::pmr::memory_resource *resource,
+    ParserBackend backend)
+{
+    types::Protocol proto =
+        parse_with(source.xml, resource, backend, true);
+    proto.source = source;
+    return proto;
 }
 
 } // namespace wl_gena
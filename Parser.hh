@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <expected>
+#include <functional>
+#include <memory_resource>
+#include <span>
 #include <string>
 #include <string_view>
 
@@ -8,7 +12,81 @@
 
 namespace wl_gena {
 
-auto parse_protocol(std::string_view protocol_xml)
+/*
+ * Fills buffer with the next bytes of the document and returns how many
+ * were written, 0 once the document is over
+ */
+using ProtocolReader = std::function<size_t(std::span<char> buffer)>;
+
+/*
+ * expat is the reference parser, the tokenizer backends run the built-in
+ * XmlTokenizer with a fixed scan instruction set
+ */
+enum class ParserBackend
+{
+    expat,
+    tokenizer_scalar,
+    tokenizer_sse2,
+    tokenizer_avx2,
+};
+
+/*
+ * Accepts the backend names plus "tokenizer", the tokenizer with the
+ * widest instruction set the CPU supports
+ */
+auto parser_backend_from_name(std::string_view name)
+    -> std::expected<ParserBackend, std::string>;
+
+std::string_view parser_backend_name(ParserBackend backend);
+
+/*
+ * Picked by the WL_GENA_PARSER environment variable, expat when unset
+ */
+ParserBackend default_parser_backend();
+
+/*
+ * Streams the document through the parser in fixed-size chunks, so only
+ * one chunk of the XML is resident at a time
+ *
+ * The protocol tables and the parser's own scratch containers allocate
+ * from [resource] in this and every other parse_protocol overload; expat
+ * keeps its buffers on the global heap, counted in the allocation stats
+ * of the parse phase like operator new
+ */
+auto parse_protocol(
+    const ProtocolReader &reader,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+    ParserBackend backend = default_parser_backend())
+    -> std::expected<types::Protocol, std::string>;
+
+/*
+ * Reads [fd] up to its end through the overload above
+ */
+auto parse_protocol_fd(
+    int fd,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+    ParserBackend backend = default_parser_backend())
+    -> std::expected<types::Protocol, std::string>;
+
+/*
+ * Shares the parse driver of the reader overload. The tokenizer backends
+ * read [protocol_xml] in place, expat is handed it a chunk at a time
+ */
+auto parse_protocol(
+    std::string_view protocol_xml,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+    ParserBackend backend = default_parser_backend())
+    -> std::expected<types::Protocol, std::string>;
+
+/*
+ * Also records documentation: summaries are interned, descriptions and
+ * the copyright stay byte ranges of the source, which the protocol keeps
+ * alive. Only whole in-memory documents can be parsed this way
+ */
+auto parse_protocol(
+    const types::ProtocolSource &source,
+    std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+    ParserBackend backend = default_parser_backend())
     -> std::expected<types::Protocol, std::string>;
 
-}
+} // namespace wl_gena
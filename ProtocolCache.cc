@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "File.hh"
+#include "ProtocolCache.hh"
+#include "Types.hh"
+
+namespace wl_gena {
+
+namespace {
+
+/*
+ * Bump on every change of types:: or of the serialized layout below
+ */
+constexpr uint32_t cache_format_version = 3;
+
+/*
+ * Changes whenever the sources deciding parse results do (see
+ * CMakeLists.txt), so a parser fix never meets entries of the old parser
+ */
+#ifndef WL_GENA_BUILD_ID
+#error "WL_GENA_BUILD_ID is expected to be defined by the build"
+#endif
+constexpr std::string_view cache_build_id = WL_GENA_BUILD_ID;
+constexpr std::string_view cache_magic = "WLGPCACH";
+constexpr std::string_view cache_entry_extension = ".wlgp";
+
+struct Writer
+{
+    template <typename T>
+        requires std::is_integral_v<T>
+    void put(T val)
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &val, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    void put(bool val)
+    {
+        put<uint8_t>(val ? 1 : 0);
+    }
+
+    void put(std::string_view str)
+    {
+        put<uint32_t>(str.size());
+        out.append(str);
+    }
+
+    void put(const std::optional<uint32_t> &val)
+    {
+        put(val.has_value());
+        if (val) {
+            put(val.value());
+        }
+    }
+
+    void put(const types::IndexRange &range)
+    {
+        put(range.first);
+        put(range.count);
+    }
+
+    void put(const std::optional<types::TextRange> &range)
+    {
+        put(range.has_value());
+        if (range) {
+            put(range->first);
+            put(range->size);
+        }
+    }
+
+    template <typename T>
+    void put_table(const std::pmr::vector<T> &table)
+    {
+        put<uint32_t>(table.size());
+        for (const T &el : table) {
+            put_el(el);
+        }
+    }
+
+    void put_el(const types::InterfaceRecord &iface)
+    {
+        put(iface.name);
+        put(iface.version);
+        put(iface.requests);
+        put(iface.events);
+        put(iface.enums);
+        put(iface.doc);
+    }
+
+    void put_el(const types::MessageRecord &msg)
+    {
+        put(msg.name);
+        put(msg.args);
+        put(msg.since);
+        put(msg.destructor);
+        put(msg.doc);
+    }
+
+    void put_el(const types::ArgRecord &arg)
+    {
+        put(arg.name);
+        put<uint8_t>(static_cast<uint8_t>(arg.kind));
+        put(arg.interface_name);
+        put(arg.enum_name);
+        put(arg.doc);
+    }
+
+    void put_el(const types::EnumRecord &e)
+    {
+        put(e.name);
+        put(e.entries);
+        put(e.doc);
+    }
+
+    void put_el(const types::EntryRecord &entry)
+    {
+        put(entry.name);
+        put(entry.value);
+        put(entry.is_hex);
+        put(entry.doc);
+    }
+
+    void put_el(const types::DocRecord &doc)
+    {
+        put(doc.summary);
+        put(doc.description);
+    }
+
+    void put_el(const types::Protocol &proto)
+    {
+        put(std::string_view{proto.strings.chars});
+        put_table(proto.strings.ends);
+        put(proto.name_id);
+        put_table(proto.interface_records);
+        put_table(proto.request_records);
+        put_table(proto.event_records);
+        put_table(proto.arg_records);
+        put_table(proto.enum_records);
+        put_table(proto.entry_records);
+        put_table(proto.doc_records);
+        put(proto.doc_id);
+        put(proto.copyright);
+    }
+
+    void put_el(uint32_t val)
+    {
+        put(val);
+    }
+
+    std::string out;
+};
+
+struct Reader
+{
+    explicit Reader(std::string_view data) : _data{data}
+    {
+    }
+
+    std::string_view take(size_t size)
+    {
+        if (_data.size() - _pos < size) {
+            throw std::runtime_error{"Truncated protocol cache entry"};
+        }
+        std::string_view o = _data.substr(_pos, size);
+        _pos += size;
+        return o;
+    }
+
+    template <typename T>
+        requires std::is_integral_v<T>
+    T get()
+    {
+        T val;
+        std::memcpy(&val, take(sizeof(T)).data(), sizeof(T));
+        return val;
+    }
+
+    bool get_bool()
+    {
+        return get<uint8_t>() != 0;
+    }
+
+    std::optional<uint32_t> get_opt_u32()
+    {
+        if (!get_bool()) {
+            return std::nullopt;
+        }
+        return get<uint32_t>();
+    }
+
+    types::IndexRange get_range()
+    {
+        types::IndexRange range;
+        range.first = get<uint32_t>();
+        range.count = get<uint32_t>();
+        return range;
+    }
+
+    std::optional<types::TextRange> get_opt_text_range()
+    {
+        if (!get_bool()) {
+            return std::nullopt;
+        }
+        types::TextRange range;
+        range.first = get<uint32_t>();
+        range.size = get<uint32_t>();
+        return range;
+    }
+
+    template <typename T>
+    void get_table(std::pmr::vector<T> &table)
+    {
+        uint32_t size = get<uint32_t>();
+        table.reserve(std::min<size_t>(size, _data.size() - _pos));
+        for (uint32_t el_i = 0; el_i != size; ++el_i) {
+            table.push_back(get_el(std::type_identity<T>{}));
+        }
+    }
+
+    uint32_t get_el(std::type_identity<uint32_t>)
+    {
+        return get<uint32_t>();
+    }
+
+    types::InterfaceRecord get_el(std::type_identity<types::InterfaceRecord>)
+    {
+        types::InterfaceRecord iface;
+        iface.name = get<uint32_t>();
+        iface.version = get<uint32_t>();
+        iface.requests = get_range();
+        iface.events = get_range();
+        iface.enums = get_range();
+        iface.doc = get<uint32_t>();
+        return iface;
+    }
+
+    types::MessageRecord get_el(std::type_identity<types::MessageRecord>)
+    {
+        types::MessageRecord msg;
+        msg.name = get<uint32_t>();
+        msg.args = get_range();
+        msg.since = get_opt_u32();
+        msg.destructor = get_bool();
+        msg.doc = get<uint32_t>();
+        return msg;
+    }
+
+    types::ArgRecord get_el(std::type_identity<types::ArgRecord>)
+    {
+        types::ArgRecord arg;
+        arg.name = get<uint32_t>();
+        uint8_t kind = get<uint8_t>();
+        if (kind >= types::arg_kind_count) {
+            throw std::runtime_error{std::format(
+                "Bad arg kind [{}] in protocol cache entry", kind)};
+        }
+        arg.kind = static_cast<types::ArgKind>(kind);
+        arg.interface_name = get<uint32_t>();
+        arg.enum_name = get<uint32_t>();
+        arg.doc = get<uint32_t>();
+        return arg;
+    }
+
+    types::EnumRecord get_el(std::type_identity<types::EnumRecord>)
+    {
+        types::EnumRecord e;
+        e.name = get<uint32_t>();
+        e.entries = get_range();
+        e.doc = get<uint32_t>();
+        return e;
+    }
+
+    types::EntryRecord get_el(std::type_identity<types::EntryRecord>)
+    {
+        types::EntryRecord entry;
+        entry.name = get<uint32_t>();
+        entry.value = get<uint32_t>();
+        entry.is_hex = get_bool();
+        entry.doc = get<uint32_t>();
+        return entry;
+    }
+
+    types::DocRecord get_el(std::type_identity<types::DocRecord>)
+    {
+        types::DocRecord doc;
+        doc.summary = get<uint32_t>();
+        doc.description = get_opt_text_range();
+        return doc;
+    }
+
+    types::Protocol get_el(std::type_identity<types::Protocol>)
+    {
+        types::Protocol proto;
+        proto.strings.chars = take(get<uint32_t>());
+        get_table(proto.strings.ends);
+        proto.name_id = get<uint32_t>();
+        get_table(proto.interface_records);
+        get_table(proto.request_records);
+        get_table(proto.event_records);
+        get_table(proto.arg_records);
+        get_table(proto.enum_records);
+        get_table(proto.entry_records);
+        get_table(proto.doc_records);
+        proto.doc_id = get<uint32_t>();
+        proto.copyright = get_opt_text_range();
+        return proto;
+    }
+
+    bool at_end() const
+    {
+        return _pos == _data.size();
+    }
+
+  private:
+    std::string_view _data;
+    size_t _pos = 0;
+};
+
+/*
+ * Entries come from disk, so every id and range is checked before views
+ * start indexing with them. Text ranges have to lie within the source
+ * the entry is loaded for, which is empty for entries without docs
+ */
+void check_tables(const types::Protocol &proto, size_t source_size)
+{
+    auto fail = []() {
+        throw std::runtime_error{"Inconsistent protocol cache entry"};
+    };
+
+    uint32_t previous_end = 0;
+    for (uint32_t end : proto.strings.ends) {
+        if (end < previous_end || end > proto.strings.chars.size()) {
+            fail();
+        }
+        previous_end = end;
+    }
+
+    auto check_string = [&](types::StringId id, bool optional = false) {
+        if (optional && id == types::no_string) {
+            return;
+        }
+        if (id >= proto.strings.size()) {
+            fail();
+        }
+    };
+
+    auto check_range = [&fail](types::IndexRange range, size_t table_size) {
+        bool fits = range.first <= table_size &&
+                    range.count <= table_size - range.first;
+        if (!fits) {
+            fail();
+        }
+    };
+
+    auto check_doc = [&](uint32_t id) {
+        if (id != types::no_doc && id >= proto.doc_records.size()) {
+            fail();
+        }
+    };
+
+    auto check_text = [&](const std::optional<types::TextRange> &range) {
+        bool fits = !range || (range->first <= source_size &&
+                               range->size <= source_size - range->first);
+        if (!fits) {
+            fail();
+        }
+    };
+
+    check_string(proto.name_id);
+    check_doc(proto.doc_id);
+    check_text(proto.copyright);
+    for (const types::DocRecord &doc : proto.doc_records) {
+        check_string(doc.summary, true);
+        check_text(doc.description);
+    }
+    for (const types::InterfaceRecord &iface : proto.interface_records) {
+        check_string(iface.name);
+        check_doc(iface.doc);
+        check_range(iface.requests, proto.request_records.size());
+        check_range(iface.events, proto.event_records.size());
+        check_range(iface.enums, proto.enum_records.size());
+    }
+    for (const auto *table : {&proto.request_records, &proto.event_records}) {
+        for (const types::MessageRecord &msg : *table) {
+            check_string(msg.name);
+            check_doc(msg.doc);
+            check_range(msg.args, proto.arg_records.size());
+        }
+    }
+    for (const types::ArgRecord &arg : proto.arg_records) {
+        check_string(arg.name);
+        check_string(arg.interface_name, true);
+        check_string(arg.enum_name, arg.kind != types::ArgKind::UIntEnum);
+        check_doc(arg.doc);
+    }
+    for (const types::EnumRecord &e : proto.enum_records) {
+        check_string(e.name);
+        check_doc(e.doc);
+        check_range(e.entries, proto.entry_records.size());
+    }
+    for (const types::EntryRecord &entry : proto.entry_records) {
+        check_string(entry.name);
+        check_doc(entry.doc);
+    }
+}
+
+std::string make_header(
+    std::string_view protocol_xml, uint64_t content_hash, bool with_docs)
+{
+    Writer w;
+    w.out.append(cache_magic);
+    w.put(cache_format_version);
+    w.put(cache_build_id);
+    w.put(with_docs);
+    w.put<uint64_t>(protocol_xml.size());
+    w.put(content_hash);
+    return std::move(w.out);
+}
+
+} // namespace
+
+uint64_t hash_bytes(std::string_view bytes)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char c : bytes) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+ProtocolCache::ProtocolCache(std::filesystem::path directory)
+    : _directory{std::move(directory)}
+{
+    try {
+        std::filesystem::create_directories(_directory);
+    } catch (std::exception &e) {
+        disable(e.what());
+    }
+}
+
+void ProtocolCache::disable(std::string_view reason) const
+{
+    if (!_disabled.exchange(true)) {
+        std::cerr << std::format(
+            "Warning: protocol cache [{}] disabled: {}\n",
+            _directory.string(),
+            reason);
+    }
+}
+
+std::filesystem::path
+    ProtocolCache::entry_path(std::string_view header) const
+{
+    std::string file_name =
+        std::format("{:016x}{}", hash_bytes(header), cache_entry_extension);
+    return _directory / file_name;
+}
+
+std::optional<types::Protocol> ProtocolCache::load(
+    std::string_view protocol_xml, uint64_t content_hash) const
+{
+    return load_entry(protocol_xml, content_hash, false);
+}
+
+std::optional<types::Protocol> ProtocolCache::load(
+    const types::ProtocolSource &source, uint64_t content_hash) const
+{
+    auto proto = load_entry(source.xml, content_hash, true);
+    if (proto) {
+        proto->source = source;
+    }
+    return proto;
+}
+
+std::optional<types::Protocol>
+    ProtocolCache::load_entry(
+        std::string_view protocol_xml, uint64_t content_hash, bool with_docs)
+        const
+{
+    if (_disabled) {
+        return std::nullopt;
+    }
+    std::string expected_header =
+        make_header(protocol_xml, content_hash, with_docs);
+    std::filesystem::path path = entry_path(expected_header);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return std::nullopt;
+    }
+
+    try {
+        MappedFile entry{path.string()};
+
+        Reader r{entry.view()};
+        if (r.take(expected_header.size()) != expected_header) {
+            return std::nullopt;
+        }
+
+        types::Protocol proto = r.get_el(std::type_identity<types::Protocol>{});
+        if (!r.at_end()) {
+            return std::nullopt;
+        }
+        check_tables(proto, with_docs ? protocol_xml.size() : 0);
+        return proto;
+    } catch (std::runtime_error &) {
+        return std::nullopt;
+    }
+}
+
+void ProtocolCache::store(
+    std::string_view protocol_xml,
+    uint64_t content_hash,
+    const types::Protocol &proto) const
+{
+    if (_disabled) {
+        return;
+    }
+    bool with_docs = proto.source.owner != nullptr;
+
+    Writer w;
+    w.out = make_header(protocol_xml, content_hash, with_docs);
+    std::filesystem::path path = entry_path(w.out);
+    w.put_el(proto);
+
+    try {
+        write_file_if_changed(path.string(), w.out);
+    } catch (std::exception &e) {
+        disable(e.what());
+    }
+}
+
+} // namespace wl_gena
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "Types.hh"
+
+namespace wl_gena {
+
+/*
+ * On-disk cache of parsed protocols
+ *
+ * Entries are keyed by a hash of the protocol XML bytes, the cache
+ * format version and the build id of the parser, so a changed file or a
+ * rebuilt generator never sees a stale entry. Hits are loaded from an
+ * mmap of the entry without touching expat
+ *
+ * Callers pass the content hash (hash_bytes) of the XML they already
+ * computed, the cache does not hash the XML again
+ *
+ * Protocols parsed with documentation are kept in separate entries;
+ * their text ranges refer to the XML, so they are loaded for a source
+ * and keep it alive
+ *
+ * The cache is best-effort: if the directory cannot be created or an
+ * entry cannot be written, a warning goes to stderr once and the cache
+ * turns itself off, generation carries on uncached
+ */
+struct ProtocolCache
+{
+    explicit ProtocolCache(std::filesystem::path directory);
+
+    std::optional<types::Protocol>
+        load(std::string_view protocol_xml, uint64_t content_hash) const;
+    std::optional<types::Protocol> load(
+        const types::ProtocolSource &source, uint64_t content_hash) const;
+
+    /*
+     * Stored as an entry with documentation if [proto] holds its source
+     */
+    void store(
+        std::string_view protocol_xml,
+        uint64_t content_hash,
+        const types::Protocol &proto) const;
+
+  private:
+    std::optional<types::Protocol> load_entry(
+        std::string_view protocol_xml,
+        uint64_t content_hash,
+        bool with_docs) const;
+    std::filesystem::path entry_path(std::string_view header) const;
+    void disable(std::string_view reason) const;
+
+    std::filesystem::path _directory;
+    mutable std::atomic<bool> _disabled{false};
+};
+
+uint64_t hash_bytes(std::string_view bytes);
+
+} // namespace wl_gena
@@ -0,0 +1,195 @@
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+#include "File.hh"
+#include "Parser.hh"
+#include "ProtocolCache.hh"
+#include "ProtocolStore.hh"
+#include "Trace.hh"
+#include "Types.hh"
+
+namespace wl_gena {
+
+namespace {
+
+std::string make_store_key(const std::string &file_name, bool with_docs)
+{
+    std::error_code ec;
+    std::filesystem::path canonical =
+        std::filesystem::weakly_canonical(file_name, ec);
+    std::string key = ec ? file_name : canonical.string();
+    if (with_docs) {
+        // NUL never appears in a path
+        key += std::string_view{"\0docs", 5};
+    }
+    return key;
+}
+
+} // namespace
+
+ProtocolStore::ProtocolStore(std::optional<std::filesystem::path> cache_dir)
+{
+    if (cache_dir) {
+        _cache.emplace(std::move(cache_dir.value()));
+    }
+}
+
+auto ProtocolStore::stamp_file(const std::string &file_name)
+    -> std::optional<FileStamp>
+{
+    std::error_code ec;
+    FileStamp stamp;
+    stamp.size = std::filesystem::file_size(file_name, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    stamp.mtime = std::filesystem::last_write_time(file_name, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return stamp;
+}
+
+auto ProtocolStore::load(
+    const std::string &file_name,
+    bool with_docs,
+    const std::optional<Entry> &previous,
+    JobClock *clock) const -> Loaded
+{
+    std::shared_ptr<InputFile> input;
+    uint64_t content_hash = 0;
+    {
+        PhaseScope read_phase{clock, JobPhase::read};
+        input = std::make_shared<InputFile>(file_name);
+        content_hash = hash_bytes(input->view());
+        if (clock) {
+            clock->stats().input_bytes += input->view().size();
+        }
+    }
+    std::string_view protocol_xml = input->view();
+    types::ProtocolSource source{input, protocol_xml};
+
+    if (previous) {
+        try {
+            const Loaded &previous_loaded = previous->loaded.get();
+            if (previous_loaded.content_hash == content_hash) {
+                return previous_loaded;
+            }
+        } catch (std::exception &) {
+            // Previous parse failed, the file may be fixed by now
+        }
+    }
+
+    PhaseScope parse_phase{clock, JobPhase::parse};
+    if (_cache) {
+        auto cached = with_docs ? _cache->load(source, content_hash)
+                                : _cache->load(protocol_xml, content_hash);
+        if (cached) {
+            return Loaded{
+                std::make_shared<const types::Protocol>(
+                    std::move(cached.value())),
+                content_hash};
+        }
+    }
+
+    auto protocol_op =
+        with_docs ? parse_protocol(source) : parse_protocol(protocol_xml);
+    if (!protocol_op) {
+        throw std::runtime_error{protocol_op.error()};
+    }
+
+    if (_cache) {
+        _cache->store(protocol_xml, content_hash, protocol_op.value());
+    }
+
+    return Loaded{
+        std::make_shared<const types::Protocol>(
+            std::move(protocol_op.value())),
+        content_hash};
+}
+
+auto ProtocolStore::get(
+    const std::string &file_name, bool with_docs, JobClock *clock)
+    -> ProtocolPtr
+{
+    std::string key = make_store_key(file_name, with_docs);
+    std::optional<FileStamp> stamp = stamp_file(file_name);
+
+    std::promise<Loaded> load_promise;
+    std::optional<Entry> previous;
+    {
+        std::unique_lock lock{_mutex};
+        auto it = _protocols.find(key);
+        if (it != std::end(_protocols)) {
+            bool is_fresh = stamp.has_value() && it->second.stamp == stamp;
+            if (is_fresh) {
+                auto loaded = it->second.loaded;
+                lock.unlock();
+                return loaded.get().protocol;
+            }
+            previous = it->second;
+        }
+        if (stamp) {
+            _protocols.insert_or_assign(
+                key,
+                Entry{
+                    file_name,
+                    stamp.value(),
+                    load_promise.get_future().share()});
+        } else {
+            // Nothing to tell a later version by, the next get reloads
+            _protocols.erase(key);
+        }
+    }
+
+    try {
+        Loaded loaded = load(file_name, with_docs, previous, clock);
+        load_promise.set_value(loaded);
+        return loaded.protocol;
+    } catch (...) {
+        load_promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+void ProtocolStore::drop_stale()
+{
+    std::vector<std::pair<std::string, Entry>> entries;
+    {
+        std::lock_guard lock{_mutex};
+        entries.assign(std::begin(_protocols), std::end(_protocols));
+    }
+
+    // Stat without holding the lock, gets of other threads go on
+    std::vector<std::pair<std::string, FileStamp>> stale;
+    for (const auto &[key, entry] : entries) {
+        std::optional<FileStamp> stamp = stamp_file(entry.file_name);
+        if (stamp != entry.stamp) {
+            stale.emplace_back(key, entry.stamp);
+        }
+    }
+
+    std::lock_guard lock{_mutex};
+    for (const auto &[key, stamp] : stale) {
+        auto it = _protocols.find(key);
+        // Reloaded since, by a get that saw the new stamp
+        bool replaced = it == std::end(_protocols) || it->second.stamp != stamp;
+        if (!replaced) {
+            _protocols.erase(it);
+        }
+    }
+}
+
+} // namespace wl_gena
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "ProtocolCache.hh"
+#include "Trace.hh"
+#include "Types.hh"
+
+namespace wl_gena {
+
+/*
+ * Parses every distinct protocol file once and hands out shared
+ * immutable results, so jobs listing the same --context_protocols
+ * file do not re-read and re-parse it
+ *
+ * Safe to use from multiple threads: concurrent requests for a file
+ * that is being parsed wait for that parse instead of starting another
+ *
+ * Entries remember the size and mtime of their file. A long-lived store
+ * (server mode) re-reads a file once those change, and re-parses it only
+ * if the content hash changed as well. Only the latest version of a file
+ * is kept, and drop_stale forgets files that changed or went away since
+ *
+ * With a cache directory, parse results also persist across runs
+ * (see ProtocolCache)
+ *
+ * A protocol requested with documentation is a separate entry, which
+ * keeps its file contents in memory for the descriptions to point into
+ *
+ * A given clock is told about reading and parsing the file, if this
+ * call is the one doing it
+ */
+struct ProtocolStore
+{
+    using ProtocolPtr = std::shared_ptr<const types::Protocol>;
+
+    ProtocolStore() = default;
+    explicit ProtocolStore(std::optional<std::filesystem::path> cache_dir);
+
+    ProtocolPtr get(
+        const std::string &file_name,
+        bool with_docs = false,
+        JobClock *clock = nullptr);
+
+    /*
+     * Drops every entry whose file changed or no longer exists, so a
+     * long-lived store does not grow with each file it has ever seen.
+     * Protocols already handed out stay valid
+     */
+    void drop_stale();
+
+  private:
+    struct FileStamp
+    {
+        uintmax_t size = 0;
+        std::filesystem::file_time_type mtime;
+
+        bool operator==(const FileStamp &) const = default;
+    };
+
+    struct Loaded
+    {
+        ProtocolPtr protocol;
+        uint64_t content_hash;
+    };
+
+    struct Entry
+    {
+        std::string file_name;
+        FileStamp stamp;
+        std::shared_future<Loaded> loaded;
+    };
+
+    static std::optional<FileStamp> stamp_file(const std::string &file_name);
+
+    Loaded load(
+        const std::string &file_name,
+        bool with_docs,
+        const std::optional<Entry> &previous,
+        JobClock *clock) const;
+
+    std::optional<ProtocolCache> _cache;
+    std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _protocols;
+};
+
+} // namespace wl_gena
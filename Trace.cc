@@ -0,0 +1,393 @@
+#include <chrono>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Trace.hh"
+
+namespace wl_gena {
+
+namespace {
+
+std::string json_string(std::string_view str)
+{
+    std::string out = "\"";
+    for (char c : str) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += std::format("\\u{:04x}", int(c));
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+double to_ms(std::chrono::nanoseconds time)
+{
+    return std::chrono::duration<double, std::milli>{time}.count();
+}
+
+std::chrono::nanoseconds total_time(const JobStats &stats)
+{
+    std::chrono::nanoseconds total{};
+    for (std::chrono::nanoseconds time : stats.phase_times) {
+        total += time;
+    }
+    return total;
+}
+
+AllocCounters total_allocs(const JobStats &stats)
+{
+    AllocCounters total;
+    for (const AllocCounters &allocs : stats.phase_allocs) {
+        total += allocs;
+    }
+    return total;
+}
+
+void format_phase_line(
+    std::string &out,
+    std::string_view name,
+    std::chrono::nanoseconds time,
+    const AllocCounters &allocs)
+{
+    auto o = std::back_inserter(out);
+    std::format_to(o, "{:<8} {:>10.3f}", name, to_ms(time));
+    if (alloc_accounting_enabled()) {
+        std::format_to(
+            o,
+            " {:>10} {:>12} {:>12}",
+            allocs.allocations,
+            allocs.bytes,
+            allocs.peak_live_bytes);
+    }
+    out += '\n';
+}
+
+} // namespace
+
+std::string_view job_phase_name(JobPhase phase)
+{
+    switch (phase) {
+    case JobPhase::read:
+        return "read";
+    case JobPhase::parse:
+        return "parse";
+    case JobPhase::resolve:
+        return "resolve";
+    case JobPhase::rtti:
+        return "rtti";
+    case JobPhase::emit:
+        return "emit";
+    case JobPhase::write:
+        return "write";
+    }
+    return "unknown";
+}
+
+JobPhase job_phase_of(HeaderPhase phase)
+{
+    switch (phase) {
+    case HeaderPhase::resolve:
+        return JobPhase::resolve;
+    case HeaderPhase::rtti:
+        return JobPhase::rtti;
+    case HeaderPhase::emit:
+        return JobPhase::emit;
+    }
+    return JobPhase::emit;
+}
+
+JobStats &JobStats::operator+=(const JobStats &other)
+{
+    for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+        phase_times[phase_i] += other.phase_times[phase_i];
+        phase_allocs[phase_i] += other.phase_allocs[phase_i];
+    }
+    input_bytes += other.input_bytes;
+    output_bytes += other.output_bytes;
+    interfaces += other.interfaces;
+    messages += other.messages;
+    args += other.args;
+    enums += other.enums;
+    return *this;
+}
+
+std::string format_job_stats(const JobStats &stats)
+{
+    std::string out;
+    auto o = std::back_inserter(out);
+
+    std::format_to(o, "{:<8} {:>10}", "phase", "ms");
+    if (alloc_accounting_enabled()) {
+        std::format_to(
+            o, " {:>10} {:>12} {:>12}", "allocs", "bytes", "peak live");
+    }
+    out += '\n';
+
+    for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+        format_phase_line(
+            out,
+            job_phase_name(JobPhase(phase_i)),
+            stats.phase_times[phase_i],
+            stats.phase_allocs[phase_i]);
+    }
+    format_phase_line(out, "total", total_time(stats), total_allocs(stats));
+
+    std::format_to(
+        o,
+        "input {} bytes, output {} bytes\n",
+        stats.input_bytes,
+        stats.output_bytes);
+    std::format_to(
+        o,
+        "interfaces {}, messages {}, args {}, enums {}\n",
+        stats.interfaces,
+        stats.messages,
+        stats.args,
+        stats.enums);
+
+    return out;
+}
+
+std::string format_job_stats_line(const JobStats &stats)
+{
+    std::string out = std::format(
+        "{:.3f} ms, input {} bytes, output {} bytes",
+        to_ms(total_time(stats)),
+        stats.input_bytes,
+        stats.output_bytes);
+    if (alloc_accounting_enabled()) {
+        AllocCounters allocs = total_allocs(stats);
+        out += std::format(
+            ", {} allocations, {} bytes allocated, peak live {} bytes",
+            allocs.allocations,
+            allocs.bytes,
+            allocs.peak_live_bytes);
+    }
+    return out;
+}
+
+uint32_t Trace::thread_track()
+{
+    auto [it, inserted] = _thread_tracks.try_emplace(
+        std::this_thread::get_id(), uint32_t(_thread_tracks.size() + 1));
+    return it->second;
+}
+
+void Trace::add_span(
+    std::string_view name,
+    std::string_view category,
+    clock::time_point begin,
+    clock::time_point end,
+    std::string args_json)
+{
+    std::lock_guard lock{_mutex};
+    _events.push_back(Event{
+        .type = 'X',
+        .name = std::string{name},
+        .category = category,
+        .time = begin,
+        .duration = end - begin,
+        .thread_track = thread_track(),
+        .args_json = std::move(args_json),
+    });
+}
+
+void Trace::add_job(
+    size_t job_id,
+    std::string_view name,
+    clock::time_point begin,
+    clock::time_point end,
+    std::string args_json)
+{
+    std::lock_guard lock{_mutex};
+    uint32_t track = thread_track();
+
+    _events.push_back(Event{
+        .type = 'X',
+        .name = std::string{name},
+        .category = "job",
+        .time = begin,
+        .duration = end - begin,
+        .thread_track = track,
+        .args_json = args_json,
+    });
+    _events.push_back(Event{
+        .type = 'b',
+        .name = std::string{name},
+        .category = "job",
+        .time = begin,
+        .thread_track = track,
+        .job_id = job_id,
+        .args_json = std::move(args_json),
+    });
+    _events.push_back(Event{
+        .type = 'e',
+        .name = std::string{name},
+        .category = "job",
+        .time = end,
+        .thread_track = track,
+        .job_id = job_id,
+        .args_json = {},
+    });
+}
+
+std::string Trace::json() const
+{
+    using us = std::chrono::duration<double, std::micro>;
+
+    std::lock_guard lock{_mutex};
+
+    std::string out = "{\"traceEvents\": [\n";
+    auto o = std::back_inserter(out);
+
+    out += R"(  {"ph": "M", "pid": 1, "tid": 0, "name": "process_name", )"
+           R"("args": {"name": "wl_gena"}})";
+    for (const auto &[thread_id, track] : _thread_tracks) {
+        std::format_to(
+            o,
+            ",\n  {{\"ph\": \"M\", \"pid\": 1, \"tid\": {}, "
+            "\"name\": \"thread_name\", "
+            "\"args\": {{\"name\": \"thread {}\"}}}}",
+            track,
+            track);
+    }
+
+    for (const Event &event : _events) {
+        std::format_to(
+            o,
+            ",\n  {{\"ph\": \"{}\", \"pid\": 1, \"tid\": {}, "
+            "\"name\": {}, \"cat\": {}, \"ts\": {:.3f}",
+            event.type,
+            event.thread_track,
+            json_string(event.name),
+            json_string(event.category),
+            us{event.time - _start}.count());
+        if (event.type == 'X') {
+            std::format_to(
+                o, ", \"dur\": {:.3f}", us{event.duration}.count());
+        } else {
+            std::format_to(o, ", \"id\": {}", event.job_id);
+        }
+        if (!event.args_json.empty()) {
+            std::format_to(o, ", \"args\": {}", event.args_json);
+        }
+        out += '}';
+    }
+
+    out += "\n], \"displayTimeUnit\": \"ms\"}\n";
+    return out;
+}
+
+JobClock::JobClock(
+    JobStats &stats, Trace *trace, size_t job_id, std::string name)
+    : _stats{stats}, _trace{trace}, _job_id{job_id}, _name{std::move(name)}
+{
+    _active.reserve(job_phase_count);
+    _previous_account = exchange_alloc_account({nullptr, &_live_bytes});
+}
+
+JobClock::~JobClock()
+{
+    while (!_active.empty()) {
+        leave();
+    }
+    exchange_alloc_account(_previous_account);
+    if (!_trace) {
+        return;
+    }
+
+    std::string args_json = std::format(
+        "{{\"input_bytes\": {}, \"output_bytes\": {}, \"interfaces\": {}, "
+        "\"messages\": {}, \"args\": {}, \"enums\": {}",
+        _stats.input_bytes,
+        _stats.output_bytes,
+        _stats.interfaces,
+        _stats.messages,
+        _stats.args,
+        _stats.enums);
+    if (alloc_accounting_enabled()) {
+        AllocCounters allocs = total_allocs(_stats);
+        args_json += std::format(
+            ", \"allocations\": {}, \"allocated_bytes\": {}, "
+            "\"peak_live_bytes\": {}",
+            allocs.allocations,
+            allocs.bytes,
+            allocs.peak_live_bytes);
+    }
+    args_json += '}';
+    _trace->add_job(
+        _job_id, _name, _begin, clock::now(), std::move(args_json));
+}
+
+void JobClock::enter(JobPhase phase)
+{
+    clock::time_point now = clock::now();
+    count_no_allocations();
+    if (!_active.empty()) {
+        Active &paused = _active.back();
+        _stats.phase_times[size_t(paused.phase)] += now - paused.resumed;
+    }
+    _active.push_back(Active{phase, now, now});
+    count_allocations_into_active();
+}
+
+void JobClock::leave()
+{
+    clock::time_point now = clock::now();
+    count_no_allocations();
+    Active left = _active.back();
+    _active.pop_back();
+
+    _stats.phase_times[size_t(left.phase)] += now - left.resumed;
+
+    if (_trace) {
+        _trace->add_span(
+            job_phase_name(left.phase), "phase", left.begin, now);
+    }
+
+    if (!_active.empty()) {
+        _active.back().resumed = clock::now();
+    }
+    count_allocations_into_active();
+}
+
+void JobClock::count_allocations_into_active()
+{
+    AllocCounters *counters = nullptr;
+    if (!_active.empty()) {
+        counters = &_stats.phase_allocs[size_t(_active.back().phase)];
+    }
+    exchange_alloc_account({counters, &_live_bytes});
+}
+
+void JobClock::count_no_allocations()
+{
+    exchange_alloc_account({nullptr, &_live_bytes});
+}
+
+} // namespace wl_gena
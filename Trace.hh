@@ -0,0 +1,212 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "AllocStats.hh"
+#include "HeaderGena.hh"
+
+namespace wl_gena {
+
+/*
+ * Parts of a job as reported by --stats and --trace, in the order a job
+ * goes through them
+ */
+enum class JobPhase
+{
+    read,
+    parse,
+    resolve,
+    rtti,
+    emit,
+    write,
+};
+
+constexpr size_t job_phase_count = 6;
+
+std::string_view job_phase_name(JobPhase phase);
+
+/*
+ * The job phase header generation is in
+ */
+JobPhase job_phase_of(HeaderPhase phase);
+
+/*
+ * Wall time per phase, bytes and element counts of one or more jobs
+ *
+ * Phase times exclude nested phases: output written while the header is
+ * emitted counts as write, not emit. Protocols a job found already
+ * parsed in the store add neither read nor parse time
+ *
+ * Element counts are of the protocols the jobs generate output for,
+ * context protocols are only looked up in
+ *
+ * Allocations are attributed to phases the same way, if the executable
+ * counts them (alloc_accounting_enabled())
+ */
+struct JobStats
+{
+    std::array<std::chrono::nanoseconds, job_phase_count> phase_times{};
+    std::array<AllocCounters, job_phase_count> phase_allocs{};
+    size_t input_bytes = 0;
+    size_t output_bytes = 0;
+    size_t interfaces = 0;
+    size_t messages = 0;
+    size_t args = 0;
+    size_t enums = 0;
+
+    JobStats &operator+=(const JobStats &other);
+};
+
+std::string format_job_stats(const JobStats &stats);
+
+/*
+ * One line summary, for reporting jobs one by one
+ */
+std::string format_job_stats_line(const JobStats &stats);
+
+/*
+ * Collects Chrome trace-event JSON, for chrome://tracing or
+ * ui.perfetto.dev
+ *
+ * Every thread that records into the trace has a track with its phases,
+ * and every job an async track of its own. Safe to record into from
+ * multiple threads
+ */
+struct Trace
+{
+    using clock = std::chrono::steady_clock;
+
+    /*
+     * On the track of the calling thread
+     */
+    void add_span(
+        std::string_view name,
+        std::string_view category,
+        clock::time_point begin,
+        clock::time_point end,
+        std::string args_json = {});
+
+    /*
+     * On the track of the job, and as a span on the calling thread track
+     */
+    void add_job(
+        size_t job_id,
+        std::string_view name,
+        clock::time_point begin,
+        clock::time_point end,
+        std::string args_json = {});
+
+    std::string json() const;
+
+  private:
+    struct Event
+    {
+        char type;
+        std::string name;
+        std::string_view category;
+        clock::time_point time;
+        clock::duration duration{};
+        uint32_t thread_track = 0;
+        size_t job_id = 0;
+        std::string args_json;
+    };
+
+    /*
+     * Tracks are numbered in the order threads first record, under _mutex
+     */
+    uint32_t thread_track();
+
+    clock::time_point _start = clock::now();
+    mutable std::mutex _mutex;
+    std::vector<Event> _events;
+    std::unordered_map<std::thread::id, uint32_t> _thread_tracks;
+};
+
+/*
+ * Measures the phases of one job into [stats] and, if given, [trace]
+ *
+ * Phases nest: entering one pauses the active phase until it is left.
+ * The job itself is recorded into the trace when the clock is destroyed
+ *
+ * Allocations of the calling thread are counted for the job while the
+ * clock lives, the clock must stay on the thread that created it
+ */
+struct JobClock
+{
+    using clock = Trace::clock;
+
+    JobClock(JobStats &stats, Trace *trace, size_t job_id, std::string name);
+    ~JobClock();
+
+    JobClock(const JobClock &) = delete;
+    JobClock &operator=(const JobClock &) = delete;
+
+    void enter(JobPhase phase);
+    void leave();
+
+    JobStats &stats()
+    {
+        return _stats;
+    }
+
+  private:
+    /*
+     * Allocations go to the innermost active phase, none to the
+     * bookkeeping of the clock and trace
+     */
+    void count_allocations_into_active();
+    void count_no_allocations();
+
+    struct Active
+    {
+        JobPhase phase;
+        clock::time_point begin;
+        clock::time_point resumed;
+    };
+
+    JobStats &_stats;
+    Trace *_trace;
+    size_t _job_id;
+    std::string _name;
+    clock::time_point _begin = clock::now();
+    std::vector<Active> _active;
+    int64_t _live_bytes = 0;
+    AllocAccount _previous_account;
+};
+
+/*
+ * Keeps [phase] entered for its lifetime, does nothing without a clock
+ */
+struct PhaseScope
+{
+    PhaseScope(JobClock *clock, JobPhase phase) : _clock{clock}
+    {
+        if (_clock) {
+            _clock->enter(phase);
+        }
+    }
+
+    ~PhaseScope()
+    {
+        if (_clock) {
+            _clock->leave();
+        }
+    }
+
+    PhaseScope(const PhaseScope &) = delete;
+    PhaseScope &operator=(const PhaseScope &) = delete;
+
+  private:
+    JobClock *_clock;
+};
+
+} // namespace wl_gena
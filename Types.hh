@@ -2,98 +2,560 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace wl_gena {
 namespace types {
 
-struct InterfaceNameable
+/*
+ * Protocol IR
+ *
+ * A protocol owns all of its data in a handful of flat tables: every
+ * name is interned once into a single string arena and referred to by a
+ * 32-bit id, and interfaces, messages, args, enums and entries live in
+ * one table per kind, pointing at their children by index ranges
+ *
+ * Interface, Message, Arg, Enum and Enum::Entry are views into those
+ * tables: cheap to copy, valid for as long as the protocol is alive
+ *
+ * Every table allocates from the memory resource the protocol was
+ * created with
+ *
+ * Documentation is optional: records point into a separate doc table,
+ * and descriptions stay undecoded XML in the source the protocol was
+ * parsed from, so a protocol without documentation carries none of it
+ */
+
+using StringId = uint32_t;
+inline constexpr StringId no_string = UINT32_MAX;
+
+struct IndexRange
 {
-    std::optional<std::string> interface_name;
+    uint32_t first = 0;
+    uint32_t count = 0;
 };
 
-struct ArgTypes
+// clang-format off
+enum class ArgKind : uint8_t
 {
-    // clang-format off
-struct Int {};
-struct UInt {};
-struct UIntEnum : InterfaceNameable
+    Int,
+    UInt,
+    UIntEnum,
+    Fixed,
+    String,
+    NullString,
+    Object,
+    NullObject,
+    NewID,
+    Array,
+    FD,
+};
+// clang-format on
+
+inline constexpr size_t arg_kind_count = 11;
+
+inline constexpr uint32_t no_doc = UINT32_MAX;
+
+/*
+ * Bytes of the protocol source
+ */
+struct TextRange
 {
-    std::string name;
+    uint32_t first = 0;
+    uint32_t size = 0;
 };
-struct Fixed {};
-struct String {};
-struct NullString {};
-struct Object : InterfaceNameable {};
-struct NullObject : InterfaceNameable {};
-struct NewID : InterfaceNameable {};
-struct Array {};
-struct FD {};
+
+/*
+ * The XML a protocol was parsed from, kept alive by [owner]
+ */
+struct ProtocolSource
+{
+    std::shared_ptr<const void> owner;
+    std::string_view xml;
 };
 
-using ArgType = std::variant<
-    ArgTypes::Int,
-    ArgTypes::UInt,
-    ArgTypes::UIntEnum,
-    ArgTypes::Fixed,
-    ArgTypes::String,
-    ArgTypes::NullString,
-    ArgTypes::Object,
-    ArgTypes::NullObject,
-    ArgTypes::NewID,
-    ArgTypes::Array,
-    ArgTypes::FD
->;
-// clang-format on
+/*
+ * All strings of a protocol back to back, the id is the string index
+ */
+struct StringArena
+{
+    explicit StringArena(std::pmr::memory_resource *resource)
+        : chars{resource}, ends{resource}
+    {
+    }
 
-struct Arg
+    std::string_view get(StringId id) const
+    {
+        size_t begin = id == 0 ? 0 : ends[id - 1];
+        return std::string_view{chars}.substr(begin, ends[id] - begin);
+    }
+
+    StringId add(std::string_view str)
+    {
+        chars.append(str);
+        ends.push_back(chars.size());
+        return ends.size() - 1;
+    }
+
+    size_t size() const
+    {
+        return ends.size();
+    }
+
+    std::pmr::string chars;
+    std::pmr::vector<uint32_t> ends;
+};
+
+/*
+ * Summary attribute and <description> of an element
+ */
+struct DocRecord
 {
-    std::string name;
-    ArgType type;
+    StringId summary = no_string;
+    std::optional<TextRange> description;
 };
 
-struct Enum
+struct InterfaceRecord
 {
-    std::string name;
-    struct Entry
+    StringId name = no_string;
+    uint32_t version = 0;
+    IndexRange requests;
+    IndexRange events;
+    IndexRange enums;
+    uint32_t doc = no_doc;
+};
+
+struct MessageRecord
+{
+    StringId name = no_string;
+    IndexRange args;
+    std::optional<uint32_t> since;
+    bool destructor = false;
+    uint32_t doc = no_doc;
+};
+
+struct ArgRecord
+{
+    StringId name = no_string;
+    ArgKind kind = ArgKind::Int;
+    /*
+     * Interface of Object, NullObject and NewID args, and the optional
+     * "<interface>." prefix of UIntEnum args
+     */
+    StringId interface_name = no_string;
+    StringId enum_name = no_string;
+    uint32_t doc = no_doc;
+};
+
+struct EnumRecord
+{
+    StringId name = no_string;
+    IndexRange entries;
+    uint32_t doc = no_doc;
+};
+
+struct EntryRecord
+{
+    StringId name = no_string;
+    uint32_t value = 0;
+    bool is_hex = false;
+    uint32_t doc = no_doc;
+};
+
+struct Protocol;
+
+template <typename ViewT>
+struct ViewList
+{
+    using Record = typename ViewT::Record;
+
+    struct iterator
     {
-        std::string name;
-        uint32_t value;
-        bool is_hex;
+        using value_type = ViewT;
+        using difference_type = std::ptrdiff_t;
+
+        ViewT operator*() const
+        {
+            return ViewT{protocol, record};
+        }
+
+        iterator &operator++()
+        {
+            ++record;
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator o = *this;
+            ++record;
+            return o;
+        }
+
+        bool operator==(const iterator &) const = default;
+
+        const Protocol *protocol = nullptr;
+        const Record *record = nullptr;
     };
-    std::vector<Entry> entries;
+
+    iterator begin() const
+    {
+        return iterator{protocol, records.data()};
+    }
+
+    iterator end() const
+    {
+        return iterator{protocol, records.data() + records.size()};
+    }
+
+    size_t size() const
+    {
+        return records.size();
+    }
+
+    bool empty() const
+    {
+        return records.empty();
+    }
+
+    ViewT operator[](size_t index) const
+    {
+        return ViewT{protocol, &records[index]};
+    }
+
+    const Protocol *protocol = nullptr;
+    std::span<const Record> records;
+};
+
+/*
+ * Documentation of an element, empty if it has none or the protocol was
+ * parsed without documentation
+ */
+struct Doc
+{
+    std::optional<std::string_view> summary() const;
+
+    /*
+     * Raw XML content of the <description> element, references and
+     * CDATA sections included; see decode_character_data()
+     */
+    std::optional<std::string_view> description_xml() const;
+
+    const Protocol *protocol;
+    const DocRecord *record;
+};
+
+struct Arg
+{
+    using Record = ArgRecord;
+
+    std::string_view name() const;
+    ArgKind kind() const
+    {
+        return record->kind;
+    }
+    std::optional<std::string_view> interface_name() const;
+    std::string_view enum_name() const;
+    Doc doc() const;
+
+    const Protocol *protocol;
+    const Record *record;
 };
 
 struct Message
 {
-    std::string name;
-    std::vector<Arg> args;
-    std::optional<uint32_t> since;
-    bool destructor = false;
+    using Record = MessageRecord;
+
+    std::string_view name() const;
+    ViewList<Arg> args() const;
+    std::optional<uint32_t> since() const
+    {
+        return record->since;
+    }
+    bool destructor() const
+    {
+        return record->destructor;
+    }
+    Doc doc() const;
+
+    const Protocol *protocol;
+    const Record *record;
 };
 
-// clang-format off
-struct Request : Message {};
-struct Event : Message {};
-// clang-format on
+struct Enum
+{
+    using Record = EnumRecord;
+
+    struct Entry
+    {
+        using Record = EntryRecord;
+
+        std::string_view name() const;
+        uint32_t value() const
+        {
+            return record->value;
+        }
+        bool is_hex() const
+        {
+            return record->is_hex;
+        }
+        Doc doc() const;
+
+        const Protocol *protocol;
+        const Record *record;
+    };
+
+    std::string_view name() const;
+    ViewList<Entry> entries() const;
+    Doc doc() const;
+
+    const Protocol *protocol;
+    const Record *record;
+};
 
 struct Interface
 {
-    std::string name;
-    uint32_t version;
-    std::vector<Request> requests;
-    std::vector<Event> events;
-    std::vector<Enum> enums;
+    using Record = InterfaceRecord;
+
+    std::string_view name() const;
+    uint32_t version() const
+    {
+        return record->version;
+    }
+    ViewList<Message> requests() const;
+    ViewList<Message> events() const;
+    ViewList<Enum> enums() const;
+    Doc doc() const;
+
+    const Protocol *protocol;
+    const Record *record;
 };
 
+/*
+ * Move-only: a protocol is parsed once and then shared by pointer
+ */
 struct Protocol
 {
-    std::string name;
-    std::vector<Interface> interfaces;
+    Protocol() : Protocol{std::pmr::get_default_resource()}
+    {
+    }
+
+    explicit Protocol(std::pmr::memory_resource *resource)
+        : strings{resource}, interface_records{resource},
+          request_records{resource}, event_records{resource},
+          arg_records{resource}, enum_records{resource},
+          entry_records{resource}, doc_records{resource}
+    {
+    }
+
+    Protocol(Protocol &&) = default;
+    Protocol &operator=(Protocol &&) = default;
+    Protocol(const Protocol &) = delete;
+    Protocol &operator=(const Protocol &) = delete;
+
+    std::string_view name() const
+    {
+        return strings.get(name_id);
+    }
+
+    ViewList<Interface> interfaces() const
+    {
+        return {this, interface_records};
+    }
+
+    std::string_view str(StringId id) const
+    {
+        return strings.get(id);
+    }
+
+    Doc doc() const
+    {
+        return doc_of(doc_id);
+    }
+
+    Doc doc_of(uint32_t id) const
+    {
+        if (id == no_doc) {
+            return Doc{this, nullptr};
+        }
+        return Doc{this, &doc_records[id]};
+    }
+
+    /*
+     * Raw XML content of the <copyright> element
+     */
+    std::optional<std::string_view> copyright_xml() const
+    {
+        return source_text(copyright);
+    }
+
+    std::optional<std::string_view>
+        source_text(const std::optional<TextRange> &range) const
+    {
+        if (!range) {
+            return std::nullopt;
+        }
+        return source.xml.substr(range->first, range->size);
+    }
+
+    /*
+     * Heap bytes held by the tables, for memory accounting
+     */
+    size_t allocated_bytes() const
+    {
+        auto table_bytes = [](const auto &table) {
+            using T = typename std::remove_cvref_t<decltype(table)>::value_type;
+            return table.capacity() * sizeof(T);
+        };
+        return strings.chars.capacity() + table_bytes(strings.ends) +
+               table_bytes(interface_records) + table_bytes(request_records) +
+               table_bytes(event_records) + table_bytes(arg_records) +
+               table_bytes(enum_records) + table_bytes(entry_records) +
+               table_bytes(doc_records);
+    }
+
+    StringArena strings;
+    StringId name_id = no_string;
+
+    std::pmr::vector<InterfaceRecord> interface_records;
+    std::pmr::vector<MessageRecord> request_records;
+    std::pmr::vector<MessageRecord> event_records;
+    std::pmr::vector<ArgRecord> arg_records;
+    std::pmr::vector<EnumRecord> enum_records;
+    std::pmr::vector<EntryRecord> entry_records;
+
+    /*
+     * Filled only when the protocol is parsed with documentation
+     */
+    std::pmr::vector<DocRecord> doc_records;
+    uint32_t doc_id = no_doc;
+    std::optional<TextRange> copyright;
+    ProtocolSource source;
 };
 
+template <typename ViewT, typename RecordT>
+ViewList<ViewT> make_view_list(
+    const Protocol *protocol,
+    const std::pmr::vector<RecordT> &table,
+    IndexRange range)
+{
+    return {protocol, std::span{table}.subspan(range.first, range.count)};
+}
+
+inline std::optional<std::string_view> Doc::summary() const
+{
+    if (record == nullptr || record->summary == no_string) {
+        return std::nullopt;
+    }
+    return protocol->str(record->summary);
+}
+
+inline std::optional<std::string_view> Doc::description_xml() const
+{
+    if (record == nullptr) {
+        return std::nullopt;
+    }
+    return protocol->source_text(record->description);
+}
+
+inline std::string_view Arg::name() const
+{
+    return protocol->str(record->name);
+}
+
+inline std::optional<std::string_view> Arg::interface_name() const
+{
+    if (record->interface_name == no_string) {
+        return std::nullopt;
+    }
+    return protocol->str(record->interface_name);
+}
+
+inline std::string_view Arg::enum_name() const
+{
+    return protocol->str(record->enum_name);
+}
+
+inline Doc Arg::doc() const
+{
+    return protocol->doc_of(record->doc);
+}
+
+inline std::string_view Message::name() const
+{
+    return protocol->str(record->name);
+}
+
+inline ViewList<Arg> Message::args() const
+{
+    return make_view_list<Arg>(protocol, protocol->arg_records, record->args);
+}
+
+inline Doc Message::doc() const
+{
+    return protocol->doc_of(record->doc);
+}
+
+inline std::string_view Enum::Entry::name() const
+{
+    return protocol->str(record->name);
+}
+
+inline Doc Enum::Entry::doc() const
+{
+    return protocol->doc_of(record->doc);
+}
+
+inline std::string_view Enum::name() const
+{
+    return protocol->str(record->name);
+}
+
+inline ViewList<Enum::Entry> Enum::entries() const
+{
+    return make_view_list<Enum::Entry>(
+        protocol, protocol->entry_records, record->entries);
+}
+
+inline Doc Enum::doc() const
+{
+    return protocol->doc_of(record->doc);
+}
+
+inline std::string_view Interface::name() const
+{
+    return protocol->str(record->name);
+}
+
+inline ViewList<Message> Interface::requests() const
+{
+    return make_view_list<Message>(
+        protocol, protocol->request_records, record->requests);
+}
+
+inline ViewList<Message> Interface::events() const
+{
+    return make_view_list<Message>(
+        protocol, protocol->event_records, record->events);
+}
+
+inline ViewList<Enum> Interface::enums() const
+{
+    return make_view_list<Enum>(
+        protocol, protocol->enum_records, record->enums);
+}
+
+inline Doc Interface::doc() const
+{
+    return protocol->doc_of(record->doc);
+}
+
 } // namespace types
 } // namespace wl_gena
@@ -0,0 +1,725 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <format>
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WL_GENA_X86 1
+#endif
+
+#include "XmlTokenizer.hh"
+
+namespace wl_gena {
+
+namespace {
+
+/*
+ * Scan kernels: the first byte in [first, last) equal to one of the four
+ * [bytes], last if there is none
+ */
+
+const char *
+    find_any_scalar(const char *first, const char *last, const char *bytes)
+{
+    for (; first != last; ++first) {
+        char c = *first;
+        if (c == bytes[0] || c == bytes[1] || c == bytes[2] ||
+            c == bytes[3]) {
+            return first;
+        }
+    }
+    return last;
+}
+
+#ifdef WL_GENA_X86
+[[gnu::target("sse2")]] const char *
+    find_any_sse2(const char *first, const char *last, const char *bytes)
+{
+    __m128i b0 = _mm_set1_epi8(bytes[0]);
+    __m128i b1 = _mm_set1_epi8(bytes[1]);
+    __m128i b2 = _mm_set1_epi8(bytes[2]);
+    __m128i b3 = _mm_set1_epi8(bytes[3]);
+
+    for (; last - first >= 16; first += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, b0), _mm_cmpeq_epi8(v, b1)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, b2), _mm_cmpeq_epi8(v, b3)));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+        if (mask != 0) {
+            return first + std::countr_zero(mask);
+        }
+    }
+    return find_any_scalar(first, last, bytes);
+}
+
+[[gnu::target("avx2")]] const char *
+    find_any_avx2(const char *first, const char *last, const char *bytes)
+{
+    __m256i b0 = _mm256_set1_epi8(bytes[0]);
+    __m256i b1 = _mm256_set1_epi8(bytes[1]);
+    __m256i b2 = _mm256_set1_epi8(bytes[2]);
+    __m256i b3 = _mm256_set1_epi8(bytes[3]);
+
+    for (; last - first >= 32; first += 32) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, b0), _mm256_cmpeq_epi8(v, b1)),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, b2), _mm256_cmpeq_epi8(v, b3)));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return first + std::countr_zero(mask);
+        }
+    }
+    return find_any_sse2(first, last, bytes);
+}
+#endif
+
+std::string_view scan_isa_name(ScanIsa isa)
+{
+    switch (isa) {
+    case ScanIsa::scalar:
+        return "scalar";
+    case ScanIsa::sse2:
+        return "sse2";
+    case ScanIsa::avx2:
+        return "avx2";
+    }
+    throw std::logic_error{"Unknown scan isa"};
+}
+
+auto find_any_kernel(ScanIsa isa)
+    -> const char *(*)(const char *, const char *, const char *)
+{
+    if (!scan_isa_supported(isa)) {
+        std::string message = std::format(
+            "{} scanning is not supported by this CPU", scan_isa_name(isa));
+        throw std::runtime_error(std::move(message));
+    }
+
+    switch (isa) {
+    case ScanIsa::scalar:
+        return find_any_scalar;
+#ifdef WL_GENA_X86
+    case ScanIsa::sse2:
+        return find_any_sse2;
+    case ScanIsa::avx2:
+        return find_any_avx2;
+#else
+    default:
+        break;
+#endif
+    }
+    throw std::logic_error{"Unknown scan isa"};
+}
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*
+ * Non-ASCII bytes are accepted as is, protocol names are ASCII anyway
+ */
+bool is_name_char(char c)
+{
+    auto u = static_cast<unsigned char>(c);
+    return u >= 0x80 || (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') ||
+           (u >= '0' && u <= '9') || u == '_' || u == '-' || u == '.' ||
+           u == ':';
+}
+
+bool is_xml_char(uint32_t code)
+{
+    return code == 0x9 || code == 0xA || code == 0xD ||
+           (code >= 0x20 && code <= 0xD7FF) ||
+           (code >= 0xE000 && code <= 0xFFFD) ||
+           (code >= 0x10000 && code <= 0x10FFFF);
+}
+
+void append_utf8(std::pmr::string &out, char32_t code)
+{
+    auto byte = [](uint32_t bits) { return static_cast<char>(bits); };
+
+    if (code < 0x80) {
+        out += byte(code);
+    } else if (code < 0x800) {
+        out += byte(0xC0 | (code >> 6));
+        out += byte(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += byte(0xE0 | (code >> 12));
+        out += byte(0x80 | ((code >> 6) & 0x3F));
+        out += byte(0x80 | (code & 0x3F));
+    } else {
+        out += byte(0xF0 | (code >> 18));
+        out += byte(0x80 | ((code >> 12) & 0x3F));
+        out += byte(0x80 | ((code >> 6) & 0x3F));
+        out += byte(0x80 | (code & 0x3F));
+    }
+}
+
+/*
+ * Longest reference looked at before giving up on finding its ';'
+ */
+constexpr size_t max_reference_size = 32;
+
+constexpr std::string_view byte_order_mark = "\xEF\xBB\xBF";
+constexpr std::string_view comment_open = "<!--";
+constexpr std::string_view cdata_open = "<![CDATA[";
+constexpr std::string_view doctype_open = "<!DOCTYPE";
+
+constexpr const char *invalid_token = "not well-formed (invalid token)";
+
+} // namespace
+
+bool scan_isa_supported(ScanIsa isa)
+{
+    switch (isa) {
+    case ScanIsa::scalar:
+        return true;
+#ifdef WL_GENA_X86
+    case ScanIsa::sse2:
+        return __builtin_cpu_supports("sse2");
+    case ScanIsa::avx2:
+        return __builtin_cpu_supports("avx2");
+#else
+    case ScanIsa::sse2:
+    case ScanIsa::avx2:
+        return false;
+#endif
+    }
+    return false;
+}
+
+ScanIsa best_scan_isa()
+{
+    for (ScanIsa isa : {ScanIsa::avx2, ScanIsa::sse2}) {
+        if (scan_isa_supported(isa)) {
+            return isa;
+        }
+    }
+    return ScanIsa::scalar;
+}
+
+XmlTokenizer::XmlTokenizer(
+    Handlers handlers, ScanIsa isa, std::pmr::memory_resource *resource)
+    : _handlers{handlers}, _find_any{find_any_kernel(isa)},
+      _open_names{resource}, _open_ends{resource}, _attrs{resource},
+      _values{resource}, _text{resource}, _buffer{resource}
+{
+}
+
+void XmlTokenizer::parse(std::string_view data, bool is_final)
+{
+    if (_pending_first == _pending_last) {
+        data.remove_prefix(tokenize(data, is_final));
+        if (data.empty()) {
+            return;
+        }
+
+        std::ranges::copy(data, get_buffer(data.size()).begin());
+        _pending_last += data.size();
+        return;
+    }
+
+    std::ranges::copy(data, get_buffer(data.size()).begin());
+    parse_buffer(data.size(), is_final);
+}
+
+std::span<char> XmlTokenizer::get_buffer(size_t size)
+{
+    size_t pending = _pending_last - _pending_first;
+    if (_pending_first != 0) {
+        std::copy(
+            _buffer.begin() + _pending_first,
+            _buffer.begin() + _pending_last,
+            _buffer.begin());
+        _pending_first = 0;
+        _pending_last = pending;
+    }
+
+    if (_buffer.size() < pending + size) {
+        _buffer.resize(pending + size);
+    }
+    return std::span{_buffer}.subspan(pending, size);
+}
+
+void XmlTokenizer::parse_buffer(size_t size, bool is_final)
+{
+    _pending_last += size;
+    std::string_view pending{
+        _buffer.data() + _pending_first, _pending_last - _pending_first};
+    _pending_first += tokenize(pending, is_final);
+}
+
+size_t XmlTokenizer::tokenize(std::string_view data, bool is_final)
+{
+    _chunk = data.data();
+    const char *first = data.data();
+    const char *last = data.data() + data.size();
+
+    if (_at_document_start) {
+        if (data.starts_with(byte_order_mark)) {
+            first += byte_order_mark.size();
+        } else if (!is_final && byte_order_mark.starts_with(data)) {
+            return 0;
+        }
+        _at_document_start = false;
+    }
+
+    while (first != last) {
+        const char *next =
+            *first == '<' ? markup(first, last) : text(first, last);
+        if (next == nullptr) {
+            break;
+        }
+        first = next;
+    }
+
+    if (is_final) {
+        if (first != last) {
+            fail(first, "unclosed token");
+        }
+        if (!_root_closed) {
+            fail(last, "no element found");
+        }
+    }
+
+    _offset += first - data.data();
+    _line += std::count(data.data(), first, '\n');
+    return first - data.data();
+}
+
+/*
+ * Character data up to the next markup, or one reference
+ */
+const char *XmlTokenizer::text(const char *first, const char *last)
+{
+    if (*first != '&') {
+        const char *stop = _find_any(first, last, "<&<&");
+        std::string_view run{first, stop};
+        if (_open_ends.empty()) {
+            check_outside_root(run);
+        } else {
+            emit_data(run);
+        }
+        return stop;
+    }
+
+    char32_t code = 0;
+    const char *reference_last = reference(first, last, code);
+    if (reference_last == nullptr) {
+        return nullptr;
+    }
+    if (_open_ends.empty()) {
+        fail(
+            first,
+            _root_closed ? "junk after document element" : invalid_token);
+    }
+
+    if (_handlers.data != nullptr) {
+        _text.clear();
+        append_utf8(_text, code);
+        _after_cr = false;
+        _handlers.data(_handlers.user_data, _text);
+    }
+    return reference_last;
+}
+
+const char *XmlTokenizer::markup(const char *first, const char *last)
+{
+    if (last - first < 2) {
+        return nullptr;
+    }
+
+    std::string_view rest{first, last};
+    switch (first[1]) {
+    case '/':
+        return end_tag(first, last);
+    case '?': {
+        size_t close = rest.find("?>", 2);
+        if (close == rest.npos) {
+            return nullptr;
+        }
+        scan_name(first + 2, first + close);
+        return first + close + 2;
+    }
+    case '!':
+        break;
+    default:
+        return start_tag(first, last);
+    }
+
+    if (rest.starts_with(comment_open)) {
+        size_t close = rest.find("-->", comment_open.size());
+        if (close == rest.npos) {
+            return nullptr;
+        }
+        return first + close + 3;
+    }
+
+    if (rest.starts_with(cdata_open)) {
+        if (_open_ends.empty()) {
+            fail(first, invalid_token);
+        }
+        size_t close = rest.find("]]>", cdata_open.size());
+        if (close == rest.npos) {
+            return nullptr;
+        }
+        emit_data(rest.substr(cdata_open.size(), close - cdata_open.size()));
+        return first + close + 3;
+    }
+
+    if (rest.starts_with(doctype_open)) {
+        fail(first, "DOCTYPE is not supported");
+    }
+
+    bool may_be_cut = comment_open.starts_with(rest) ||
+                      cdata_open.starts_with(rest) ||
+                      doctype_open.starts_with(rest);
+    if (may_be_cut) {
+        return nullptr;
+    }
+    fail(first, invalid_token);
+}
+
+const char *XmlTokenizer::start_tag(const char *first, const char *last)
+{
+    /* The closing '>', quoted values may hold one as well */
+    const char *close = first + 1;
+    while (true) {
+        close = _find_any(close, last, ">\"'>");
+        if (close == last) {
+            return nullptr;
+        }
+        if (*close == '>') {
+            break;
+        }
+        const char *quote_close = std::find(close + 1, last, *close);
+        if (quote_close == last) {
+            return nullptr;
+        }
+        close = quote_close + 1;
+    }
+
+    if (_root_closed) {
+        fail(first, "junk after document element");
+    }
+
+    const char *p = first + 1;
+    const char *name_last = scan_name(p, close);
+    std::string_view name{p, name_last};
+    p = name_last;
+
+    auto skip_space = [&p, close]() {
+        while (p != close && is_space(*p)) {
+            ++p;
+        }
+    };
+
+    _attrs.clear();
+    _values.clear();
+    /* Decoded values are never longer than the tag, so views stay valid */
+    _values.reserve(close - first);
+
+    bool is_empty_element = false;
+    while (true) {
+        const char *space_first = p;
+        skip_space();
+        if (p == close) {
+            break;
+        }
+        if (*p == '/') {
+            if (p + 1 != close) {
+                fail(p, invalid_token);
+            }
+            is_empty_element = true;
+            break;
+        }
+        if (p == space_first) {
+            fail(p, invalid_token);
+        }
+
+        const char *key_last = scan_name(p, close);
+        std::string_view key{p, key_last};
+        p = key_last;
+
+        skip_space();
+        if (p == close || *p != '=') {
+            fail(p, invalid_token);
+        }
+        ++p;
+        skip_space();
+        if (p == close || (*p != '"' && *p != '\'')) {
+            fail(p, invalid_token);
+        }
+
+        const char *value_last = std::find(p + 1, close, *p);
+        if (value_last == close) {
+            fail(p, invalid_token);
+        }
+        std::string_view value = attribute_value(p + 1, value_last);
+        p = value_last + 1;
+
+        for (const XmlAttribute &attr : _attrs) {
+            if (attr.key == key) {
+                fail(key.data(), "duplicate attribute");
+            }
+        }
+        _attrs.push_back(XmlAttribute{key, value});
+    }
+
+    _open_names.append(name);
+    _open_ends.push_back(_open_names.size());
+
+    _handlers.start(
+        _handlers.user_data, name, _attrs, span(first, close + 1));
+    if (is_empty_element) {
+        _handlers.end(_handlers.user_data, name, span(close + 1, close + 1));
+        close_element();
+    }
+    return close + 1;
+}
+
+const char *XmlTokenizer::end_tag(const char *first, const char *last)
+{
+    const char *close = std::find(first + 2, last, '>');
+    if (close == last) {
+        return nullptr;
+    }
+
+    const char *name_last = scan_name(first + 2, close);
+    for (const char *p = name_last; p != close; ++p) {
+        if (!is_space(*p)) {
+            fail(p, invalid_token);
+        }
+    }
+
+    if (_open_ends.empty()) {
+        fail(first, invalid_token);
+    }
+
+    std::string_view name{first + 2, name_last};
+    size_t open_first = _open_ends.size() == 1 ? 0 : _open_ends.end()[-2];
+    std::string_view open_name = std::string_view{_open_names}.substr(
+        open_first, _open_ends.back() - open_first);
+    if (name != open_name) {
+        fail(first, "mismatched tag");
+    }
+
+    _handlers.end(_handlers.user_data, name, span(first, close + 1));
+    close_element();
+    return close + 1;
+}
+
+/*
+ * Replaces references and normalizes whitespace the way XML requires
+ * for CDATA attributes, in place into _values
+ */
+std::string_view
+    XmlTokenizer::attribute_value(const char *first, const char *last)
+{
+    std::string_view raw{first, last};
+    if (raw.find_first_of("&<\t\n\r") == raw.npos) {
+        return raw;
+    }
+
+    size_t value_first = _values.size();
+    const char *p = first;
+    while (p != last) {
+        char c = *p;
+        if (c == '<') {
+            fail(p, invalid_token);
+        }
+
+        if (c == '&') {
+            char32_t code = 0;
+            p = reference(p, last, code);
+            if (p == nullptr) {
+                fail(first, "undefined entity");
+            }
+            append_utf8(_values, code);
+            continue;
+        }
+
+        if (c == '\r' && p + 1 != last && p[1] == '\n') {
+            ++p;
+        }
+        _values += is_space(c) ? ' ' : c;
+        ++p;
+    }
+
+    return std::string_view{_values}.substr(value_first);
+}
+
+/*
+ * Decodes the reference at [first] into [code], returns its end or
+ * nullptr when its ';' is not there yet
+ */
+const char *XmlTokenizer::reference(
+    const char *first, const char *last, char32_t &code) const
+{
+    const char *bound = static_cast<size_t>(last - first) > max_reference_size
+                            ? first + max_reference_size
+                            : last;
+    const char *semicolon = std::find(first + 1, bound, ';');
+    if (semicolon == bound) {
+        if (bound == last) {
+            return nullptr;
+        }
+        fail(first, "undefined entity");
+    }
+
+    std::string_view name{first + 1, semicolon};
+    if (name == "lt") {
+        code = '<';
+    } else if (name == "gt") {
+        code = '>';
+    } else if (name == "amp") {
+        code = '&';
+    } else if (name == "quot") {
+        code = '"';
+    } else if (name == "apos") {
+        code = '\'';
+    } else if (name.starts_with('#')) {
+        std::string_view digits = name.substr(1);
+        int base = 10;
+        if (digits.starts_with('x')) {
+            digits.remove_prefix(1);
+            base = 16;
+        }
+
+        uint32_t value = 0;
+        auto status = std::from_chars(
+            digits.data(), digits.data() + digits.size(), value, base);
+        bool is_valid = !digits.empty() && status.ec == std::errc{} &&
+                        status.ptr == digits.data() + digits.size() &&
+                        is_xml_char(value);
+        if (!is_valid) {
+            fail(first, "reference to invalid character number");
+        }
+        code = value;
+    } else {
+        fail(first, "undefined entity");
+    }
+
+    return semicolon + 1;
+}
+
+const char *XmlTokenizer::scan_name(const char *first, const char *last) const
+{
+    const char *p = first;
+    while (p != last && is_name_char(*p)) {
+        ++p;
+    }
+
+    bool is_valid = p != first && !(*first >= '0' && *first <= '9') &&
+                    *first != '-' && *first != '.';
+    if (!is_valid) {
+        fail(first, invalid_token);
+    }
+    return p;
+}
+
+void XmlTokenizer::close_element()
+{
+    _open_ends.pop_back();
+    _open_names.resize(_open_ends.empty() ? 0 : _open_ends.back());
+    if (_open_ends.empty()) {
+        _root_closed = true;
+    }
+}
+
+XmlSpan XmlTokenizer::span(const char *first, const char *last) const
+{
+    return XmlSpan{_offset + (first - _chunk), size_t(last - first)};
+}
+
+/*
+ * Reports character data with line ends normalized to "\n"
+ */
+void XmlTokenizer::emit_data(std::string_view data)
+{
+    if (_handlers.data == nullptr || data.empty()) {
+        return;
+    }
+
+    bool skip_lf = _after_cr && data.front() == '\n';
+    _after_cr = false;
+    if (!skip_lf && data.find('\r') == data.npos) {
+        _handlers.data(_handlers.user_data, data);
+        return;
+    }
+
+    _text.clear();
+    for (char c : data.substr(skip_lf ? 1 : 0)) {
+        if (c == '\n' && _after_cr) {
+            _after_cr = false;
+            continue;
+        }
+        _after_cr = c == '\r';
+        _text += _after_cr ? '\n' : c;
+    }
+    if (!_text.empty()) {
+        _handlers.data(_handlers.user_data, _text);
+    }
+}
+
+void XmlTokenizer::check_outside_root(std::string_view data) const
+{
+    for (const char &c : data) {
+        if (!is_space(c)) {
+            fail(
+                &c,
+                _root_closed ? "junk after document element" : invalid_token);
+        }
+    }
+}
+
+void XmlTokenizer::fail(const char *at, std::string_view what) const
+{
+    size_t line = _line + std::count(_chunk, at, '\n');
+    std::string message =
+        std::format("XML tokenizer error: ({}) at line {}", what, line);
+    throw std::runtime_error(std::move(message));
+}
+
+std::string decode_character_data(std::string_view xml)
+{
+    std::string out;
+
+    XmlTokenizer::Handlers handlers{};
+    handlers.user_data = &out;
+    handlers.start = [](void *,
+                        std::string_view,
+                        std::span<const XmlAttribute>,
+                        XmlSpan) {};
+    handlers.data = [](void *user_data, std::string_view data) {
+        static_cast<std::string *>(user_data)->append(data);
+    };
+    handlers.end = [](void *, std::string_view, XmlSpan) {};
+
+    /* Content alone is not a document, so wrap it into one */
+    XmlTokenizer tokenizer{
+        handlers, best_scan_isa(), std::pmr::get_default_resource()};
+    tokenizer.parse("<content>", false);
+    tokenizer.parse(xml, false);
+    tokenizer.parse("</content>", true);
+
+    return out;
+}
+
+} // namespace wl_gena
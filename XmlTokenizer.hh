@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wl_gena {
+
+struct XmlAttribute
+{
+    std::string_view key;
+    std::string_view value;
+};
+
+/*
+ * Bytes of a tag, counted from the start of the document
+ */
+struct XmlSpan
+{
+    size_t first = 0;
+    size_t size = 0;
+};
+
+/*
+ * Instruction sets the tokenizer can look for markup bytes with
+ */
+enum class ScanIsa
+{
+    scalar,
+    sse2,
+    avx2,
+};
+
+bool scan_isa_supported(ScanIsa isa);
+
+/*
+ * Widest instruction set the running CPU supports
+ */
+ScanIsa best_scan_isa();
+
+/*
+ * Hand-written tokenizer for the XML subset protocol files are written in:
+ * elements, attributes, character data, the predefined and numeric
+ * entities, comments, CDATA sections and processing instructions. A
+ * DOCTYPE is rejected
+ *
+ * Markup bytes are looked for with SIMD compares, so text that nobody
+ * listens to (descriptions) is skipped a vector at a time
+ *
+ * Reports the same start / data / end events expat does, with attribute
+ * values and character data normalized the same way. Names and values
+ * passed to the handlers are valid only during the call
+ */
+struct XmlTokenizer
+{
+    struct Handlers
+    {
+        void *user_data = nullptr;
+        void (*start)(
+            void *user_data,
+            std::string_view name,
+            std::span<const XmlAttribute> attrs,
+            XmlSpan tag) = nullptr;
+        /*
+         * May be null, character data is then only checked
+         */
+        void (*data)(void *user_data, std::string_view data) = nullptr;
+        /*
+         * An empty-element tag ends with an empty span right after it
+         */
+        void (*end)(
+            void *user_data, std::string_view name, XmlSpan tag) = nullptr;
+    };
+
+    XmlTokenizer(
+        Handlers handlers, ScanIsa isa, std::pmr::memory_resource *resource);
+
+    /*
+     * Tokenizes the next piece of the document; a token split between
+     * pieces is kept until the rest of it arrives
+     */
+    void parse(std::string_view data, bool is_final);
+
+    /*
+     * Room for the next [size] bytes of the document, to be filled and
+     * handed over with parse_buffer(), saves a copy of each piece
+     */
+    std::span<char> get_buffer(size_t size);
+    void parse_buffer(size_t size, bool is_final);
+
+  private:
+    size_t tokenize(std::string_view data, bool is_final);
+
+    const char *text(const char *first, const char *last);
+    const char *markup(const char *first, const char *last);
+    const char *start_tag(const char *first, const char *last);
+    const char *end_tag(const char *first, const char *last);
+    std::string_view attribute_value(const char *first, const char *last);
+    const char *
+        reference(const char *first, const char *last, char32_t &code) const;
+    const char *scan_name(const char *first, const char *last) const;
+    void close_element();
+    XmlSpan span(const char *first, const char *last) const;
+
+    void emit_data(std::string_view data);
+    void check_outside_root(std::string_view data) const;
+
+    [[noreturn]] void fail(const char *at, std::string_view what) const;
+
+    using FindAny =
+        const char *(*)(const char *first, const char *last, const char *bytes);
+
+    Handlers _handlers;
+    FindAny _find_any;
+
+    /*
+     * Names of the open elements back to back
+     */
+    std::pmr::string _open_names;
+    std::pmr::vector<uint32_t> _open_ends;
+    bool _root_closed = false;
+
+    std::pmr::vector<XmlAttribute> _attrs;
+    std::pmr::string _values;
+    std::pmr::string _text;
+    bool _after_cr = false;
+
+    /*
+     * Start of the bytes being tokenized, and the document offset and
+     * line they start at
+     */
+    const char *_chunk = nullptr;
+    size_t _offset = 0;
+    size_t _line = 1;
+    bool _at_document_start = true;
+
+    std::pmr::vector<char> _buffer;
+    size_t _pending_first = 0;
+    size_t _pending_last = 0;
+};
+
+/*
+ * Character data of raw element content as a data handler would get it:
+ * references replaced, CDATA sections unwrapped, comments and processing
+ * instructions dropped, line ends normalized. Text of nested elements is
+ * included
+ */
+std::string decode_character_data(std::string_view xml);
+
+} // namespace wl_gena
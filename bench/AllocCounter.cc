@@ -0,0 +1,64 @@
+#include <atomic>
+
+#include <cstddef>
+
+#include "AllocCounter.hh"
+#include "AllocStats.hh"
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocated_bytes{0};
+std::atomic<size_t> live_bytes{0};
+std::atomic<size_t> peak_live_bytes{0};
+
+void raise_peak(size_t live)
+{
+    size_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(
+                              peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void count_alloc(size_t usable_size, size_t requested_size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(requested_size, std::memory_order_relaxed);
+    raise_peak(
+        live_bytes.fetch_add(usable_size, std::memory_order_relaxed) +
+        usable_size);
+}
+
+void count_free(size_t usable_size)
+{
+    live_bytes.fetch_sub(usable_size, std::memory_order_relaxed);
+}
+
+constexpr wl_gena::AllocObserver counter{count_alloc, count_free};
+
+struct ObserveAllocations
+{
+    ObserveAllocations()
+    {
+        wl_gena::set_alloc_observer(&counter);
+    }
+} observe_allocations;
+
+} // namespace
+
+wl_gena::bench::AllocStats wl_gena::bench::alloc_stats()
+{
+    AllocStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.bytes = allocated_bytes.load(std::memory_order_relaxed);
+    stats.live_bytes = live_bytes.load(std::memory_order_relaxed);
+    stats.peak_live_bytes = peak_live_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void wl_gena::bench::reset_alloc_peak()
+{
+    peak_live_bytes.store(
+        live_bytes.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+namespace wl_gena::bench {
+
+/*
+ * Counters of every thread, kept by the AllocObserver in AllocCounter.cc
+ * from what the operator new replacement of AllocHooks.cc and the expat
+ * allocator report
+ *
+ * Live bytes are counted in usable sizes (malloc_usable_size), the peak
+ * is the most live bytes since the last reset_alloc_peak()
+ */
+struct AllocStats
+{
+    size_t allocations = 0;
+    size_t bytes = 0;
+    size_t live_bytes = 0;
+    size_t peak_live_bytes = 0;
+};
+
+AllocStats alloc_stats();
+
+/*
+ * Lowers the peak to the bytes live now
+ */
+void reset_alloc_peak();
+
+} // namespace wl_gena::bench
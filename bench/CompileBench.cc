@@ -0,0 +1,683 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Corpus.hh"
+#include "File.hh"
+#include "HeaderGena.hh"
+#include "Parser.hh"
+#include "Report.hh"
+
+/*
+ * What generated headers cost downstream builds
+ *
+ * For every protocol of the corpus and every variant of the generated
+ * code (plain, with dispatchers, with array marshalling, for a static
+ * client library, with wire encoders and decoders) a header is
+ * generated, and a translation unit that includes it, defines stub
+ * traits and explicitly instantiates rtti and every interface with
+ * them. Member templates are not instantiated with their class, so the
+ * unit also hands out the address of every add_dispatcher with a
+ * handler of every event, every wire encoder with the wire_buffer_t of
+ * its protocol and every decode_event with a handler of any event, so
+ * that all of the emitted templates are compiled. Each unit is compiled
+ * a few times, the least CPU time of the compiler is reported
+ *
+ * The compiler is the one the build was configured with
+ * (WL_GENA_BENCH_CXX), or --cxx. A compiler that defines __clang__ is
+ * asked for -ftime-trace, any other one for -ftime-report; the trace or
+ * report of every unit is kept next to it in the output directory
+ *
+ * The corpus is chosen as for wl_gena.bench, and --json / --baseline /
+ * --threshold work the same way, per protocol and variant
+ *
+ * usage: wl_gena.bench_compile [--corpus <dir>] [--out <dir>]
+ *                              [--cxx <compiler>] [--passes <n>]
+ *                              [--json <file>] [--baseline <file>]
+ *                              [--threshold <percent>]
+ */
+
+#ifndef WL_GENA_BENCH_CORPUS
+#define WL_GENA_BENCH_CORPUS ""
+#endif
+
+#ifndef WL_GENA_BENCH_CXX
+#define WL_GENA_BENCH_CXX "c++"
+#endif
+
+extern char **environ;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using wl_gena::bench::Corpus;
+using wl_gena::bench::json_string;
+using wl_gena::bench::JsonValue;
+
+/*
+ * Everything the generated templates of every variant ask of their
+ * traits, declared only as far as compiling them needs. The library
+ * functions are static, which suits calls through an instance as well
+ * as the static library variant
+ */
+constexpr std::string_view stub_traits = R"(#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+struct wl_array;
+
+namespace bench_stub {
+
+struct wl_object;
+struct wl_proxy;
+struct wl_display;
+struct wl_interface;
+
+union wl_argument {
+    int32_t i;
+    uint32_t u;
+    int32_t f;
+    const char *s;
+    wl_object *o;
+    uint32_t n;
+    wl_array *a;
+    int32_t h;
+};
+
+struct wl_message
+{
+    const char *name;
+    const char *signature;
+    const wl_interface **types;
+};
+
+struct wl_interface
+{
+    const char *name;
+    int version;
+    int method_count;
+    const wl_message *methods;
+    int event_count;
+    const wl_message *events;
+};
+
+struct client_library
+{
+    static wl_proxy *wl_proxy_marshal_flags(
+        wl_proxy *, uint32_t, const wl_interface *, uint32_t, uint32_t, ...);
+    static wl_proxy *wl_proxy_marshal_array_flags(
+        wl_proxy *,
+        uint32_t,
+        const wl_interface *,
+        uint32_t,
+        uint32_t,
+        wl_argument *);
+    static int wl_proxy_add_listener(wl_proxy *, void (**)(void), void *);
+    static int wl_proxy_add_dispatcher(
+        wl_proxy *,
+        int (*)(const void *, void *, uint32_t, const wl_message *,
+                wl_argument *),
+        const void *,
+        void *);
+    static uint32_t wl_proxy_get_version(wl_proxy *);
+    static void wl_proxy_destroy(wl_proxy *);
+};
+
+/*
+ * Takes what the compiler cannot see through, so that the functions
+ * whose addresses it gets are emitted and not only instantiated
+ */
+template <typename T>
+void keep(T);
+
+struct traits
+{
+    using wl_proxy_t = wl_proxy;
+    using wl_display_t = wl_display;
+    using wl_interface_t = wl_interface;
+    using wl_message_t = wl_message;
+    using wl_argument_t = wl_argument;
+    using client_library_t = client_library;
+};
+
+} // namespace bench_stub
+)";
+
+/*
+ * Generation options whose output is compiled separately
+ */
+struct Variant
+{
+    std::string_view name;
+    bool dispatchers = false;
+    bool array_marshalling = false;
+    bool static_library = false;
+    bool wire = false;
+};
+
+constexpr std::array<Variant, 5> variants{{
+    {.name = "plain"},
+    {.name = "dispatchers", .dispatchers = true},
+    {.name = "array_marshalling", .array_marshalling = true},
+    {.name = "static_library", .static_library = true},
+    {.name = "wire", .wire = true},
+}};
+
+struct Options
+{
+    std::string corpus_dir = WL_GENA_BENCH_CORPUS;
+    std::string out_dir = "wl_gena.bench_compile";
+    std::string cxx = WL_GENA_BENCH_CXX;
+    size_t passes = 3;
+    std::optional<std::string> json_file;
+    std::optional<std::string> baseline_file;
+    double threshold = 10;
+};
+
+Options parse_options(int argc, char **argv)
+{
+    Options o;
+    for (int arg_i = 1; arg_i != argc; ++arg_i) {
+        std::string_view arg = argv[arg_i];
+        if (arg_i + 1 == argc) {
+            throw std::runtime_error{
+                std::format("Option [{}] needs a value", arg)};
+        }
+        std::string value = argv[++arg_i];
+
+        if (arg == "--corpus") {
+            o.corpus_dir = value;
+        } else if (arg == "--out") {
+            o.out_dir = value;
+        } else if (arg == "--cxx") {
+            o.cxx = value;
+        } else if (arg == "--passes") {
+            o.passes = std::max<size_t>(1, std::stoul(value));
+        } else if (arg == "--json") {
+            o.json_file = value;
+        } else if (arg == "--baseline") {
+            o.baseline_file = value;
+        } else if (arg == "--threshold") {
+            o.threshold = std::stod(value);
+        } else {
+            throw std::runtime_error{std::format(
+                "Unknown option [{}]\n"
+                "usage: wl_gena.bench_compile [--corpus <dir>] [--out <dir>] "
+                "[--cxx <compiler>] [--passes <n>] [--json <file>] "
+                "[--baseline <file>] [--threshold <percent>]",
+                arg)};
+        }
+    }
+    return o;
+}
+
+/*
+ * Header of every protocol in [variant], with the protocols it needs as
+ * context; returns the names of the headers without extension
+ */
+std::vector<std::string> generate_headers(
+    const Corpus &corpus, const Variant &variant, const fs::path &out_dir)
+{
+    std::vector<std::shared_ptr<const wl_gena::types::Protocol>> protocols;
+    for (const std::string &file : corpus.files) {
+        wl_gena::InputFile input{file};
+        auto protocol_op = wl_gena::parse_protocol(input.view());
+        if (!protocol_op) {
+            throw std::runtime_error{
+                std::format("{}: {}", file, protocol_op.error())};
+        }
+        protocols.push_back(std::make_shared<const wl_gena::types::Protocol>(
+            std::move(protocol_op.value())));
+    }
+
+    std::vector<std::string> names;
+    for (size_t file_i = 0; file_i != protocols.size(); ++file_i) {
+        wl_gena::GenerateHeaderInput I;
+        I.protocol = protocols[file_i];
+        for (size_t context_i : corpus.contexts[file_i]) {
+            I.context_protocols.push_back(protocols[context_i]);
+        }
+        I.dispatchers = variant.dispatchers;
+        I.array_marshalling = variant.array_marshalling;
+        I.static_library = variant.static_library;
+        I.wire_encoders = variant.wire;
+        I.wire_decoders = variant.wire;
+
+        std::string name = std::format(
+            "{}.{}",
+            fs::path{corpus.files[file_i]}.stem().string(),
+            variant.name);
+        wl_gena::write_file_if_changed(
+            (out_dir / (name + ".hh")).string(),
+            wl_gena::generate_header(I).output);
+        names.push_back(std::move(name));
+    }
+    return names;
+}
+
+/*
+ * Contexts of contexts are needed too, in the order they depend on each
+ * other
+ */
+void add_includes(
+    const Corpus &corpus,
+    size_t file_i,
+    std::vector<size_t> &order,
+    std::set<size_t> &seen)
+{
+    if (!seen.insert(file_i).second) {
+        return;
+    }
+    for (size_t context_i : corpus.contexts[file_i]) {
+        add_includes(corpus, context_i, order, seen);
+    }
+    order.push_back(file_i);
+}
+
+std::string translation_unit(
+    const Corpus &corpus,
+    const Variant &variant,
+    const std::vector<std::string> &names,
+    size_t file_i)
+{
+    std::vector<size_t> order;
+    std::set<size_t> seen;
+    add_includes(corpus, file_i, order, seen);
+
+    std::string o{stub_traits};
+    o += '\n';
+    for (size_t include_i : order) {
+        std::format_to(
+            std::back_inserter(o), "#include \"{}.hh\"\n", names[include_i]);
+    }
+    o += '\n';
+
+    wl_gena::InputFile input{corpus.files[file_i]};
+    auto protocol_op = wl_gena::parse_protocol(input.view());
+    if (!protocol_op) {
+        throw std::runtime_error{protocol_op.error()};
+    }
+    const wl_gena::types::Protocol &protocol = protocol_op.value();
+
+    auto out = std::back_inserter(o);
+    std::format_to(
+        out,
+        "template struct {}::rtti<bench_stub::traits>;\n",
+        protocol.name());
+    for (wl_gena::types::Interface iface : protocol.interfaces()) {
+        std::format_to(
+            out,
+            "template struct {}::{}<bench_stub::traits>;\n",
+            protocol.name(),
+            iface.name());
+    }
+
+    // Taking the address instantiates a member function template
+    if (variant.dispatchers) {
+        std::set<std::string_view> event_names;
+        for (wl_gena::types::Interface iface : protocol.interfaces()) {
+            for (wl_gena::types::Message event : iface.events()) {
+                event_names.insert(event.name());
+            }
+        }
+        o += "\nstruct any_handler\n{\n";
+        for (std::string_view name : event_names) {
+            std::format_to(
+                out,
+                "    template <typename... args_t>\n"
+                "    void {}(args_t...) {{}}\n",
+                name);
+        }
+        o += "};\n";
+        o += "\nvoid instantiate_dispatchers()\n{\n";
+        for (wl_gena::types::Interface iface : protocol.interfaces()) {
+            if (iface.events().empty()) {
+                continue;
+            }
+            std::format_to(
+                out,
+                "    bench_stub::keep(&{}::{}<bench_stub::traits>::template "
+                "add_dispatcher<any_handler>);\n",
+                protocol.name(),
+                iface.name());
+        }
+        o += "}\n";
+    }
+
+    if (variant.wire) {
+        o += "\nstruct any_event\n{\n"
+             "    template <typename event_t>\n"
+             "    void operator()(const event_t &) {}\n"
+             "};\n";
+        o += "\nvoid instantiate_wire()\n{\n";
+        for (wl_gena::types::Interface iface : protocol.interfaces()) {
+            for (wl_gena::types::Message request : iface.requests()) {
+                std::format_to(
+                    out,
+                    "    bench_stub::keep("
+                    "&{0}::{1}_wire::{2}<{0}::wire_buffer_t>);\n",
+                    protocol.name(),
+                    iface.name(),
+                    request.name());
+            }
+            if (!iface.events().empty()) {
+                std::format_to(
+                    out,
+                    "    bench_stub::keep("
+                    "&{}::{}_wire::decode_event<any_event>);\n",
+                    protocol.name(),
+                    iface.name());
+            }
+        }
+        o += "}\n";
+    }
+    return o;
+}
+
+/*
+ * Exit status of [command], its diagnostics go to [stderr_file]. The
+ * CPU time (user and system) it took goes to [cpu_seconds] if given
+ */
+int run(
+    const std::vector<std::string> &command,
+    const std::string &stderr_file,
+    double *cpu_seconds = nullptr)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(
+        &actions,
+        STDERR_FILENO,
+        stderr_file.c_str(),
+        O_WRONLY | O_CREAT | O_TRUNC,
+        0666);
+
+    std::vector<char *> argv;
+    for (const std::string &arg : command) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = -1;
+    int rc =
+        posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0) {
+        throw std::runtime_error{
+            std::format("Cannot run [{}]: {}", command[0], std::strerror(rc))};
+    }
+
+    int status = 0;
+    struct rusage usage{};
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        throw std::runtime_error{
+            std::format("Cannot wait for [{}]", command[0])};
+    }
+
+    if (cpu_seconds) {
+        auto seconds = [](const timeval &tv) {
+            return double(tv.tv_sec) + double(tv.tv_usec) / 1e6;
+        };
+        *cpu_seconds = seconds(usage.ru_utime) + seconds(usage.ru_stime);
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/*
+ * CPU time (user and system) of the compiler
+ */
+double compile(
+    const std::vector<std::string> &command, const std::string &stderr_file)
+{
+    double cpu_seconds = 0;
+    if (run(command, stderr_file, &cpu_seconds) != 0) {
+        throw std::runtime_error{std::format(
+            "[{}] failed, see [{}]", command.back(), stderr_file)};
+    }
+    return cpu_seconds;
+}
+
+/*
+ * Asks the compiler itself rather than going by its name, c++ or a
+ * ccache wrapper may be either
+ */
+bool is_clang(const std::string &cxx, const fs::path &out_dir)
+{
+    fs::path probe = out_dir / "clang_probe.cc";
+    wl_gena::write_file_if_changed(
+        probe.string(),
+        "#ifndef __clang__\n"
+        "#error not clang\n"
+        "#endif\n");
+    return run({cxx, "-fsyntax-only", probe.string()},
+               (out_dir / "clang_probe.log").string()) == 0;
+}
+
+struct Result
+{
+    std::string name;
+    std::string_view variant;
+    size_t header_bytes = 0;
+    double cpu_seconds = 0;
+    double wall_seconds = 0;
+};
+
+std::string to_json(
+    const Options &options,
+    const Corpus &corpus,
+    const std::vector<Result> &results)
+{
+    std::string o = "{\n";
+    auto out = std::back_inserter(o);
+    std::format_to(
+        out,
+        "  \"corpus\": {},\n"
+        "  \"cxx\": {},\n"
+        "  \"passes\": {},\n"
+        "  \"protocols\": [\n",
+        json_string(corpus.description),
+        json_string(options.cxx),
+        options.passes);
+
+    for (size_t result_i = 0; result_i != results.size(); ++result_i) {
+        const Result &result = results[result_i];
+        std::format_to(
+            out,
+            "    {{\"name\": {}, \"variant\": {}, \"header_bytes\": {}, "
+            "\"cpu_seconds\": {:.4f}, \"wall_seconds\": {:.4f}}}{}\n",
+            json_string(result.name),
+            json_string(result.variant),
+            result.header_bytes,
+            result.cpu_seconds,
+            result.wall_seconds,
+            result_i + 1 != results.size() ? "," : "");
+    }
+    o += "  ]\n}\n";
+    return o;
+}
+
+/*
+ * Returns false if any protocol, in any variant, takes more than
+ * [threshold] percent longer to compile than in the baseline
+ */
+bool compare(
+    const std::vector<Result> &results,
+    const std::string &baseline_file,
+    double threshold)
+{
+    /*
+     * Keyed by "<name> <variant>"
+     */
+    std::unordered_map<std::string, double> baseline;
+    JsonValue root = wl_gena::bench::read_json_file(baseline_file);
+    try {
+        for (const JsonValue &protocol : root.at("protocols").as_array()) {
+            baseline.insert_or_assign(
+                std::format(
+                    "{} {}",
+                    protocol.at("name").as_string(),
+                    protocol.at("variant").as_string()),
+                protocol.at("cpu_seconds").as_number());
+        }
+    } catch (std::runtime_error &e) {
+        throw std::runtime_error{
+            std::format("Baseline [{}]: {}", baseline_file, e.what())};
+    }
+
+    bool ok = true;
+    std::cout << "\nagainst baseline, threshold " << threshold << "%:\n";
+    for (const Result &result : results) {
+        auto it =
+            baseline.find(std::format("{} {}", result.name, result.variant));
+        std::optional<double> base_seconds;
+        if (it != baseline.end()) {
+            base_seconds = it->second;
+        }
+        if (!base_seconds || base_seconds.value() <= 0) {
+            std::cout << std::format(
+                "{:>24} {:>18}: not in baseline\n",
+                result.name,
+                result.variant);
+            continue;
+        }
+
+        double change = 100 * (result.cpu_seconds / base_seconds.value() - 1);
+        bool slower = change > threshold;
+        std::cout << std::format(
+            "{:>24} {:>18}: {:+7.1f}% CPU time{}\n",
+            result.name,
+            result.variant,
+            change,
+            slower ? "  REGRESSION" : "");
+        ok = ok && !slower;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    Options options = parse_options(argc, argv);
+    wl_gena::bench::ScratchDir scratch;
+
+    Corpus corpus = wl_gena::bench::load_corpus(
+        options.corpus_dir, scratch.path / "corpus");
+
+    fs::path out_dir = fs::absolute(options.out_dir);
+    fs::create_directories(out_dir);
+
+    bool clang = is_clang(options.cxx, out_dir);
+
+    std::vector<Result> results;
+    for (const Variant &variant : variants) {
+        std::vector<std::string> names =
+            generate_headers(corpus, variant, out_dir);
+
+        for (size_t file_i = 0; file_i != corpus.files.size(); ++file_i) {
+            const std::string &name = names[file_i];
+            fs::path unit = out_dir / (name + ".cc");
+            fs::path object = out_dir / (name + ".o");
+            wl_gena::write_file_if_changed(
+                unit.string(),
+                translation_unit(corpus, variant, names, file_i));
+
+            std::vector<std::string> command = {
+                options.cxx,
+                "-std=c++20",
+                "-O2",
+                "-I",
+                out_dir.string(),
+                clang ? "-ftime-trace" : "-ftime-report",
+                "-c",
+                "-o",
+                object.string(),
+                unit.string(),
+            };
+            std::string stderr_file = (out_dir / (name + ".log")).string();
+
+            Result result;
+            result.name = fs::path{corpus.files[file_i]}.stem().string();
+            result.variant = variant.name;
+            result.header_bytes = fs::file_size(out_dir / (name + ".hh"));
+
+            for (size_t pass = 0; pass != options.passes; ++pass) {
+                auto start = std::chrono::steady_clock::now();
+                double cpu_seconds = compile(command, stderr_file);
+                std::chrono::duration<double> wall =
+                    std::chrono::steady_clock::now() - start;
+
+                if (pass == 0 || cpu_seconds < result.cpu_seconds) {
+                    result.cpu_seconds = cpu_seconds;
+                    result.wall_seconds = wall.count();
+                }
+            }
+            results.push_back(std::move(result));
+        }
+    }
+
+    std::cout << std::format(
+        "corpus {}: {} protocols, compiled with {}, best of {} passes, "
+        "{} in {}\n",
+        corpus.description,
+        corpus.files.size(),
+        options.cxx,
+        options.passes,
+        clang ? "-ftime-trace JSON" : "-ftime-report in .log",
+        out_dir.string());
+    std::cout << std::format(
+        "{:>24} {:>18} {:>12} {:>10} {:>10}\n",
+        "protocol",
+        "variant",
+        "header KB",
+        "CPU ms",
+        "wall ms");
+    for (const Result &result : results) {
+        std::cout << std::format(
+            "{:>24} {:>18} {:>12.1f} {:>10.1f} {:>10.1f}\n",
+            result.name,
+            result.variant,
+            double(result.header_bytes) / 1024,
+            result.cpu_seconds * 1e3,
+            result.wall_seconds * 1e3);
+    }
+
+    if (options.json_file) {
+        wl_gena::write_file_if_changed(
+            options.json_file.value(), to_json(options, corpus, results));
+    }
+
+    if (options.baseline_file) {
+        if (!compare(
+                results, options.baseline_file.value(), options.threshold)) {
+            return EXIT_FAILURE;
+        }
+    }
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "Corpus.hh"
+#include "File.hh"
+#include "Parser.hh"
+#include "ProtocolCache.hh"
+#include "SyntheticProtocol.hh"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/*
+ * Synthetic protocols written to a temporary directory, so that reading
+ * them is measured like reading any other corpus
+ */
+std::vector<std::string> write_synthetic_corpus(const fs::path &dir)
+{
+    using wl_gena::bench::SyntheticShape;
+
+    constexpr SyntheticShape shapes[] = {
+        {4, 4, 2},
+        {16, 6, 3},
+        {40, 8, 4},
+        {120, 12, 4},
+    };
+
+    std::vector<std::string> files;
+    for (const SyntheticShape &shape : shapes) {
+        fs::path file = dir / std::format(
+                                  "synthetic_{}x{}x{}.xml",
+                                  shape.interfaces,
+                                  shape.messages,
+                                  shape.args);
+        wl_gena::write_file_if_changed(
+            file.string(), wl_gena::bench::synthetic_protocol_xml(shape));
+        files.push_back(file.string());
+    }
+    return files;
+}
+
+std::vector<std::string> corpus_files(const fs::path &dir)
+{
+    std::vector<std::string> files;
+    if (dir.empty() || !fs::is_directory(dir)) {
+        return files;
+    }
+    for (const fs::directory_entry &entry :
+         fs::recursive_directory_iterator{dir}) {
+        if (entry.is_regular_file() && entry.path().extension() == ".xml") {
+            files.push_back(entry.path().string());
+        }
+    }
+    std::ranges::sort(files);
+    return files;
+}
+
+/*
+ * Also sums up the input bytes and computes the id of the corpus
+ */
+void find_contexts(wl_gena::bench::Corpus &corpus, const fs::path &root)
+{
+    std::string id_key;
+    std::vector<wl_gena::types::Protocol> protocols;
+    for (const std::string &file : corpus.files) {
+        wl_gena::InputFile input{file};
+        corpus.input_bytes += input.view().size();
+
+        id_key += fs::path{file}.lexically_relative(root).generic_string();
+        id_key += '\0';
+        id_key += std::to_string(input.view().size());
+        id_key += '\0';
+        id_key += input.view();
+
+        auto protocol_op = wl_gena::parse_protocol(input.view());
+        if (!protocol_op) {
+            throw std::runtime_error{
+                std::format("{}: {}", file, protocol_op.error())};
+        }
+        protocols.push_back(std::move(protocol_op.value()));
+    }
+    corpus.id = std::format("{:016x}", wl_gena::hash_bytes(id_key));
+
+    std::unordered_map<std::string_view, size_t> defined_in;
+    for (size_t file_i = 0; file_i != protocols.size(); ++file_i) {
+        for (wl_gena::types::Interface iface : protocols[file_i].interfaces()) {
+            defined_in.try_emplace(iface.name(), file_i);
+        }
+    }
+
+    for (size_t file_i = 0; file_i != protocols.size(); ++file_i) {
+        const wl_gena::types::Protocol &protocol = protocols[file_i];
+
+        auto is_local = [&protocol](std::string_view interface_name) {
+            return std::ranges::any_of(
+                protocol.interfaces(),
+                [interface_name](wl_gena::types::Interface iface) {
+                    return iface.name() == interface_name;
+                });
+        };
+
+        std::vector<size_t> context;
+        auto refer = [&](std::optional<std::string_view> interface_name) {
+            if (!interface_name || is_local(interface_name.value())) {
+                return;
+            }
+            auto it = defined_in.find(interface_name.value());
+            if (it == defined_in.end()) {
+                return;
+            }
+            if (std::ranges::find(context, it->second) == context.end()) {
+                context.push_back(it->second);
+            }
+        };
+
+        for (wl_gena::types::Interface iface : protocol.interfaces()) {
+            for (auto messages : {iface.requests(), iface.events()}) {
+                for (wl_gena::types::Message msg : messages) {
+                    for (wl_gena::types::Arg arg : msg.args()) {
+                        refer(arg.interface_name());
+                    }
+                }
+            }
+        }
+        corpus.contexts.push_back(std::move(context));
+    }
+}
+
+} // namespace
+
+namespace wl_gena::bench {
+
+Corpus load_corpus(const fs::path &dir, const fs::path &synthetic_dir)
+{
+    Corpus corpus;
+    corpus.files = corpus_files(dir);
+    corpus.description = dir.string();
+    fs::path root = dir;
+    if (corpus.files.empty()) {
+        fs::create_directories(synthetic_dir);
+        corpus.files = write_synthetic_corpus(synthetic_dir);
+        corpus.description = "synthetic";
+        root = synthetic_dir;
+    }
+    find_contexts(corpus, root);
+    return corpus;
+}
+
+ScratchDir::ScratchDir()
+{
+    std::string pattern =
+        (fs::temp_directory_path() / "wl_gena.bench.XXXXXX").string();
+    if (mkdtemp(pattern.data()) == nullptr) {
+        throw std::runtime_error{"Cannot create a temporary directory"};
+    }
+    path = pattern;
+}
+
+ScratchDir::~ScratchDir()
+{
+    std::error_code ec;
+    fs::remove_all(path, ec);
+}
+
+} // namespace wl_gena::bench
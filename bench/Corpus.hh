@@ -0,0 +1,59 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+namespace wl_gena::bench {
+
+/*
+ * Protocol files benchmarks run over
+ */
+struct Corpus
+{
+    /*
+     * Directory, or "synthetic"
+     */
+    std::string description;
+    /*
+     * Hash of the file names, relative to the directory, and contents;
+     * the same corpus has the same id wherever it is checked out
+     */
+    std::string id;
+    std::vector<std::string> files;
+    /*
+     * Per file, the files defining interfaces it refers to
+     */
+    std::vector<std::vector<size_t>> contexts;
+    size_t input_bytes = 0;
+};
+
+/*
+ * Every *.xml under [dir], sorted; if there are none, synthetic protocols
+ * of growing size written to [synthetic_dir]. Builds default to the
+ * upstream wayland and wayland-protocols XML (see CMakeLists.txt)
+ *
+ * Each file is parsed once to find its context: the first file defining
+ * each interface it refers to but does not define itself
+ */
+Corpus load_corpus(
+    const std::filesystem::path &dir,
+    const std::filesystem::path &synthetic_dir);
+
+/*
+ * Temporary directory, removed with everything in it
+ */
+struct ScratchDir
+{
+    ScratchDir();
+    ~ScratchDir();
+
+    ScratchDir(const ScratchDir &) = delete;
+    ScratchDir &operator=(const ScratchDir &) = delete;
+
+    std::filesystem::path path;
+};
+
+} // namespace wl_gena::bench
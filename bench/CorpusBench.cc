@@ -0,0 +1,491 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "AllocCounter.hh"
+#include "Corpus.hh"
+#include "File.hh"
+#include "HeaderGena.hh"
+#include "Parser.hh"
+#include "Report.hh"
+#include "Trace.hh"
+
+/*
+ * Throughput of every phase of header mode over a corpus of protocols
+ *
+ * Each pass reads and parses every protocol of the corpus, generates its
+ * header with the protocols defining the interfaces it refers to as
+ * context, and writes the header out. Phases are timed separately and
+ * the fastest of all passes is reported, in MB of protocol XML per
+ * second, protocols per second, and heap allocations, allocated bytes
+ * and peak live bytes (above those live when the phase started) per pass
+ *
+ * The corpus is every *.xml under a directory, by default the one the
+ * build was configured with (WL_GENA_BENCH_CORPUS): the upstream wayland
+ * and wayland-protocols XML, or the stand-ins in bench/standin_corpus
+ * where those are not installed. Without any XML, a set of synthetic
+ * protocols is used
+ *
+ * With --json the results are written as JSON, which --baseline reads
+ * back: a phase slower, allocating more often, more bytes or a higher
+ * peak than the threshold (percent) relative to the baseline fails the
+ * run, and so does a baseline taken over another corpus
+ *
+ * usage: wl_gena.bench [--corpus <dir>] [--passes <n>] [--json <file>]
+ *                      [--baseline <file>] [--threshold <percent>]
+ */
+
+#ifndef WL_GENA_BENCH_CORPUS
+#define WL_GENA_BENCH_CORPUS ""
+#endif
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using wl_gena::bench::Corpus;
+using wl_gena::bench::json_string;
+using wl_gena::bench::JsonValue;
+using wl_gena::bench::load_corpus;
+using wl_gena::bench::ScratchDir;
+
+using wl_gena::job_phase_count;
+using wl_gena::job_phase_name;
+using wl_gena::JobPhase;
+
+struct PhaseCost
+{
+    double seconds = 0;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    size_t peak_live_bytes = 0;
+};
+
+/*
+ * Accumulates time and allocations of the phase being measured
+ */
+struct PhaseMeter
+{
+    void enter(JobPhase phase)
+    {
+        _phase = phase;
+        _start_stats = wl_gena::bench::alloc_stats();
+        wl_gena::bench::reset_alloc_peak();
+        _start_time = std::chrono::steady_clock::now();
+    }
+
+    void leave()
+    {
+        auto end_time = std::chrono::steady_clock::now();
+        auto end_stats = wl_gena::bench::alloc_stats();
+
+        PhaseCost &cost = costs[size_t(_phase)];
+        cost.seconds +=
+            std::chrono::duration<double>(end_time - _start_time).count();
+        cost.allocations += end_stats.allocations - _start_stats.allocations;
+        cost.allocated_bytes += end_stats.bytes - _start_stats.bytes;
+        if (end_stats.peak_live_bytes > _start_stats.live_bytes) {
+            cost.peak_live_bytes = std::max(
+                cost.peak_live_bytes,
+                end_stats.peak_live_bytes - _start_stats.live_bytes);
+        }
+    }
+
+    std::array<PhaseCost, job_phase_count> costs;
+
+  private:
+    JobPhase _phase = JobPhase::read;
+    wl_gena::bench::AllocStats _start_stats;
+    std::chrono::steady_clock::time_point _start_time;
+};
+
+/*
+ * One pass over the corpus, costs of the pass are added to [meter]
+ */
+void run_pass(
+    const Corpus &corpus, const fs::path &out_dir, PhaseMeter &meter)
+{
+    std::vector<std::shared_ptr<const wl_gena::types::Protocol>> protocols;
+
+    for (const std::string &file : corpus.files) {
+        meter.enter(JobPhase::read);
+        wl_gena::InputFile input{file};
+        meter.leave();
+
+        meter.enter(JobPhase::parse);
+        auto protocol_op = wl_gena::parse_protocol(input.view());
+        meter.leave();
+        if (!protocol_op) {
+            throw std::runtime_error{
+                std::format("{}: {}", file, protocol_op.error())};
+        }
+
+        protocols.push_back(std::make_shared<const wl_gena::types::Protocol>(
+            std::move(protocol_op.value())));
+    }
+
+    for (size_t file_i = 0; file_i != protocols.size(); ++file_i) {
+        wl_gena::GenerateHeaderInput I;
+        I.protocol = protocols[file_i];
+        for (size_t context_i : corpus.contexts[file_i]) {
+            I.context_protocols.push_back(protocols[context_i]);
+        }
+        I.phase_hook = [&meter](wl_gena::HeaderPhase phase, bool entering) {
+            if (entering) {
+                meter.enter(wl_gena::job_phase_of(phase));
+            } else {
+                meter.leave();
+            }
+        };
+
+        std::pmr::monotonic_buffer_resource arena;
+        auto header = wl_gena::generate_header(I, &arena);
+
+        fs::path out_file = out_dir / fs::path{corpus.files[file_i]}
+                                          .filename()
+                                          .replace_extension(".hh");
+        fs::remove(out_file);
+
+        meter.enter(JobPhase::write);
+        wl_gena::write_file_if_changed(out_file.string(), header.output);
+        meter.leave();
+    }
+}
+
+struct PhaseResult
+{
+    double seconds = 0;
+    double mb_per_s = 0;
+    double protocols_per_s = 0;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    size_t peak_live_bytes = 0;
+};
+
+std::array<PhaseResult, job_phase_count> results_of(
+    const Corpus &corpus, const std::array<PhaseCost, job_phase_count> &best)
+{
+    std::array<PhaseResult, job_phase_count> results;
+    for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+        const PhaseCost &cost = best[phase_i];
+        PhaseResult &result = results[phase_i];
+
+        double seconds = std::max(cost.seconds, 1e-9);
+        result.seconds = cost.seconds;
+        result.mb_per_s = double(corpus.input_bytes) / seconds / 1e6;
+        result.protocols_per_s = double(corpus.files.size()) / seconds;
+        result.allocations = cost.allocations;
+        result.allocated_bytes = cost.allocated_bytes;
+        result.peak_live_bytes = cost.peak_live_bytes;
+    }
+    return results;
+}
+
+std::string to_json(
+    const Corpus &corpus,
+    size_t passes,
+    const std::array<PhaseResult, job_phase_count> &results)
+{
+    std::string o = "{\n";
+    std::format_to(
+        std::back_inserter(o),
+        "  \"corpus\": {},\n"
+        "  \"corpus_id\": {},\n"
+        "  \"protocols\": {},\n"
+        "  \"input_bytes\": {},\n"
+        "  \"passes\": {},\n"
+        "  \"phases\": [\n",
+        json_string(corpus.description),
+        json_string(corpus.id),
+        corpus.files.size(),
+        corpus.input_bytes,
+        passes);
+
+    for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+        const PhaseResult &result = results[phase_i];
+        std::format_to(
+            std::back_inserter(o),
+            "    {{\"name\": \"{}\", \"seconds\": {:.6f}, "
+            "\"mb_per_s\": {:.3f}, \"protocols_per_s\": {:.1f}, "
+            "\"allocations\": {}, \"allocated_bytes\": {}, "
+            "\"peak_live_bytes\": {}}}{}\n",
+            job_phase_name(JobPhase(phase_i)),
+            result.seconds,
+            result.mb_per_s,
+            result.protocols_per_s,
+            result.allocations,
+            result.allocated_bytes,
+            result.peak_live_bytes,
+            phase_i + 1 != job_phase_count ? "," : "");
+    }
+    o += "  ]\n}\n";
+    return o;
+}
+
+struct BaselinePhase
+{
+    double mb_per_s = 0;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    /*
+     * Missing from baselines written before it was measured
+     */
+    std::optional<size_t> peak_live_bytes;
+};
+
+struct Baseline
+{
+    std::string corpus_id;
+    size_t protocols = 0;
+    size_t input_bytes = 0;
+    std::unordered_map<std::string, BaselinePhase> phases;
+};
+
+Baseline read_baseline(const std::string &file_name)
+{
+    JsonValue root = wl_gena::bench::read_json_file(file_name);
+
+    try {
+        Baseline baseline;
+        const JsonValue *corpus_id = root.find("corpus_id");
+        if (!corpus_id) {
+            throw std::runtime_error{
+                "No corpus_id, it predates corpus checks; write a new one"};
+        }
+        baseline.corpus_id = corpus_id->as_string();
+        baseline.protocols = root.at("protocols").as_size();
+        baseline.input_bytes = root.at("input_bytes").as_size();
+
+        for (const JsonValue &phase : root.at("phases").as_array()) {
+            BaselinePhase base;
+            base.mb_per_s = phase.at("mb_per_s").as_number();
+            base.allocations = phase.at("allocations").as_size();
+            base.allocated_bytes = phase.at("allocated_bytes").as_size();
+            if (const JsonValue *peak = phase.find("peak_live_bytes")) {
+                base.peak_live_bytes = peak->as_size();
+            }
+            baseline.phases.insert_or_assign(
+                phase.at("name").as_string(), base);
+        }
+        return baseline;
+    } catch (std::runtime_error &e) {
+        throw std::runtime_error{
+            std::format("Baseline [{}]: {}", file_name, e.what())};
+    }
+}
+
+/*
+ * Results over different protocols do not compare
+ */
+bool same_corpus(const Corpus &corpus, const Baseline &baseline)
+{
+    bool same = true;
+    auto check = [&same](std::string_view what, auto value, auto base) {
+        if (value != base) {
+            std::cout << std::format(
+                "{} differs: {} here, {} in baseline\n", what, value, base);
+            same = false;
+        }
+    };
+    check("corpus id", std::string_view{corpus.id}, baseline.corpus_id);
+    check("protocol count", corpus.files.size(), baseline.protocols);
+    check("input bytes", corpus.input_bytes, baseline.input_bytes);
+    return same;
+}
+
+/*
+ * Growth of [value] over [base] in percent
+ */
+double growth(size_t value, size_t base)
+{
+    if (base == 0) {
+        return value == 0 ? 0 : 100;
+    }
+    return 100 * (double(value) / double(base) - 1);
+}
+
+/*
+ * Returns false if the baseline is of another corpus or any phase
+ * regressed beyond [threshold] percent
+ */
+bool compare(
+    const Corpus &corpus,
+    const std::array<PhaseResult, job_phase_count> &results,
+    const Baseline &baseline,
+    double threshold)
+{
+    std::cout << "\nagainst baseline, threshold " << threshold << "%:\n";
+    if (!same_corpus(corpus, baseline)) {
+        std::cout << "baseline was taken over another corpus\n";
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+        std::string name{job_phase_name(JobPhase(phase_i))};
+        auto it = baseline.phases.find(name);
+        if (it == baseline.phases.end()) {
+            std::cout << std::format("{:>8}: not in baseline\n", name);
+            continue;
+        }
+        const PhaseResult &result = results[phase_i];
+        const BaselinePhase &base = it->second;
+
+        double speed_change = 100 * (result.mb_per_s / base.mb_per_s - 1);
+        double allocation_change =
+            growth(result.allocations, base.allocations);
+        double bytes_change =
+            growth(result.allocated_bytes, base.allocated_bytes);
+        double peak_change = 0;
+        if (base.peak_live_bytes) {
+            peak_change = growth(
+                result.peak_live_bytes, base.peak_live_bytes.value());
+        }
+
+        bool slower = speed_change < -threshold;
+        bool allocates_more = allocation_change > threshold ||
+                              bytes_change > threshold ||
+                              peak_change > threshold;
+        std::cout << std::format(
+            "{:>8}: {:+7.1f}% MB/s, {:+7.1f}% allocations, "
+            "{:+7.1f}% bytes, {:+7.1f}% peak{}\n",
+            name,
+            speed_change,
+            allocation_change,
+            bytes_change,
+            peak_change,
+            slower || allocates_more ? "  REGRESSION" : "");
+        ok = ok && !slower && !allocates_more;
+    }
+    return ok;
+}
+
+struct Options
+{
+    std::string corpus_dir = WL_GENA_BENCH_CORPUS;
+    size_t passes = 5;
+    std::optional<std::string> json_file;
+    std::optional<std::string> baseline_file;
+    double threshold = 10;
+};
+
+Options parse_options(int argc, char **argv)
+{
+    Options o;
+    for (int arg_i = 1; arg_i != argc; ++arg_i) {
+        std::string_view arg = argv[arg_i];
+        if (arg_i + 1 == argc) {
+            throw std::runtime_error{
+                std::format("Option [{}] needs a value", arg)};
+        }
+        std::string value = argv[++arg_i];
+
+        if (arg == "--corpus") {
+            o.corpus_dir = value;
+        } else if (arg == "--passes") {
+            o.passes = std::max<size_t>(1, std::stoul(value));
+        } else if (arg == "--json") {
+            o.json_file = value;
+        } else if (arg == "--baseline") {
+            o.baseline_file = value;
+        } else if (arg == "--threshold") {
+            o.threshold = std::stod(value);
+        } else {
+            throw std::runtime_error{std::format(
+                "Unknown option [{}]\n"
+                "usage: wl_gena.bench [--corpus <dir>] [--passes <n>] "
+                "[--json <file>] [--baseline <file>] "
+                "[--threshold <percent>]",
+                arg)};
+        }
+    }
+    return o;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    Options options = parse_options(argc, argv);
+    ScratchDir scratch;
+
+    Corpus corpus = load_corpus(options.corpus_dir, scratch.path / "corpus");
+
+    fs::path out_dir = scratch.path / "out";
+    fs::create_directory(out_dir);
+
+    std::optional<std::array<PhaseCost, job_phase_count>> best;
+    for (size_t pass = 0; pass != options.passes; ++pass) {
+        PhaseMeter meter;
+        run_pass(corpus, out_dir, meter);
+
+        if (!best) {
+            best = meter.costs;
+            continue;
+        }
+        for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+            if (meter.costs[phase_i].seconds < (*best)[phase_i].seconds) {
+                (*best)[phase_i] = meter.costs[phase_i];
+            }
+        }
+    }
+
+    auto results = results_of(corpus, best.value());
+
+    std::cout << std::format(
+        "corpus {}: {} protocols, {} bytes, best of {} passes\n",
+        corpus.description,
+        corpus.files.size(),
+        corpus.input_bytes,
+        options.passes);
+    std::cout << std::format(
+        "{:>8} {:>10} {:>10} {:>12} {:>12} {:>12}\n",
+        "phase",
+        "ms",
+        "MB/s",
+        "protocols/s",
+        "allocations",
+        "peak live");
+    for (size_t phase_i = 0; phase_i != job_phase_count; ++phase_i) {
+        const PhaseResult &result = results[phase_i];
+        std::cout << std::format(
+            "{:>8} {:>10.3f} {:>10.1f} {:>12.0f} {:>12} {:>12}\n",
+            job_phase_name(JobPhase(phase_i)),
+            result.seconds * 1e3,
+            result.mb_per_s,
+            result.protocols_per_s,
+            result.allocations,
+            result.peak_live_bytes);
+    }
+
+    if (options.json_file) {
+        wl_gena::write_file_if_changed(
+            options.json_file.value(),
+            to_json(corpus, options.passes, results));
+    }
+
+    if (options.baseline_file) {
+        auto baseline = read_baseline(options.baseline_file.value());
+        if (!compare(corpus, results, baseline, options.threshold)) {
+            return EXIT_FAILURE;
+        }
+    }
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
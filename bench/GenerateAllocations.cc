@@ -0,0 +1,103 @@
+#include <chrono>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "AllocCounter.hh"
+#include "File.hh"
+#include "HeaderGena.hh"
+#include "Parser.hh"
+
+/*
+ * Reports heap allocations and time spent by generate_header(), once
+ * with the default resource and once with a monotonic buffer per header
+ * as header mode uses
+ *
+ * usage: wl_gena.bench_generate <protocol.xml> [context_protocol.xml...]
+ */
+
+namespace {
+
+std::shared_ptr<const wl_gena::types::Protocol>
+    load_protocol(const std::string &file_name)
+{
+    wl_gena::InputFile input{file_name};
+    auto protocol_op = wl_gena::parse_protocol(input.view());
+    if (!protocol_op) {
+        throw std::runtime_error{protocol_op.error()};
+    }
+    return std::make_shared<const wl_gena::types::Protocol>(
+        std::move(protocol_op.value()));
+}
+
+constexpr size_t iterations = 20;
+
+template <typename GenerateFn>
+void bench_generate(std::string_view label, GenerateFn generate)
+{
+    using wl_gena::bench::alloc_stats;
+
+    size_t output_size = 0;
+
+    auto start_stats = alloc_stats();
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (size_t iter = 0; iter != iterations; ++iter) {
+        output_size = generate();
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    auto end_stats = alloc_stats();
+
+    double allocations =
+        double(end_stats.allocations - start_stats.allocations) / iterations;
+    double bytes = double(end_stats.bytes - start_stats.bytes) / iterations;
+    std::chrono::duration<double, std::micro> time =
+        (end_time - start_time) / iterations;
+
+    std::cout << std::format(
+        "{}: {:.0f} allocations, {:.0f} bytes, {:.1f} us/header, "
+        "{} bytes of output\n",
+        label,
+        allocations,
+        bytes,
+        time.count(),
+        output_size);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    if (argc < 2) {
+        std::cerr << "usage: wl_gena.bench_generate <protocol.xml> "
+                     "[context_protocol.xml...]\n";
+        return EXIT_FAILURE;
+    }
+
+    wl_gena::GenerateHeaderInput I;
+    I.protocol = load_protocol(argv[1]);
+    for (int arg_i = 2; arg_i != argc; ++arg_i) {
+        I.context_protocols.push_back(load_protocol(argv[arg_i]));
+    }
+
+    bench_generate(std::format("{}: default heap", argv[1]), [&I]() {
+        return wl_gena::generate_header(I).output.size();
+    });
+
+    bench_generate(std::format("{}: monotonic buffer", argv[1]), [&I]() {
+        std::pmr::monotonic_buffer_resource arena;
+        return wl_gena::generate_header(I, &arena).output.size();
+    });
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
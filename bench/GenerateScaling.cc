@@ -0,0 +1,177 @@
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "HeaderGena.hh"
+#include "Parser.hh"
+#include "SyntheticProtocol.hh"
+
+/*
+ * Times parsing and header generation of synthetic protocols while one
+ * dimension of their shape doubles, and reports how time grows with it.
+ * An exponent near 1 is linear, near 2 is quadratic
+ *
+ * usage: wl_gena.bench_scaling
+ *        wl_gena.bench_scaling --xml <interfaces> <messages> <args>
+ *
+ * With --xml the synthetic protocol of that shape is written to stdout
+ * instead
+ */
+
+namespace {
+
+using wl_gena::bench::SyntheticShape;
+
+struct Timing
+{
+    double parse_ms = 0;
+    double generate_ms = 0;
+    size_t output_size = 0;
+};
+
+constexpr size_t repeats = 3;
+
+/*
+ * Best of a few runs, the protocols are large enough for the rest to be
+ * noise
+ */
+Timing time_shape(const SyntheticShape &shape)
+{
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::duration<double, std::milli>;
+
+    std::string xml = wl_gena::bench::synthetic_protocol_xml(shape);
+
+    std::optional<Timing> best;
+    for (size_t repeat = 0; repeat != repeats; ++repeat) {
+        Timing t;
+
+        auto parse_start = clock::now();
+        auto protocol_op = wl_gena::parse_protocol(xml);
+        auto parse_end = clock::now();
+        if (!protocol_op) {
+            throw std::runtime_error{protocol_op.error()};
+        }
+
+        wl_gena::GenerateHeaderInput I;
+        I.protocol = std::make_shared<const wl_gena::types::Protocol>(
+            std::move(protocol_op.value()));
+
+        auto generate_start = clock::now();
+        {
+            std::pmr::monotonic_buffer_resource arena;
+            t.output_size =
+                wl_gena::generate_header(I, &arena).output.size();
+        }
+        auto generate_end = clock::now();
+
+        t.parse_ms = ms{parse_end - parse_start}.count();
+        t.generate_ms = ms{generate_end - generate_start}.count();
+
+        if (!best || t.generate_ms < best->generate_ms) {
+            best = t;
+        }
+    }
+    return best.value();
+}
+
+double exponent(double time, double previous_time)
+{
+    return std::log2(time / previous_time);
+}
+
+/*
+ * Doubles the dimension [grown] picks out of [shape] [steps] times
+ */
+void sweep(
+    std::string_view label,
+    SyntheticShape shape,
+    size_t SyntheticShape::*grown,
+    size_t steps)
+{
+    std::cout << std::format(
+        "{:>10} {:>15} {:>11} {:>8} {:>11} {:>8} {:>10}\n",
+        label,
+        "shape",
+        "parse ms",
+        "exp",
+        "generate ms",
+        "exp",
+        "output MB");
+
+    std::optional<Timing> previous;
+    for (size_t step = 0; step != steps; ++step) {
+        Timing t = time_shape(shape);
+
+        std::string parse_exp = "-";
+        std::string generate_exp = "-";
+        if (previous) {
+            parse_exp = std::format(
+                "{:.2f}", exponent(t.parse_ms, previous->parse_ms));
+            generate_exp = std::format(
+                "{:.2f}", exponent(t.generate_ms, previous->generate_ms));
+        }
+
+        std::cout << std::format(
+            "{:>10} {:>15} {:>11.2f} {:>8} {:>11.2f} {:>8} {:>10.2f}\n",
+            "",
+            std::format(
+                "{}x{}x{}", shape.interfaces, shape.messages, shape.args),
+            t.parse_ms,
+            parse_exp,
+            t.generate_ms,
+            generate_exp,
+            double(t.output_size) / (1024 * 1024));
+
+        previous = t;
+        shape.*grown *= 2;
+    }
+    std::cout << '\n';
+}
+
+size_t parse_size(std::string_view str)
+{
+    size_t value = 0;
+    if (str.empty() || str.find_first_not_of("0123456789") != str.npos) {
+        throw std::runtime_error{std::format("Not a size: [{}]", str)};
+    }
+    for (char c : str) {
+        value = value * 10 + size_t(c - '0');
+    }
+    return value;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    if (argc == 5 && std::string_view{argv[1]} == "--xml") {
+        SyntheticShape shape{
+            parse_size(argv[2]), parse_size(argv[3]), parse_size(argv[4])};
+        std::cout << wl_gena::bench::synthetic_protocol_xml(shape);
+        return EXIT_SUCCESS;
+    }
+    if (argc != 1) {
+        std::cerr << "usage: wl_gena.bench_scaling "
+                     "[--xml <interfaces> <messages> <args>]\n";
+        return EXIT_FAILURE;
+    }
+
+    sweep("interfaces", {250, 8, 4}, &SyntheticShape::interfaces, 5);
+    sweep("messages", {100, 4, 4}, &SyntheticShape::messages, 5);
+    sweep("args", {100, 8, 2}, &SyntheticShape::args, 5);
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdarg>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+/*
+ * Cost of a generated request stub with varargs marshalling
+ * (wl_proxy_marshal_flags) against array marshalling
+ * (wl_proxy_marshal_array_flags)
+ *
+ * The client library is a mock that does what libwayland does before
+ * a request goes on the wire: the varargs entry point walks the message
+ * signature with va_arg into a wl_argument array, and both entry points
+ * then walk the signature over the array once more, here to fold the
+ * arguments into a checksum instead of serializing them
+ *
+ * The headers come from wl_gena.bench_marshal_headers at build time
+ *
+ * usage: wl_gena.bench_marshal [--iterations <n>]
+ */
+
+struct wl_array
+{
+    size_t size;
+    size_t alloc;
+    void *data;
+};
+
+namespace mock {
+
+struct wl_object;
+struct wl_display;
+
+struct wl_interface;
+
+struct wl_message
+{
+    const char *name;
+    const char *signature;
+    const wl_interface **types;
+};
+
+struct wl_interface
+{
+    const char *name;
+    int version;
+    int method_count;
+    const wl_message *methods;
+    int event_count;
+    const wl_message *events;
+};
+
+union wl_argument {
+    int32_t i;
+    uint32_t u;
+    int32_t f;
+    const char *s;
+    wl_object *o;
+    uint32_t n;
+    wl_array *a;
+    int32_t h;
+};
+
+struct wl_proxy
+{
+    const wl_interface *interface;
+    uint32_t version;
+};
+
+constexpr size_t max_args = 20;
+
+uint64_t checksum = 0;
+wl_proxy new_proxy{nullptr, 1};
+
+/*
+ * Signature chars that are wire args, not the since version or '?'
+ */
+bool is_arg_char(char c)
+{
+    return c != '?' && !(c >= '0' && c <= '9');
+}
+
+/*
+ * As libwayland's wl_argument_from_va_list
+ */
+size_t args_from_va_list(
+    const char *signature,
+    wl_argument *args,
+    va_list ap)
+{
+    size_t count = 0;
+    for (const char *c = signature; *c != '\0'; ++c) {
+        if (!is_arg_char(*c)) {
+            continue;
+        }
+        wl_argument &arg = args[count++];
+        switch (*c) {
+        case 'i':
+            arg.i = va_arg(ap, int32_t);
+            break;
+        case 'u':
+            arg.u = va_arg(ap, uint32_t);
+            break;
+        case 'f':
+            arg.f = va_arg(ap, int32_t);
+            break;
+        case 's':
+            arg.s = va_arg(ap, const char *);
+            break;
+        case 'o':
+            arg.o = va_arg(ap, wl_object *);
+            break;
+        case 'n':
+            arg.o = va_arg(ap, wl_object *);
+            break;
+        case 'a':
+            arg.a = va_arg(ap, wl_array *);
+            break;
+        case 'h':
+            arg.h = va_arg(ap, int32_t);
+            break;
+        }
+    }
+    return count;
+}
+
+/*
+ * Stands in for building and sending the closure
+ */
+wl_proxy *send(
+    wl_proxy *proxy,
+    uint32_t opcode,
+    const wl_interface *interface,
+    const wl_argument *args)
+{
+    const char *signature = proxy->interface->methods[opcode].signature;
+
+    uint64_t sum = opcode;
+    size_t arg_i = 0;
+    for (const char *c = signature; *c != '\0'; ++c) {
+        if (!is_arg_char(*c)) {
+            continue;
+        }
+        const wl_argument &arg = args[arg_i++];
+        switch (*c) {
+        case 'i':
+        case 'f':
+        case 'h':
+            sum = sum * 31 + uint32_t(arg.i);
+            break;
+        case 'u':
+            sum = sum * 31 + arg.u;
+            break;
+        case 's':
+            sum = sum * 31 + uint64_t(arg.s != nullptr ? arg.s[0] : 0);
+            break;
+        case 'o':
+        case 'n':
+        case 'a':
+            sum = sum * 31 + (arg.o != nullptr ? 1 : 0);
+            break;
+        }
+    }
+    checksum += sum;
+
+    if (interface == nullptr) {
+        return nullptr;
+    }
+    new_proxy.interface = interface;
+    return &new_proxy;
+}
+
+struct client_library
+{
+    [[gnu::noinline]] wl_proxy *wl_proxy_marshal_flags(
+        wl_proxy *proxy,
+        uint32_t opcode,
+        const wl_interface *interface,
+        uint32_t /* version */,
+        uint32_t flags,
+        ...)
+    {
+        wl_argument args[max_args];
+        const char *signature = proxy->interface->methods[opcode].signature;
+
+        va_list ap;
+        va_start(ap, flags);
+        args_from_va_list(signature, args, ap);
+        va_end(ap);
+
+        return send(proxy, opcode, interface, args);
+    }
+
+    [[gnu::noinline]] wl_proxy *wl_proxy_marshal_array_flags(
+        wl_proxy *proxy,
+        uint32_t opcode,
+        const wl_interface *interface,
+        uint32_t /* version */,
+        uint32_t /* flags */,
+        wl_argument *args)
+    {
+        return send(proxy, opcode, interface, args);
+    }
+
+    int wl_proxy_add_listener(wl_proxy *, void (**)(void), void *)
+    {
+        return 0;
+    }
+
+    uint32_t wl_proxy_get_version(wl_proxy *proxy)
+    {
+        return proxy->version;
+    }
+
+    void wl_proxy_destroy(wl_proxy *)
+    {
+    }
+};
+
+struct traits
+{
+    using wl_proxy_t = wl_proxy;
+    using wl_display_t = wl_display;
+    using wl_interface_t = wl_interface;
+    using wl_message_t = wl_message;
+    using wl_argument_t = wl_argument;
+    using client_library_t = client_library;
+};
+
+} // namespace mock
+
+#include "marshal_array.hh"
+#include "marshal_varargs.hh"
+
+namespace {
+
+constexpr std::array<std::string_view, 7> request_names{
+    "commit",
+    "attach",
+    "damage_buffer",
+    "frame",
+    "set_buffer_transform",
+    "set_position",
+    "set_title",
+};
+
+struct RequestCost
+{
+    double ns_per_call = 0;
+    uint64_t checksum = 0;
+};
+
+template <typename F>
+RequestCost time_request(size_t iterations, F &&call)
+{
+    mock::checksum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != iterations; ++i) {
+        call(static_cast<int32_t>(i));
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::nano> elapsed = end - begin;
+    return {elapsed.count() / double(iterations), mock::checksum};
+}
+
+/*
+ * Every bm_surface request [iterations] times, in request_names order,
+ * through the stubs of one generated header
+ */
+template <
+    template <typename> typename surface_t,
+    template <typename> typename buffer_t,
+    template <typename> typename rtti_t>
+std::array<RequestCost, request_names.size()> run_requests(size_t iterations)
+{
+    using surface_handle_t = typename surface_t<mock::traits>::handle_t;
+    using buffer_handle_t = typename buffer_t<mock::traits>::handle_t;
+    using transform_e = typename surface_t<mock::traits>::transform_e;
+
+    mock::wl_proxy surface_proxy{
+        &rtti_t<mock::traits>::bm_surface_interface, 6};
+    mock::wl_proxy buffer_proxy{&rtti_t<mock::traits>::bm_buffer_interface, 1};
+    auto *surface = reinterpret_cast<surface_handle_t *>(&surface_proxy);
+    auto *buffer = reinterpret_cast<buffer_handle_t *>(&buffer_proxy);
+
+    surface_t<mock::traits> s;
+    return {
+        time_request(iterations, [&](int32_t) { s.commit(surface); }),
+        time_request(
+            iterations,
+            [&](int32_t i) { s.attach(surface, buffer, i, -i); }),
+        time_request(
+            iterations,
+            [&](int32_t i) { s.damage_buffer(surface, i, i, 256, 256); }),
+        time_request(iterations, [&](int32_t) { s.frame(surface); }),
+        time_request(
+            iterations,
+            [&](int32_t i) {
+                transform_e transform =
+                    (i & 1) ? transform_e::flipped : transform_e::normal;
+                s.set_buffer_transform(surface, transform);
+            }),
+        time_request(
+            iterations,
+            [&](int32_t i) { s.set_position(surface, i * 256, -i * 256); }),
+        time_request(
+            iterations,
+            [&](int32_t i) { s.set_title(surface, (i & 1) ? "odd" : "even"); }),
+    };
+}
+
+size_t parse_iterations(int argc, char **argv)
+{
+    size_t iterations = 10'000'000;
+    for (int arg_i = 1; arg_i != argc; ++arg_i) {
+        std::string_view arg = argv[arg_i];
+        if (arg == "--iterations" && arg_i + 1 != argc) {
+            iterations = std::max<size_t>(1, std::stoul(argv[++arg_i]));
+        } else {
+            throw std::runtime_error{std::format(
+                "Unknown option [{}]\n"
+                "usage: wl_gena.bench_marshal [--iterations <n>]",
+                arg)};
+        }
+    }
+    return iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    size_t iterations = parse_iterations(argc, argv);
+
+    auto varargs = run_requests<
+        varargs::bench_marshal::bm_surface,
+        varargs::bench_marshal::bm_buffer,
+        varargs::bench_marshal::rtti>(iterations);
+    auto array = run_requests<
+        array::bench_marshal::bm_surface,
+        array::bench_marshal::bm_buffer,
+        array::bench_marshal::rtti>(iterations);
+
+    std::cout << std::format("{} calls per request\n", iterations);
+    std::cout << std::format(
+        "{:>20} {:>12} {:>12} {:>8}\n",
+        "request",
+        "varargs ns",
+        "array ns",
+        "speedup");
+    for (size_t request_i = 0; request_i != request_names.size(); ++request_i) {
+        if (varargs[request_i].checksum != array[request_i].checksum) {
+            throw std::runtime_error{std::format(
+                "{}: varargs and array stubs marshalled different arguments",
+                request_names[request_i])};
+        }
+        std::cout << std::format(
+            "{:>20} {:>12.2f} {:>12.2f} {:>7.2f}x\n",
+            request_names[request_i],
+            varargs[request_i].ns_per_call,
+            array[request_i].ns_per_call,
+            varargs[request_i].ns_per_call / array[request_i].ns_per_call);
+    }
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
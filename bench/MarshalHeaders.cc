@@ -0,0 +1,112 @@
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cstdlib>
+
+#include "File.hh"
+#include "HeaderGena.hh"
+#include "Parser.hh"
+
+/*
+ * Writes the headers wl_gena.bench_marshal is compiled with: one
+ * protocol of typical per-frame requests, generated once with varargs
+ * and once with array marshalling, in the top namespaces [varargs] and
+ * [array]
+ *
+ * usage: wl_gena.bench_marshal_headers <out_dir>
+ */
+
+namespace {
+
+constexpr std::string_view marshal_protocol_xml = R"(<?xml version="1.0"?>
+<protocol name="bench_marshal">
+  <interface name="bm_callback" version="1">
+    <event name="done" type="destructor">
+      <arg name="callback_data" type="uint"/>
+    </event>
+  </interface>
+  <interface name="bm_buffer" version="1">
+    <request name="destroy" type="destructor"/>
+  </interface>
+  <interface name="bm_surface" version="6">
+    <enum name="transform">
+      <entry name="normal" value="0"/>
+      <entry name="flipped" value="4"/>
+    </enum>
+    <request name="commit"/>
+    <request name="attach">
+      <arg name="buffer" type="object" interface="bm_buffer" allow-null="true"/>
+      <arg name="x" type="int"/>
+      <arg name="y" type="int"/>
+    </request>
+    <request name="damage_buffer">
+      <arg name="x" type="int"/>
+      <arg name="y" type="int"/>
+      <arg name="width" type="int"/>
+      <arg name="height" type="int"/>
+    </request>
+    <request name="frame">
+      <arg name="callback" type="new_id" interface="bm_callback"/>
+    </request>
+    <request name="set_buffer_transform">
+      <arg name="transform" type="uint" enum="transform"/>
+    </request>
+    <request name="set_position">
+      <arg name="x" type="fixed"/>
+      <arg name="y" type="fixed"/>
+    </request>
+    <request name="set_title">
+      <arg name="title" type="string"/>
+    </request>
+  </interface>
+</protocol>
+)";
+
+void write_header(
+    const std::filesystem::path &out_dir,
+    const std::string &top_namespace,
+    bool array_marshalling)
+{
+    auto protocol_op = wl_gena::parse_protocol(marshal_protocol_xml);
+    if (!protocol_op) {
+        throw std::runtime_error{protocol_op.error()};
+    }
+
+    wl_gena::GenerateHeaderInput I;
+    I.protocol = std::make_shared<const wl_gena::types::Protocol>(
+        std::move(protocol_op.value()));
+    I.top_namespace_id = top_namespace;
+    I.array_marshalling = array_marshalling;
+
+    std::pmr::monotonic_buffer_resource arena;
+    auto header = wl_gena::generate_header(I, &arena);
+
+    std::filesystem::path out_file =
+        out_dir / ("marshal_" + top_namespace + ".hh");
+    wl_gena::write_file_if_changed(out_file.string(), header.output);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    if (argc != 2) {
+        std::cerr << "usage: wl_gena.bench_marshal_headers <out_dir>\n";
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path out_dir{argv[1]};
+    std::filesystem::create_directories(out_dir);
+
+    write_header(out_dir, "varargs", false);
+    write_header(out_dir, "array", true);
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "AllocCounter.hh"
+#include "File.hh"
+#include "Parser.hh"
+
+/*
+ * Reports heap allocations per XML element spent by parse_protocol(),
+ * and the heap footprint of the resulting protocol IR
+ *
+ * usage: wl_gena.bench_parse_alloc <protocol.xml>...
+ */
+
+namespace {
+
+size_t count_elements(std::string_view xml)
+{
+    size_t elements = 0;
+    for (size_t pos = xml.find('<'); pos != xml.npos;
+         pos = xml.find('<', pos + 1)) {
+        if (pos + 1 == xml.size()) {
+            break;
+        }
+        char next = xml[pos + 1];
+        if (next != '/' && next != '?' && next != '!') {
+            elements++;
+        }
+    }
+    return elements;
+}
+
+constexpr size_t iterations = 20;
+
+void bench_file(const std::string &file_name)
+{
+    using wl_gena::bench::alloc_stats;
+
+    wl_gena::InputFile input{file_name};
+    std::string_view xml = input.view();
+    size_t elements = count_elements(xml);
+
+    size_t ir_bytes = 0;
+
+    auto start_stats = alloc_stats();
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (size_t iter = 0; iter != iterations; ++iter) {
+        auto protocol_op = wl_gena::parse_protocol(xml);
+        if (!protocol_op) {
+            throw std::runtime_error{protocol_op.error()};
+        }
+        ir_bytes = protocol_op.value().allocated_bytes();
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    auto end_stats = alloc_stats();
+
+    double allocations =
+        double(end_stats.allocations - start_stats.allocations) / iterations;
+    double bytes = double(end_stats.bytes - start_stats.bytes) / iterations;
+    std::chrono::duration<double, std::micro> time =
+        (end_time - start_time) / iterations;
+
+    std::cout << std::format(
+        "{}: {} elements, {:.0f} allocations ({:.2f}/element), "
+        "{:.0f} bytes, {:.1f} us/parse, {} bytes held by the IR\n",
+        file_name,
+        elements,
+        allocations,
+        allocations / double(elements),
+        bytes,
+        time.count(),
+        ir_bytes);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    if (argc < 2) {
+        std::cerr << "usage: wl_gena.bench_parse_alloc <protocol.xml>...\n";
+        return EXIT_FAILURE;
+    }
+
+    for (int arg_i = 1; arg_i != argc; ++arg_i) {
+        bench_file(argv[arg_i]);
+    }
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
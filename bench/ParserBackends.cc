@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <expected>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdlib>
+
+#include "Corpus.hh"
+#include "File.hh"
+#include "Format.hh"
+#include "Parser.hh"
+#include "XmlTokenizer.hh"
+
+/*
+ * Differential test and throughput comparison of the parser backends
+ *
+ * Every file is parsed by expat and by each tokenizer backend the CPU
+ * supports, both in one piece and streamed in small uneven pieces, and
+ * the resulting protocols have to be identical. Parsed with docs from a
+ * ProtocolSource, the summaries, the byte ranges of descriptions and the
+ * copyright, and their decoded text have to be identical as well. Then
+ * each backend's parse throughput is reported, unless --check is given
+ *
+ * Without files, it runs over the corpus the build was configured with
+ * (WL_GENA_BENCH_CORPUS), as wl_gena.bench does; the build registers
+ * that run as a test
+ *
+ * usage: wl_gena.bench_parser_backends [--check] [<protocol.xml>...]
+ */
+
+#ifndef WL_GENA_BENCH_CORPUS
+#define WL_GENA_BENCH_CORPUS ""
+#endif
+
+namespace {
+
+using wl_gena::ParserBackend;
+
+constexpr ParserBackend all_backends[] = {
+    ParserBackend::expat,
+    ParserBackend::tokenizer_scalar,
+    ParserBackend::tokenizer_sse2,
+    ParserBackend::tokenizer_avx2,
+};
+
+bool is_available(ParserBackend backend)
+{
+    switch (backend) {
+    case ParserBackend::expat:
+    case ParserBackend::tokenizer_scalar:
+        return true;
+    case ParserBackend::tokenizer_sse2:
+        return wl_gena::scan_isa_supported(wl_gena::ScanIsa::sse2);
+    case ParserBackend::tokenizer_avx2:
+        return wl_gena::scan_isa_supported(wl_gena::ScanIsa::avx2);
+    }
+    return false;
+}
+
+/*
+ * Protocol as JSON; error messages differ between backends, so all that
+ * is compared for a rejected document is that it was rejected
+ */
+constexpr std::string_view rejected = "rejected";
+
+std::string describe(
+    const std::expected<wl_gena::types::Protocol, std::string> &protocol_op)
+{
+    if (!protocol_op) {
+        return std::string{rejected};
+    }
+    return std::format("{}", protocol_op.value());
+}
+
+std::string parse_whole(std::string_view xml, ParserBackend backend)
+{
+    try {
+        return describe(wl_gena::parse_protocol(
+            xml, std::pmr::get_default_resource(), backend));
+    } catch (std::exception &) {
+        return std::string{rejected};
+    }
+}
+
+/*
+ * Hands the document over a few bytes at a time, so tokens get split at
+ * every possible offset
+ */
+std::string
+    parse_streamed(std::string_view xml, ParserBackend backend, size_t step)
+{
+    size_t piece = 0;
+    auto reader = [&xml, &piece, step](std::span<char> buffer) -> size_t {
+        piece++;
+        size_t size = std::min({buffer.size(), xml.size(), 1 + piece % step});
+        std::ranges::copy(xml.substr(0, size), buffer.begin());
+        xml.remove_prefix(size);
+        return size;
+    };
+
+    try {
+        return describe(wl_gena::parse_protocol(
+            reader, std::pmr::get_default_resource(), backend));
+    } catch (std::exception &) {
+        return std::string{rejected};
+    }
+}
+
+/*
+ * One line per documented element: summary, byte range of the
+ * description in [xml] and its decoded text; the copyright likewise
+ */
+std::string describe_docs(
+    const wl_gena::types::Protocol &protocol, std::string_view xml)
+{
+    std::string o;
+    auto range = [xml](std::string_view text) {
+        return std::format("{}+{}", text.data() - xml.data(), text.size());
+    };
+    auto add = [&o, &range](std::string_view path, wl_gena::types::Doc doc) {
+        auto summary = doc.summary();
+        auto description = doc.description_xml();
+        if (!summary && !description) {
+            return;
+        }
+        std::format_to(
+            std::back_inserter(o),
+            "{}: summary [{}], description {} [{}]\n",
+            path,
+            summary.value_or("none"),
+            description ? range(description.value()) : "none",
+            description
+                ? wl_gena::decode_character_data(description.value())
+                : "");
+    };
+
+    if (auto copyright = protocol.copyright_xml()) {
+        std::format_to(
+            std::back_inserter(o),
+            "copyright {} [{}]\n",
+            range(copyright.value()),
+            wl_gena::decode_character_data(copyright.value()));
+    }
+    add(protocol.name(), protocol.doc());
+
+    auto add_message = [&add](
+                           std::string_view path,
+                           wl_gena::types::Message message) {
+        std::string message_path = std::format("{}.{}", path, message.name());
+        add(message_path, message.doc());
+        for (wl_gena::types::Arg arg : message.args()) {
+            add(std::format("{}.{}", message_path, arg.name()), arg.doc());
+        }
+    };
+    for (wl_gena::types::Interface iface : protocol.interfaces()) {
+        add(iface.name(), iface.doc());
+        for (wl_gena::types::Message request : iface.requests()) {
+            add_message(std::format("{}.request", iface.name()), request);
+        }
+        for (wl_gena::types::Message event : iface.events()) {
+            add_message(std::format("{}.event", iface.name()), event);
+        }
+        for (wl_gena::types::Enum e : iface.enums()) {
+            std::string enum_path =
+                std::format("{}.{}", iface.name(), e.name());
+            add(enum_path, e.doc());
+            for (wl_gena::types::Enum::Entry entry : e.entries()) {
+                add(std::format("{}.{}", enum_path, entry.name()),
+                    entry.doc());
+            }
+        }
+    }
+    return o;
+}
+
+/*
+ * The protocol and its docs, parsed from a ProtocolSource
+ */
+std::string parse_with_docs(std::string_view xml, ParserBackend backend)
+{
+    try {
+        auto protocol_op = wl_gena::parse_protocol(
+            wl_gena::types::ProtocolSource{nullptr, xml},
+            std::pmr::get_default_resource(),
+            backend);
+        if (!protocol_op) {
+            return std::string{rejected};
+        }
+        return std::format(
+            "{}\n{}",
+            protocol_op.value(),
+            describe_docs(protocol_op.value(), xml));
+    } catch (std::exception &) {
+        return std::string{rejected};
+    }
+}
+
+constexpr size_t iterations = 20;
+constexpr size_t stream_step = 7;
+
+/*
+ * Returns false if any backend disagrees with expat
+ */
+bool bench_file(const std::string &file_name, bool check_only)
+{
+    wl_gena::InputFile input{file_name};
+    std::string_view xml = input.view();
+
+    std::string reference = parse_whole(xml, ParserBackend::expat);
+    std::string reference_docs = parse_with_docs(xml, ParserBackend::expat);
+    bool all_match = true;
+
+    for (ParserBackend backend : all_backends) {
+        if (!is_available(backend)) {
+            std::cout << std::format(
+                "{}: {}: not supported by this CPU\n",
+                file_name,
+                wl_gena::parser_backend_name(backend));
+            continue;
+        }
+
+        bool matches =
+            parse_whole(xml, backend) == reference &&
+            parse_streamed(xml, backend, stream_step) == reference &&
+            parse_with_docs(xml, backend) == reference_docs;
+        all_match = all_match && matches;
+
+        if (reference == rejected || check_only) {
+            std::cout << std::format(
+                "{}: {}: {}\n",
+                file_name,
+                wl_gena::parser_backend_name(backend),
+                matches ? (reference == rejected ? "rejected as by expat"
+                                                 : "matches expat")
+                        : "MISMATCH");
+            continue;
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+        for (size_t iter = 0; iter != iterations; ++iter) {
+            auto protocol_op = wl_gena::parse_protocol(
+                xml, std::pmr::get_default_resource(), backend);
+            if (!protocol_op) {
+                throw std::runtime_error{protocol_op.error()};
+            }
+        }
+        auto end_time = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double, std::micro> time =
+            (end_time - start_time) / iterations;
+
+        std::cout << std::format(
+            "{}: {}: {}, {:.1f} us/parse, {:.1f} MB/s\n",
+            file_name,
+            wl_gena::parser_backend_name(backend),
+            matches ? "matches expat" : "MISMATCH",
+            time.count(),
+            double(xml.size()) / time.count());
+    }
+
+    return all_match;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    bool check_only = false;
+    std::vector<std::string> files;
+    for (int arg_i = 1; arg_i != argc; ++arg_i) {
+        std::string_view arg = argv[arg_i];
+        if (arg == "--check") {
+            check_only = true;
+        } else if (arg.starts_with("--")) {
+            std::cerr << "usage: wl_gena.bench_parser_backends [--check] "
+                         "[<protocol.xml>...]\n";
+            return EXIT_FAILURE;
+        } else {
+            files.emplace_back(arg);
+        }
+    }
+
+    wl_gena::bench::ScratchDir scratch;
+    if (files.empty()) {
+        wl_gena::bench::Corpus corpus = wl_gena::bench::load_corpus(
+            WL_GENA_BENCH_CORPUS, scratch.path / "corpus");
+        std::cout << std::format(
+            "corpus {}: {} protocols\n",
+            corpus.description,
+            corpus.files.size());
+        files = std::move(corpus.files);
+    }
+
+    bool all_match = true;
+    for (const std::string &file : files) {
+        all_match = bench_file(file, check_only) && all_match;
+    }
+    return all_match ? EXIT_SUCCESS : EXIT_FAILURE;
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Report.hh"
+
+namespace wl_gena::bench {
+
+namespace {
+
+/*
+ * Recursive descent over RFC 8259 JSON
+ */
+struct JsonParser
+{
+    std::string_view text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(std::string_view what) const
+    {
+        throw std::runtime_error{
+            std::format("Malformed JSON at offset {}: {}", pos, what)};
+    }
+
+    void skip_whitespace()
+    {
+        while (pos != text.size() &&
+               (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' ||
+                text[pos] == '\r')) {
+            ++pos;
+        }
+    }
+
+    char peek()
+    {
+        skip_whitespace();
+        if (pos == text.size()) {
+            fail("unexpected end of input");
+        }
+        return text[pos];
+    }
+
+    void expect(char c)
+    {
+        if (peek() != c) {
+            fail(std::format("expected '{}'", c));
+        }
+        ++pos;
+    }
+
+    bool take_literal(std::string_view literal)
+    {
+        if (!text.substr(pos).starts_with(literal)) {
+            return false;
+        }
+        pos += literal.size();
+        return true;
+    }
+
+    JsonValue parse_value()
+    {
+        char c = peek();
+        if (c == '{') {
+            return JsonValue{parse_object()};
+        }
+        if (c == '[') {
+            return JsonValue{parse_array()};
+        }
+        if (c == '"') {
+            return JsonValue{parse_string()};
+        }
+        if (take_literal("true")) {
+            return JsonValue{true};
+        }
+        if (take_literal("false")) {
+            return JsonValue{false};
+        }
+        if (take_literal("null")) {
+            return JsonValue{nullptr};
+        }
+        return JsonValue{parse_number()};
+    }
+
+    JsonValue::Object parse_object()
+    {
+        expect('{');
+        JsonValue::Object object;
+        if (peek() == '}') {
+            ++pos;
+            return object;
+        }
+        while (true) {
+            if (peek() != '"') {
+                fail("expected a member name");
+            }
+            std::string key = parse_string();
+            expect(':');
+            object.emplace_back(std::move(key), parse_value());
+            if (peek() == '}') {
+                ++pos;
+                return object;
+            }
+            expect(',');
+        }
+    }
+
+    JsonValue::Array parse_array()
+    {
+        expect('[');
+        JsonValue::Array array;
+        if (peek() == ']') {
+            ++pos;
+            return array;
+        }
+        while (true) {
+            array.push_back(parse_value());
+            if (peek() == ']') {
+                ++pos;
+                return array;
+            }
+            expect(',');
+        }
+    }
+
+    uint32_t parse_hex4()
+    {
+        uint32_t code = 0;
+        auto [end, ec] = std::from_chars(
+            text.data() + pos,
+            text.data() + std::min(pos + 4, text.size()),
+            code,
+            16);
+        if (ec != std::errc{} || end != text.data() + pos + 4) {
+            fail("bad \\u escape");
+        }
+        pos += 4;
+        return code;
+    }
+
+    static void append_utf8(std::string &out, uint32_t code)
+    {
+        if (code < 0x80) {
+            out += char(code);
+        } else if (code < 0x800) {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        } else {
+            out += char(0xf0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3f));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    uint32_t parse_code_point()
+    {
+        uint32_t code = parse_hex4();
+        if (code < 0xd800 || code > 0xdbff) {
+            return code;
+        }
+        if (!take_literal("\\u")) {
+            fail("unpaired surrogate");
+        }
+        uint32_t low = parse_hex4();
+        if (low < 0xdc00 || low > 0xdfff) {
+            fail("unpaired surrogate");
+        }
+        return 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+    }
+
+    std::string parse_string()
+    {
+        expect('"');
+        std::string out;
+        while (true) {
+            if (pos == text.size()) {
+                fail("unterminated string");
+            }
+            char c = text[pos++];
+            if (c == '"') {
+                return out;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) {
+                fail("control character in string");
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos == text.size()) {
+                fail("unterminated string");
+            }
+            switch (text[pos++]) {
+            case '"':
+                out += '"';
+                break;
+            case '\\':
+                out += '\\';
+                break;
+            case '/':
+                out += '/';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u':
+                append_utf8(out, parse_code_point());
+                break;
+            default:
+                fail("bad escape");
+            }
+        }
+    }
+
+    double parse_number()
+    {
+        if (text[pos] != '-' && !(text[pos] >= '0' && text[pos] <= '9')) {
+            fail("expected a value");
+        }
+        double number = 0;
+        auto [end, ec] = std::from_chars(
+            text.data() + pos, text.data() + text.size(), number);
+        if (ec != std::errc{}) {
+            fail("expected a value");
+        }
+        pos = size_t(end - text.data());
+        return number;
+    }
+};
+
+} // namespace
+
+std::string json_string(std::string_view str)
+{
+    std::string o = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            o += '\\';
+        }
+        o += c;
+    }
+    o += '"';
+    return o;
+}
+
+const JsonValue *JsonValue::find(std::string_view key) const
+{
+    const Object *object = std::get_if<Object>(&value);
+    if (!object) {
+        return nullptr;
+    }
+    for (const auto &[name, member] : *object) {
+        if (name == key) {
+            return &member;
+        }
+    }
+    return nullptr;
+}
+
+const JsonValue &JsonValue::at(std::string_view key) const
+{
+    const JsonValue *member = find(key);
+    if (!member) {
+        throw std::runtime_error{std::format("No member [{}]", key)};
+    }
+    return *member;
+}
+
+double JsonValue::as_number() const
+{
+    const double *number = std::get_if<double>(&value);
+    if (!number) {
+        throw std::runtime_error{"Expected a number"};
+    }
+    return *number;
+}
+
+size_t JsonValue::as_size() const
+{
+    double number = as_number();
+    if (number < 0 || number >= 0x1p64 || number != std::trunc(number)) {
+        throw std::runtime_error{
+            std::format("Expected a count, got [{}]", number)};
+    }
+    return size_t(number);
+}
+
+const std::string &JsonValue::as_string() const
+{
+    const std::string *str = std::get_if<std::string>(&value);
+    if (!str) {
+        throw std::runtime_error{"Expected a string"};
+    }
+    return *str;
+}
+
+auto JsonValue::as_array() const -> const Array &
+{
+    const Array *array = std::get_if<Array>(&value);
+    if (!array) {
+        throw std::runtime_error{"Expected an array"};
+    }
+    return *array;
+}
+
+JsonValue parse_json(std::string_view text)
+{
+    JsonParser parser{text};
+    JsonValue value = parser.parse_value();
+    parser.skip_whitespace();
+    if (parser.pos != text.size()) {
+        parser.fail("trailing characters");
+    }
+    return value;
+}
+
+JsonValue read_json_file(const std::string &file_name)
+{
+    std::ifstream in{file_name, std::ios::binary};
+    if (!in) {
+        throw std::runtime_error{
+            std::format("Cannot open results [{}]", file_name)};
+    }
+    std::string text{
+        std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    try {
+        return parse_json(text);
+    } catch (std::runtime_error &e) {
+        throw std::runtime_error{std::format("{}: {}", file_name, e.what())};
+    }
+}
+
+} // namespace wl_gena::bench
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <cstddef>
+
+namespace wl_gena::bench {
+
+/*
+ * Benchmark results are written as JSON and read back as baselines
+ */
+
+std::string json_string(std::string_view str);
+
+/*
+ * Parsed JSON document; object members keep their document order
+ *
+ * The as_* and at accessors throw if the value is of another type or
+ * the member is missing
+ */
+struct JsonValue
+{
+    using Array = std::vector<JsonValue>;
+    using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+    std::variant<std::nullptr_t, bool, double, std::string, Array, Object>
+        value;
+
+    /*
+     * Member [key] of an object, null if there is none
+     */
+    const JsonValue *find(std::string_view key) const;
+    const JsonValue &at(std::string_view key) const;
+
+    double as_number() const;
+    size_t as_size() const;
+    const std::string &as_string() const;
+    const Array &as_array() const;
+};
+
+/*
+ * Throws on malformed input, with the offset it was found at
+ */
+JsonValue parse_json(std::string_view text);
+
+JsonValue read_json_file(const std::string &file_name);
+
+} // namespace wl_gena::bench
@@ -0,0 +1,129 @@
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <cstddef>
+
+#include "SyntheticProtocol.hh"
+
+namespace {
+
+constexpr std::string_view primitive_args[] = {
+    R"(type="int")",
+    R"(type="uint")",
+    R"(type="fixed")",
+    R"(type="string")",
+    R"(type="array")",
+    R"(type="fd")",
+    R"(type="uint" enum="mode")",
+};
+
+/*
+ * Interfaces the referencing messages of an interface point to
+ */
+struct Neighbours
+{
+    size_t next;
+    size_t previous;
+};
+
+void append_arg(
+    std::string &o,
+    size_t arg_i,
+    bool is_request,
+    bool only_primitives,
+    Neighbours n)
+{
+    auto out = std::back_inserter(o);
+    std::format_to(out, R"(      <arg name="arg_{}" )", arg_i);
+
+    if (only_primitives) {
+        o += primitive_args[arg_i % std::size(primitive_args)];
+    } else if (arg_i == 0 && is_request) {
+        std::format_to(out, R"(type="new_id" interface="syn_{}")", n.next);
+    } else {
+        switch (arg_i % 4) {
+        case 0:
+            std::format_to(out, R"(type="object" interface="syn_{}")", n.next);
+            break;
+        case 1:
+            o += R"(type="int")";
+            break;
+        case 2:
+            std::format_to(
+                out,
+                R"(type="object" interface="syn_{}" allow-null="true")",
+                n.previous);
+            break;
+        case 3:
+            std::format_to(out, R"(type="uint" enum="syn_{}.mode")", n.next);
+            break;
+        }
+    }
+    o += "/>\n";
+}
+
+} // namespace
+
+namespace wl_gena::bench {
+
+std::string synthetic_protocol_xml(const SyntheticShape &shape)
+{
+    std::string o;
+    auto out = std::back_inserter(o);
+
+    o += R"(<?xml version="1.0" encoding="UTF-8"?>)"
+         "\n";
+    o += R"(<protocol name="synthetic">)"
+         "\n";
+
+    for (size_t iface_i = 0; iface_i != shape.interfaces; ++iface_i) {
+        Neighbours n{
+            (iface_i + 1) % shape.interfaces,
+            (iface_i + shape.interfaces - 1) % shape.interfaces};
+
+        std::format_to(
+            out, R"(  <interface name="syn_{}" version="3">)"
+                 "\n",
+            iface_i);
+
+        o += R"(    <enum name="mode">)"
+             "\n";
+        for (size_t entry_i = 0; entry_i != 3; ++entry_i) {
+            std::format_to(
+                out,
+                R"(      <entry name="mode_{}" value="{}"/>)"
+                "\n",
+                entry_i,
+                entry_i);
+        }
+        o += "    </enum>\n";
+
+        for (size_t msg_i = 0; msg_i != shape.messages; ++msg_i) {
+            bool is_request = msg_i % 4 < 2;
+            bool only_primitives = msg_i % 2 != 0;
+            std::string_view tag = is_request ? "request" : "event";
+
+            std::format_to(
+                out,
+                R"(    <{} name="{}_{}" since="{}">)"
+                "\n",
+                tag,
+                is_request ? "req" : "ev",
+                msg_i,
+                1 + msg_i % 3);
+            for (size_t arg_i = 0; arg_i != shape.args; ++arg_i) {
+                append_arg(o, arg_i, is_request, only_primitives, n);
+            }
+            std::format_to(out, "    </{}>\n", tag);
+        }
+
+        o += "  </interface>\n";
+    }
+
+    o += "</protocol>\n";
+    return o;
+}
+
+} // namespace wl_gena::bench
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include <cstddef>
+
+namespace wl_gena::bench {
+
+/*
+ * Size of a synthetic protocol: interfaces, messages per interface and
+ * args per message
+ */
+struct SyntheticShape
+{
+    size_t interfaces = 0;
+    size_t messages = 0;
+    size_t args = 0;
+};
+
+/*
+ * Protocol XML of the given shape that uses every arg kind. Messages
+ * alternate between requests and events, every other message has only
+ * primitive args, and the others refer to neighbouring interfaces, so
+ * both the null run and the types array of rtti grow with the shape
+ */
+std::string synthetic_protocol_xml(const SyntheticShape &shape);
+
+} // namespace wl_gena::bench
@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <format>
+#include <initializer_list>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "wire.hh"
+
+/*
+ * Checks the generated wire encoders and decoders against messages
+ * worked out by hand, then times them
+ *
+ * Every bw_echo request is encoded into one wire_buffer_t and compared
+ * word by word with its Wayland wire format: the header word, string and
+ * array padding, a null string, the untyped new_id of bind and the fd
+ * side array. A buffer without room for the words or the fds, and a
+ * message that can never fit, have to be refused with the buffer left
+ * as it was
+ *
+ * The encoded batch is split with wire_message_t::take and decoded with
+ * decode_event, the bw_echo events mirror the requests, and has to give
+ * back what was encoded. Truncated messages, strings without their
+ * terminating zero, null strings and objects where they are not allowed,
+ * missing fds and words left over after the args have to be refused
+ *
+ * The header comes from wl_gena.bench_wire_headers at build time
+ *
+ * usage: wl_gena.bench_wire [--iterations <n>]
+ */
+
+namespace {
+
+using namespace std::literals;
+
+using echo_wire = bench_wire::bw_echo_wire;
+using wire_buffer_t = bench_wire::wire_buffer_t;
+using wire_message_t = bench_wire::wire_message_t;
+
+/*
+ * Four bytes as they lie in a word of the message
+ */
+uint32_t bytes(std::string_view four)
+{
+    if (four.size() != 4) {
+        throw std::logic_error{"A word is four bytes"};
+    }
+    uint32_t word;
+    std::memcpy(&word, four.data(), sizeof(word));
+    return word;
+}
+
+constexpr uint32_t header(uint32_t size, uint16_t opcode)
+{
+    return size << 16 | opcode;
+}
+
+/*
+ * Memory of a wire_buffer_t, filled with garbage that padding has to
+ * overwrite
+ */
+struct TestBuffer
+{
+    explicit TestBuffer(size_t word_capacity = 256, size_t fd_capacity = 8)
+    {
+        words.fill(0xdeadbeef);
+        fds.fill(-2);
+        wire.words = words.data();
+        wire.word_capacity = std::min(word_capacity, words.size());
+        wire.fds = fds.data();
+        wire.fd_capacity = std::min(fd_capacity, fds.size());
+    }
+
+    TestBuffer(const TestBuffer &) = delete;
+    TestBuffer &operator=(const TestBuffer &) = delete;
+
+    std::span<const uint32_t> encoded() const
+    {
+        return std::span{words}.first(wire.word_count);
+    }
+
+    std::span<const int32_t> encoded_fds() const
+    {
+        return std::span{fds}.first(wire.fd_count);
+    }
+
+    std::array<uint32_t, 2048> words;
+    std::array<int32_t, 8> fds;
+    wire_buffer_t wire;
+};
+
+struct Checks
+{
+    void expect(bool ok, std::string_view what)
+    {
+        if (!ok) {
+            std::cout << std::format("FAILED: {}\n", what);
+            failed++;
+        }
+    }
+
+    template <typename T>
+    void expect_equal(
+        std::string_view what,
+        std::span<const T> got,
+        std::span<const T> want)
+    {
+        if (std::ranges::equal(got, want)) {
+            return;
+        }
+        std::string o = std::format("{}:\n  got ", what);
+        for (T val : got) {
+            std::format_to(std::back_inserter(o), " {:08x}", val);
+        }
+        o += "\n  want";
+        for (T val : want) {
+            std::format_to(std::back_inserter(o), " {:08x}", val);
+        }
+        expect(false, o);
+    }
+
+    size_t failed = 0;
+};
+
+struct Expected
+{
+    std::string_view name;
+    std::vector<uint32_t> words;
+};
+
+/*
+ * One of each request, in one buffer, as in expected_batch()
+ */
+bool encode_batch(wire_buffer_t &wire)
+{
+    constexpr std::array<unsigned char, 5> blob_data{1, 2, 3, 4, 5};
+
+    return echo_wire::numbers(wire, 3, 0xdeadbeef, -2, -256) &&
+           echo_wire::text(wire, 3, "hello", nullptr) &&
+           echo_wire::text(wire, 3, "abc", "") &&
+           echo_wire::objects(wire, 3, 5, 0, 9) &&
+           echo_wire::bind(wire, 2, 7, "bw_seat", 5, 10) &&
+           echo_wire::blob(
+               wire, 3, blob_data.data(), blob_data.size(), 42, 77) &&
+           echo_wire::blob(wire, 3, nullptr, 0, 43, 78) &&
+           echo_wire::nothing(wire, 3);
+}
+
+std::vector<Expected> expected_batch()
+{
+    return {
+        {"numbers",
+         {3, header(20, 0), 0xdeadbeef, 0xfffffffe, 0xffffff00}},
+        {"text with a null string",
+         {3, header(24, 1), 6, bytes("hell"), bytes("o\0\0\0"sv), 0}},
+        {"text with an empty string",
+         {3,
+          header(24, 1),
+          4,
+          bytes("abc\0"sv),
+          1,
+          bytes("\0\0\0\0"sv)}},
+        {"objects", {3, header(20, 2), 5, 0, 9}},
+        {"bind, an untyped new_id",
+         {2,
+          header(32, 3),
+          7,
+          8,
+          bytes("bw_s"),
+          bytes("eat\0"sv),
+          5,
+          10}},
+        {"blob",
+         {3,
+          header(24, 4),
+          5,
+          bytes("\1\2\3\4"sv),
+          bytes("\5\0\0\0"sv),
+          77}},
+        {"blob with an empty array", {3, header(16, 4), 0, 78}},
+        {"nothing", {3, header(8, 5)}},
+    };
+}
+
+void check_batch(Checks &checks)
+{
+    TestBuffer buffer;
+    checks.expect(encode_batch(buffer.wire), "batch encodes");
+
+    std::span<const uint32_t> words = buffer.encoded();
+    for (const Expected &message : expected_batch()) {
+        size_t size = std::min(message.words.size(), words.size());
+        checks.expect_equal<uint32_t>(
+            message.name, words.first(size), message.words);
+        words = words.subspan(size);
+    }
+    checks.expect(words.empty(), "batch has no words after the last message");
+
+    constexpr std::array<int32_t, 2> want_fds{42, 43};
+    checks.expect_equal<int32_t>(
+        "fds of the batch", buffer.encoded_fds(), want_fds);
+    checks.expect(
+        buffer.wire.byte_count() == buffer.wire.word_count * 4,
+        "byte_count counts the words");
+}
+
+void check_refusals(Checks &checks)
+{
+    {
+        TestBuffer buffer{4};
+        checks.expect(
+            echo_wire::nothing(buffer.wire, 3), "nothing fits 4 words");
+        checks.expect(
+            !echo_wire::numbers(buffer.wire, 3, 1, 2, 3),
+            "numbers does not fit the 2 words left");
+        checks.expect(
+            buffer.wire.word_count == 2 && !buffer.wire.empty(),
+            "a refused message leaves the buffer as it was");
+
+        buffer.wire.clear();
+        checks.expect(
+            echo_wire::numbers(buffer.wire, 3, 1, 2, 3) == false,
+            "numbers does not fit 4 words at all");
+        checks.expect(
+            buffer.wire.empty(),
+            "a message larger than the buffer is refused on an empty one");
+    }
+    {
+        TestBuffer buffer{256, 0};
+        checks.expect(
+            !echo_wire::blob(buffer.wire, 3, nullptr, 0, 42, 77),
+            "blob needs room for its fd");
+        checks.expect(
+            buffer.wire.empty(), "a refused fd leaves the buffer empty");
+    }
+    {
+        TestBuffer buffer;
+        std::string title(wire_buffer_t::max_message_size, 'x');
+        checks.expect(
+            !echo_wire::text(buffer.wire, 3, title.c_str(), nullptr),
+            "a message over max_message_size is refused");
+        checks.expect(
+            buffer.wire.empty(),
+            "a message that can never fit is refused on an empty buffer");
+    }
+}
+
+/*
+ * Decoded events, one line each
+ */
+struct Described
+{
+    template <typename... Args>
+    void add(std::format_string<Args...> fmt, Args &&...args)
+    {
+        lines.push_back(std::format(fmt, std::forward<Args>(args)...));
+    }
+
+    static std::string text(std::string_view s)
+    {
+        return s.data() == nullptr ? "null" : std::format("[{}]", s);
+    }
+
+    void operator()(const echo_wire::got_numbers_event_t &e)
+    {
+        add("numbers {:x} {} {}", e.u, e.i, e.f);
+    }
+
+    void operator()(const echo_wire::got_text_event_t &e)
+    {
+        add("text {} {}", text(e.s), text(e.ns));
+    }
+
+    void operator()(const echo_wire::got_objects_event_t &e)
+    {
+        add("objects {} {} {}", e.o, e.no, e.n);
+    }
+
+    void operator()(const echo_wire::got_bind_event_t &e)
+    {
+        add("bind {} {} {} {}",
+            e.name,
+            text(e.id_interface),
+            e.id_version,
+            e.id);
+    }
+
+    void operator()(const echo_wire::got_blob_event_t &e)
+    {
+        std::string data;
+        for (unsigned char byte : e.contents) {
+            std::format_to(std::back_inserter(data), "{}", int(byte));
+        }
+        add("blob [{}] {} {}", data, e.fd, e.after);
+    }
+
+    void operator()(const echo_wire::got_nothing_event_t &)
+    {
+        add("nothing");
+    }
+
+    std::vector<std::string> lines;
+};
+
+/*
+ * Decodes every message of [words] as a bw_echo event; false at the
+ * first one that is not whole or does not decode, or if fds are left
+ */
+bool decode_batch(
+    std::span<const uint32_t> words,
+    std::span<const int32_t> fds,
+    Described &described)
+{
+    while (!words.empty()) {
+        wire_message_t message;
+        if (!wire_message_t::take(words, fds, message) ||
+            !echo_wire::decode_event(
+                message.opcode, message.args, described)) {
+            return false;
+        }
+    }
+    return fds.empty();
+}
+
+bool decodes(
+    std::initializer_list<uint32_t> words, std::span<const int32_t> fds = {})
+{
+    Described described;
+    return decode_batch(
+        std::span{words.begin(), words.size()}, fds, described);
+}
+
+void check_round_trip(Checks &checks)
+{
+    TestBuffer buffer;
+    checks.expect(encode_batch(buffer.wire), "batch encodes");
+
+    Described described;
+    checks.expect(
+        decode_batch(buffer.encoded(), buffer.encoded_fds(), described),
+        "encoded batch decodes");
+
+    std::vector<std::string_view> want{
+        "numbers deadbeef -2 -256",
+        "text [hello] null",
+        "text [abc] []",
+        "objects 5 0 9",
+        "bind 7 [bw_seat] 5 10",
+        "blob [12345] 42 77",
+        "blob [] 43 78",
+        "nothing",
+    };
+    if (!std::ranges::equal(described.lines, want)) {
+        std::string o = "decoded batch:";
+        for (const std::string &line : described.lines) {
+            o += "\n  got  " + line;
+        }
+        for (std::string_view line : want) {
+            std::format_to(std::back_inserter(o), "\n  want {}", line);
+        }
+        checks.expect(false, o);
+    }
+}
+
+void check_malformed(Checks &checks)
+{
+    constexpr std::array<int32_t, 1> fd{42};
+
+    checks.expect(
+        decodes({3, header(20, 0), 1, 2, 3}), "numbers decodes as it is");
+    checks.expect(
+        !decodes({3, header(20, 0), 1, 2}),
+        "a message shorter than its header says is not taken");
+    checks.expect(
+        !decodes({3, header(16, 0), 1, 2}),
+        "a message without all of its args does not decode");
+    checks.expect(
+        !decodes({3, header(6, 0)}), "a message shorter than its header");
+    checks.expect(
+        !decodes({3, header(24, 0), 1, 2, 3, 4}),
+        "words left over after the args do not decode");
+    checks.expect(
+        !decodes({3, header(12, 5), 0}),
+        "nothing with a word left over does not decode");
+    checks.expect(!decodes({3, header(8, 6)}), "an unknown opcode");
+
+    checks.expect(
+        !decodes({3, header(20, 1), 4, bytes("abcd"), 0}),
+        "a string without its terminating zero does not decode");
+    checks.expect(
+        !decodes({3, header(20, 1), 8, bytes("abc\0"sv), 0}),
+        "a string longer than the message does not decode");
+    checks.expect(
+        !decodes({3, header(16, 1), 0, 0}),
+        "a null string that is not allowed-null does not decode");
+
+    checks.expect(
+        !decodes({3, header(20, 2), 0, 0, 9}),
+        "a null object that is not allowed-null does not decode");
+    checks.expect(
+        !decodes({3, header(20, 2), 5, 0, 0}),
+        "a null new_id does not decode");
+
+    checks.expect(
+        decodes({3, header(16, 4), 0, 77}, fd), "blob decodes with its fd");
+    checks.expect(
+        !decodes({3, header(16, 4), 0, 77}), "blob without its fd");
+    checks.expect(
+        !decodes({3, header(16, 4), 8, 77}, fd),
+        "an array longer than the message does not decode");
+}
+
+double time_batches(size_t iterations)
+{
+    TestBuffer buffer;
+    size_t words = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i != iterations; ++i) {
+        buffer.wire.clear();
+        if (!encode_batch(buffer.wire)) {
+            throw std::runtime_error{"Batch did not fit"};
+        }
+        words += buffer.wire.word_count;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (words != iterations * buffer.wire.word_count) {
+        throw std::runtime_error{"Batches differ in size"};
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = end - begin;
+    return elapsed.count() / double(iterations * expected_batch().size());
+}
+
+size_t parse_iterations(int argc, char **argv)
+{
+    size_t iterations = 1'000'000;
+    for (int arg_i = 1; arg_i != argc; ++arg_i) {
+        std::string_view arg = argv[arg_i];
+        if (arg == "--iterations" && arg_i + 1 != argc) {
+            iterations = std::max<size_t>(1, std::stoul(argv[++arg_i]));
+        } else {
+            throw std::runtime_error{std::format(
+                "Unknown option [{}]\n"
+                "usage: wl_gena.bench_wire [--iterations <n>]",
+                arg)};
+        }
+    }
+    return iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    size_t iterations = parse_iterations(argc, argv);
+
+    Checks checks;
+    check_batch(checks);
+    check_refusals(checks);
+    check_round_trip(checks);
+    check_malformed(checks);
+    if (checks.failed != 0) {
+        std::cout << std::format("{} checks failed\n", checks.failed);
+        return EXIT_FAILURE;
+    }
+    std::cout << "encoders and decoders match the wire format\n";
+
+    std::cout << std::format(
+        "{:.2f} ns per encoded message\n", time_batches(iterations));
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
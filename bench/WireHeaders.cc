@@ -0,0 +1,118 @@
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cstdlib>
+
+#include "File.hh"
+#include "HeaderGena.hh"
+#include "Parser.hh"
+
+/*
+ * Writes the header wl_gena.bench_wire is compiled with: one protocol
+ * with a request of every arg kind, generated with wire encoders, and
+ * the same messages as events, in the same order, generated with wire
+ * decoders, so that encoded requests decode as events
+ *
+ * usage: wl_gena.bench_wire_headers <out_dir>
+ */
+
+namespace {
+
+constexpr std::string_view wire_protocol_xml = R"(<?xml version="1.0"?>
+<protocol name="bench_wire">
+  <interface name="bw_callback" version="1">
+    <event name="done" type="destructor">
+      <arg name="callback_data" type="uint"/>
+    </event>
+  </interface>
+  <interface name="bw_echo" version="1">
+    <request name="numbers">
+      <arg name="u" type="uint"/>
+      <arg name="i" type="int"/>
+      <arg name="f" type="fixed"/>
+    </request>
+    <request name="text">
+      <arg name="s" type="string"/>
+      <arg name="ns" type="string" allow-null="true"/>
+    </request>
+    <request name="objects">
+      <arg name="o" type="object" interface="bw_callback"/>
+      <arg name="no" type="object" interface="bw_callback" allow-null="true"/>
+      <arg name="n" type="new_id" interface="bw_callback"/>
+    </request>
+    <request name="bind">
+      <arg name="name" type="uint"/>
+      <arg name="id" type="new_id"/>
+    </request>
+    <request name="blob">
+      <arg name="contents" type="array"/>
+      <arg name="fd" type="fd"/>
+      <arg name="after" type="uint"/>
+    </request>
+    <request name="nothing"/>
+    <event name="got_numbers">
+      <arg name="u" type="uint"/>
+      <arg name="i" type="int"/>
+      <arg name="f" type="fixed"/>
+    </event>
+    <event name="got_text">
+      <arg name="s" type="string"/>
+      <arg name="ns" type="string" allow-null="true"/>
+    </event>
+    <event name="got_objects">
+      <arg name="o" type="object" interface="bw_callback"/>
+      <arg name="no" type="object" interface="bw_callback" allow-null="true"/>
+      <arg name="n" type="new_id" interface="bw_callback"/>
+    </event>
+    <event name="got_bind">
+      <arg name="name" type="uint"/>
+      <arg name="id" type="new_id"/>
+    </event>
+    <event name="got_blob">
+      <arg name="contents" type="array"/>
+      <arg name="fd" type="fd"/>
+      <arg name="after" type="uint"/>
+    </event>
+    <event name="got_nothing"/>
+  </interface>
+</protocol>
+)";
+
+} // namespace
+
+int main(int argc, char **argv)
+try {
+    if (argc != 2) {
+        std::cerr << "usage: wl_gena.bench_wire_headers <out_dir>\n";
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path out_dir{argv[1]};
+    std::filesystem::create_directories(out_dir);
+
+    auto protocol_op = wl_gena::parse_protocol(wire_protocol_xml);
+    if (!protocol_op) {
+        throw std::runtime_error{protocol_op.error()};
+    }
+
+    wl_gena::GenerateHeaderInput I;
+    I.protocol = std::make_shared<const wl_gena::types::Protocol>(
+        std::move(protocol_op.value()));
+    I.wire_encoders = true;
+    I.wire_decoders = true;
+
+    std::pmr::monotonic_buffer_resource arena;
+    auto header = wl_gena::generate_header(I, &arena);
+
+    wl_gena::write_file_if_changed(
+        (out_dir / "wire.hh").string(), header.output);
+} catch (std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return EXIT_FAILURE;
+}
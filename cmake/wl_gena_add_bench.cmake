@@ -0,0 +1,32 @@
+# Benchmark executable TARGET built from SOURCES with the flags of every
+# other target. It links the wl_gena objects and includes the source
+# tree, unless STANDALONE: benches over generated headers only include
+# INCLUDE_DIRECTORIES. DEFINITIONS become compile definitions
+function(wl_gena_add_bench TARGET)
+    cmake_parse_arguments(PARSE_ARGV 1 BENCH
+        "STANDALONE" "" "SOURCES;INCLUDE_DIRECTORIES;DEFINITIONS")
+
+    add_executable(${TARGET})
+    target_cxx23(${TARGET})
+    target_strict_compilation(${TARGET})
+
+    target_sources(${TARGET} PRIVATE ${BENCH_SOURCES})
+    if(NOT BENCH_STANDALONE)
+        target_include_directories(${TARGET} PRIVATE
+            ${CMAKE_CURRENT_SOURCE_DIR}
+        )
+        target_link_libraries(${TARGET} PRIVATE
+            ${PREF}wl_gena.object
+            ${PREF}libexpat
+            Threads::Threads
+        )
+    endif()
+    if(BENCH_INCLUDE_DIRECTORIES)
+        target_include_directories(${TARGET} PRIVATE
+            ${BENCH_INCLUDE_DIRECTORIES}
+        )
+    endif()
+    if(BENCH_DEFINITIONS)
+        target_compile_definitions(${TARGET} PRIVATE ${BENCH_DEFINITIONS})
+    endif()
+endfunction()